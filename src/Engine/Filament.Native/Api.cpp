@@ -5,6 +5,8 @@ const uint8_t INVISIBLE_LAYER = 0x2;
 const uint8_t MAIN_LAYER = 0x1;
 
 #define MAT_VERSION "2025.4"
+#define QUAT_VERSION "1"
+#define QUAT_CACHE_MAGIC 0x54415551
 
 #ifdef _WINDOWS
 
@@ -66,6 +68,8 @@ static inline mat4 MatFromArray(const Matrix4x4 array) {
 
 #endif
 
+static MaterialArchive* OpenMaterialArchive(const std::string& dir);
+
 FilamentApp* Initialize(const InitializeOptions& options) {
 
 	#ifdef _WINDOWS
@@ -80,6 +84,7 @@ FilamentApp* Initialize(const InitializeOptions& options) {
 	app->skybox = nullptr;
 
 	app->materialCachePath = options.materialCachePath;
+	app->materialArchive = app->materialCachePath.length() > 0 ? OpenMaterialArchive(app->materialCachePath) : nullptr;
 	app->oneViewPerTarget = options.oneViewPerTarget;
 	
 	Engine::Config cfg;
@@ -208,8 +213,6 @@ RTID AddRenderTarget(FilamentApp* app, const RenderTargetOptions& options)
 		.import(options.textureId)
 		.build(*app->engine);
 
-	app->engine->flushAndWait();
-
 	auto depth = Texture::Builder()
 		.width(options.width)
 		.height(options.height)
@@ -227,14 +230,21 @@ RTID AddRenderTarget(FilamentApp* app, const RenderTargetOptions& options)
 
 	app->renderTargets.push_back(rt);
 
-    app->engine->flushAndWait();
+	// Commands run in order on the driver thread, the views using the target don't need to wait for it
+	app->engine->flush();
 
 	return (VIEWID)(app->renderTargets.size() - 1);
 }
 
 
+static void RetireAllFrames(FilamentApp* app);
+
 void ReleaseContext(FilamentApp* app, ReleaseContextMode mode)
 {
+	// The fences belong to the context going away
+	if (mode != ReleaseContextMode::NotRelease)
+		RetireAllFrames(app);
+
 #ifdef _WINDOWS
 
 	auto plat = dynamic_cast<PlatformWGL2*>(app->engine->getPlatform());
@@ -248,16 +258,151 @@ void ReleaseContext(FilamentApp* app, ReleaseContextMode mode)
 #endif
 }
 
+static void CompleteOrientationTasks(FilamentApp* app, bool wait);
+static void CompleteMaterials(FilamentApp* app, bool wait);
+static void UpdateTextureStreaming(FilamentApp* app, const ::RenderTarget* target);
+static void FlushInstancedMeshes(FilamentApp* app);
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+static inline float ElapsedMs(TimePoint& last) {
+	auto now = std::chrono::steady_clock::now();
+	auto result = std::chrono::duration<float, std::milli>(now - last).count();
+	last = now;
+	return result;
+}
+
+static void PublishFrameStats(FilamentApp* app, FrameStats& stats);
+
+static void RetireFrame(FilamentApp* app, bool wait) {
+
+	auto& fences = app->frameFences;
+	auto& oldest = fences.front();
+
+	if (wait)
+		Fence::waitAndDestroy(oldest.fence, Fence::Mode::FLUSH);
+	else
+		app->engine->destroy(oldest.fence);
+
+	app->completedFrame = std::max(app->completedFrame, oldest.frameIndex);
+	fences.erase(fences.begin());
+}
+
+static void RetireAllFrames(FilamentApp* app) {
+	while (!app->frameFences.empty())
+		RetireFrame(app, true);
+}
+
+// Drops the fences already signaled, without blocking
+static void PollFrameFences(FilamentApp* app) {
+	auto& fences = app->frameFences;
+	while (!fences.empty() && fences.front().fence->wait(Fence::Mode::DONT_FLUSH, 0) == FenceStatus::CONDITION_SATISFIED)
+		RetireFrame(app, false);
+}
+
+void SetFramesInFlight(FilamentApp* app, uint32_t count)
+{
+	app->framesInFlight = std::min(count, 4u);
+
+	// Back to blocking frames (or fewer in flight): nothing older than the new limit stays pending
+	while (app->frameFences.size() > app->framesInFlight)
+		RetireFrame(app, true);
+}
+
+uint64_t GetCompletedFrame(FilamentApp* app)
+{
+	PollFrameFences(app);
+	return app->completedFrame;
+}
+
+// Blocks until the GPU is done with frameIndex (e.g. before reading back its targets), false when it wasn't rendered yet
+bool WaitFrame(FilamentApp* app, uint64_t frameIndex)
+{
+	if (frameIndex <= app->completedFrame)
+		return true;
+
+	if (frameIndex > app->frameIndex)
+		return false;
+
+	auto& fences = app->frameFences;
+	while (!fences.empty() && fences.front().frameIndex <= frameIndex)
+		RetireFrame(app, true);
+
+	// Dropped frames and frames rendered without pipelining have no fence
+	if (app->completedFrame < frameIndex) {
+		app->engine->flushAndWait();
+		while (!fences.empty())
+			RetireFrame(app, false);
+		app->completedFrame = app->frameIndex;
+	}
+
+	return true;
+}
+
 bool isFrameBegin = false;
 
 void Render(FilamentApp* app, const ::RenderTarget targets[], uint32_t count, bool wait)
 {
+	FrameStats frame = {};
+
+	auto frameStart = std::chrono::steady_clock::now();
+	auto phase = frameStart;
+
+	// Everything queued since the last frame, commands already executed by ExecuteCommands included
+	ExecuteCommands(app);
+
+	CompleteOrientationTasks(app, false);
+	CompleteMaterials(app, false);
+
+	FlushInstancedMeshes(app);
+
+	app->frameIndex++;
+	UpdateTextureStreaming(app, count > 0 ? &targets[0] : nullptr);
+
+	frame.frameIndex = app->frameIndex;
+	frame.commands = app->frameCommands;
+	frame.commandBytes = app->frameBytes;
+	frame.streamingBytes = app->streamingStats.lastFrameBytes;
+
+	auto& cmdStats = app->commandStats;
+	cmdStats.frames++;
+	cmdStats.totalCommands += app->frameCommands;
+	cmdStats.totalBytes += app->frameBytes;
+	cmdStats.lastCommands = app->frameCommands;
+	cmdStats.lastBytes = app->frameBytes;
+	cmdStats.maxCommands = std::max(cmdStats.maxCommands, app->frameCommands);
+	cmdStats.maxBytes = std::max(cmdStats.maxBytes, app->frameBytes);
+	app->frameCommands = 0;
+	app->frameBytes = 0;
+
 	Renderer::ClearOptions opt;
 	opt.clear = true;
 	opt.clearColor = { 0, 0, 0, 0 };
 	app->renderer->setClearOptions(opt);
 
-	app->renderer->beginFrame(app->swapChain);
+	frame.prepareTime = ElapsedMs(phase);
+
+	// Blocks only once framesInFlight frames are queued ahead of the GPU
+	if (app->framesInFlight > 0) {
+		PollFrameFences(app);
+		if (app->frameFences.size() >= app->framesInFlight) {
+			while (app->frameFences.size() >= app->framesInFlight)
+				RetireFrame(app, true);
+			frame.throttleTime = ElapsedMs(phase);
+			frame.flags |= (uint32_t)FrameFlags::Throttled;
+		}
+	}
+
+	// Filament skips frames to keep up with the display, nothing can be rendered until the next one
+	if (!app->renderer->beginFrame(app->swapChain)) {
+		frame.beginFrameTime = ElapsedMs(phase);
+		frame.flags |= (uint32_t)FrameFlags::Dropped;
+		frame.totalTime = ElapsedMs(frameStart);
+		PublishFrameStats(app, frame);
+		return;
+	}
+
+	frame.beginFrameTime = ElapsedMs(phase);
 
 	bool hasMainView = false;
 
@@ -303,6 +448,11 @@ void Render(FilamentApp* app, const ::RenderTarget targets[], uint32_t count, bo
 		//else
 			app->renderer->render(viewInfo.view);
 
+		auto viewTime = ElapsedMs(phase);
+		frame.renderTime += viewTime;
+		if (i < FRAME_STATS_MAX_VIEWS)
+			frame.viewTimes[i] = viewTime;
+		frame.viewsRendered++;
 	}
 
 #if _WINDOWS
@@ -312,16 +462,38 @@ void Render(FilamentApp* app, const ::RenderTarget targets[], uint32_t count, bo
 #endif
 
 	app->renderer->endFrame(hasMainView);
-	if (wait)
+	frame.endFrameTime = ElapsedMs(phase);
+
+	if (app->framesInFlight > 0) {
+		// Submitted now, WaitFrame covers the consumers that need the result
+		app->frameFences.push_back({ app->frameIndex, app->engine->createFence() });
+		if (wait)
+			app->engine->flush();
+		frame.flushTime = ElapsedMs(phase);
+	}
+	else if (wait) {
 		app->engine->flushAndWait();
+		app->completedFrame = app->frameIndex;
+		frame.flushTime = ElapsedMs(phase);
+		frame.flags |= (uint32_t)FrameFlags::Waited;
+	}
+
+	if (!hasMainView)
+		frame.flags |= (uint32_t)FrameFlags::NoMainView;
+
+	frame.totalTime = ElapsedMs(frameStart);
+
+	PublishFrameStats(app, frame);
 }
 
 
-void UpdateLight(FilamentApp* app, OBJID id, const LightInfo& info) {
-	auto& lcm = app->engine->getLightManager();
+void UpdateLightByHandle(FilamentApp* app, OBJHANDLE handle, const LightInfo& info) {
+	auto light = app->entities.get(handle);
+	if (!light)
+		return;
 
-	auto light = app->entities[id];
-	auto instance = lcm.getInstance(light);
+	auto& lcm = app->engine->getLightManager();
+	auto instance = lcm.getInstance(*light);
 
 	lcm.setIntensity(instance, info.intensity * 100000);
 	lcm.setDirection(instance, { info.direction.x, info.direction.y, info.direction.z });
@@ -333,7 +505,11 @@ void UpdateLight(FilamentApp* app, OBJID id, const LightInfo& info) {
 	lcm.setFalloff(instance, info.falloffRadius);
 }
 
-void AddLight(FilamentApp* app, OBJID id, const LightInfo& info)
+void UpdateLight(FilamentApp* app, OBJID id, const LightInfo& info) {
+	UpdateLightByHandle(app, app->entities.handle(id), info);
+}
+
+OBJHANDLE AddLight(FilamentApp* app, OBJID id, const LightInfo& info)
 {
 
 	auto& lcm = app->engine->getLightManager();
@@ -364,522 +540,2586 @@ void AddLight(FilamentApp* app, OBJID id, const LightInfo& info)
 
 
 	app->scene->addEntity(light);
-	app->entities[id] = light;
+	auto handle = app->entities.set(id, light);
 
 	lcm.setShadowOptions(lcm.getInstance(light), {
 		.screenSpaceContactShadows = true
 	});
 
-	auto const& count = app->scene->getLightCount();
+	return handle;
 }
 
-static void DeleteBuffer(void* buffer, size_t size, void* user) {
-	delete[] buffer;
-}
+static UploadPool s_uploadPool;
 
+// Never freed: blocks handed to the driver thread keep pointing to their owner after the thread is gone
+static thread_local UploadThreadCache* t_uploadCache = nullptr;
 
+// Orphans the thread's cache on exit, kept apart from t_uploadCache so the hot paths stay on a trivial thread_local
+struct UploadCacheRelease {
+	UploadThreadCache* cache = nullptr;
 
-template <typename T>
-T* UnpackBuffer(uint8_t* pSrc, int offset, size_t stride, size_t count) {
-	T* pDst = new T[count];
-	T* curDst = pDst;
-	pSrc += offset;
-	while (count-- > 0)
-	{
-		*curDst = *(T*)pSrc;
-		pSrc += stride;
-		curDst++;
+	~UploadCacheRelease() {
+		if (cache == nullptr)
+			return;
+		std::lock_guard<std::mutex> lock(s_uploadPool.lock);
+		cache->orphaned = true;
+		t_uploadCache = nullptr;
 	}
-	return pDst;
-}
+};
 
-uint8_t* Allocate(size_t size) {
-	return new uint8_t[size];
-}
+static thread_local UploadCacheRelease t_uploadCacheRelease;
 
+static inline uint32_t HighestBit(uint64_t value) {
+#ifdef _WINDOWS
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return (uint32_t)index;
+#else
+	return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+}
 
-void AddGeometry(FilamentApp* app, OBJID id, const GeometryInfo& info)
-{
-	auto indices = info.indices;
-	auto indicesCount = info.indicesCount;
+// 256 bytes, then 4 classes per power of two up to UPLOAD_POOL_MAX_BLOCK, at most 25% slack
+static uint32_t UploadSizeClass(size_t size, size_t& classSize) {
 
-	if (info.indicesCount == 0) {
-		indices = new uint32_t[info.verticesCount];
-		for (uint32_t i = 0; i < info.verticesCount; i++)
-			indices[i] = i;
-		indicesCount = info.verticesCount;
+	if (size <= 256) {
+		classSize = 256;
+		return 0;
 	}
 
-	auto ib = IndexBuffer::Builder()
-		.indexCount(indicesCount)
-		.bufferType(IndexBuffer::IndexType::UINT)
-		.build(*app->engine);
-
-	auto ibSizeByte = sizeof(uint32_t) * indicesCount;
+	auto e = HighestBit(size - 1);
+	size_t base = (size_t)1 << e;
+	size_t step = base >> 2;
+	size_t m = (size - 1 - base) / step;
 
-	if (info.indicesCount > 0) {
-		auto ibBuffer = new uint8_t[ibSizeByte];
-		memcpy(ibBuffer, info.indices, ibSizeByte);
-		ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor(ibBuffer, ibSizeByte, DeleteBuffer, (void*)"IB"));
-	}
-	else
-		ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor(indices, ibSizeByte, DeleteBuffer, (void*)"IB-GEN"));
+	classSize = base + (m + 1) * step;
 
+	return 1 + (e - 8) * 4 + (uint32_t)m;
+}
 
-	auto vbBuilder = VertexBuffer::Builder()
-		.vertexCount(info.verticesCount);
+static size_t UploadClassSize(uint32_t sizeClass) {
 
-	auto surfBuilder = geometry::SurfaceOrientation::Builder();
-	surfBuilder
-		.triangles((uint3*)info.indices)
-		.triangleCount(info.indicesCount / 3)
-		.vertexCount(info.verticesCount);
+	if (sizeClass == 0)
+		return 256;
 
+	size_t base = (size_t)1 << (8 + (sizeClass - 1) / 4);
 
-	bool hasNormals = false;
-	bool hasTangents = false;
+	return base + ((sizeClass - 1) % 4 + 1) * (base >> 2);
+}
 
+static UploadTag UploadTagFromName(const char* name) {
 
-	Geometry result;
-	result.soBuffer = nullptr;	
+	if (name == nullptr)
+		return UploadTag::Other;
+	if (strncmp(name, "VB", 2) == 0)
+		return UploadTag::VB;
+	if (strncmp(name, "IB", 2) == 0)
+		return UploadTag::IB;
+	if (strcmp(name, "TEX") == 0)
+		return UploadTag::TEX;
+	if (strcmp(name, "QUAD") == 0)
+		return UploadTag::QUAD;
 
-	for (uint32_t i = 0; i < info.layout.attributeCount; i++) {
-		auto& attr = info.layout.attributes[i];
+	return UploadTag::Other;
+}
 
-		filament::VertexAttribute va;
-		VertexBuffer::AttributeType at;
+// A cache orphaned by an exited thread is adopted first: its free lists and whatever was given back
+// to its remote list since then are reused instead of staying retained forever
+static UploadThreadCache* GetUploadCache() {
 
-		bool isMainBuffer = true;
+	if (t_uploadCache == nullptr) {
 
-		switch (attr.type)
-		{
-		case VertexAttributeType::Position:
-			va = filament::VertexAttribute::POSITION;
-			at = VertexBuffer::AttributeType::FLOAT3;
-			surfBuilder.positions((float3*)(info.vertices + attr.offset), info.layout.sizeByte);
-			break;
-		case VertexAttributeType::Normal:
-			surfBuilder.normals((float3*)(info.vertices + attr.offset), info.layout.sizeByte);
-			hasNormals = true;
-			isMainBuffer = false;
-			break;
-		case VertexAttributeType::Tangent:
-			surfBuilder.tangents((float4*)(info.vertices + attr.offset), info.layout.sizeByte);
-			isMainBuffer = false;
-			break;
-		case VertexAttributeType::Color:
-			va = filament::VertexAttribute::COLOR;
-			at = VertexBuffer::AttributeType::FLOAT4;
-			break;
-		case VertexAttributeType::UV0:
-			va = filament::VertexAttribute::UV0;
-			at = VertexBuffer::AttributeType::FLOAT2;
-			surfBuilder.uvs((float2*)(info.vertices + attr.offset), info.layout.sizeByte);
-			break;
-		case VertexAttributeType::UV1:
-			va = filament::VertexAttribute::UV1;
-			at = VertexBuffer::AttributeType::FLOAT2;
-			break;
-		default:
-			break;
-		}
+		std::lock_guard<std::mutex> lock(s_uploadPool.lock);
 
-		if (isMainBuffer)
-			vbBuilder.attribute(va, 0, at, attr.offset, info.layout.sizeByte);
-	};
+		UploadThreadCache* cache = nullptr;
 
-	bool hasOrientation = hasNormals && !hasTangents && info.primitive == PrimitiveType::TRIANGLES;
+		for (auto item : s_uploadPool.threads) {
+			if (item->orphaned) {
+				cache = item;
+				break;
+			}
+		}
 
-	vbBuilder.bufferCount(hasOrientation ? 2 : 1);
+		if (cache == nullptr) {
+			cache = new UploadThreadCache();
+			s_uploadPool.threads.push_back(cache);
+		}
 
-	if (hasOrientation) {
-		vbBuilder.attribute(filament::VertexAttribute::TANGENTS, 1, VertexBuffer::AttributeType::SHORT4);
-		vbBuilder.normalized(filament::VertexAttribute::TANGENTS);
+		cache->orphaned = false;
+		t_uploadCache = cache;
+		t_uploadCacheRelease.cache = cache;
 	}
 
-	auto vb = vbBuilder.build(*app->engine);
+	return t_uploadCache;
+}
 
-	auto vbSize = info.verticesCount * info.layout.sizeByte;
-	auto vbBuffer = new uint8_t[vbSize];
-	memcpy(vbBuffer, info.vertices, vbSize);
+static void CountUpload(UploadTag tag, int64_t bytes, int64_t count) {
 
-	vb->setBufferAt(*app->engine, 0, VertexBuffer::BufferDescriptor(vbBuffer, vbSize, DeleteBuffer, (void*)"VB"));
+	auto& stats = s_uploadPool.tags[(uint32_t)tag];
 
-	if (hasOrientation) {
+	stats.allocations.fetch_add(count, std::memory_order_relaxed);
 
-		auto so = surfBuilder.
-			build();
+	auto live = stats.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
 
-		result.soBuffer = new short4[so->getVertexCount()];
-		memset(result.soBuffer, 0, so->getVertexCount() * sizeof(short4));
+	if (bytes > 0) {
+		stats.totalBytes.fetch_add(bytes, std::memory_order_relaxed);
+		auto peak = stats.peakBytes.load(std::memory_order_relaxed);
+		while (live > peak && !stats.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+	}
+}
 
-		so->getQuats(result.soBuffer, so->getVertexCount());
+static void FreeUploadBlock(UploadBlock* block) {
+	::operator delete(block, std::align_val_t(alignof(UploadBlock)));
+}
 
-		vb->setBufferAt(*app->engine, 1, VertexBuffer::BufferDescriptor(result.soBuffer, so->getVertexCount() * sizeof(short4), DeleteBuffer, (void*)"QUAD"));
+// Takes back the blocks other threads returned, as a whole so no ABA is possible
+static void DrainRemoteBlocks(UploadThreadCache* cache) {
 
-		delete so;
+	auto block = cache->remote.exchange(nullptr, std::memory_order_acquire);
+
+	while (block != nullptr) {
+		auto next = block->next;
+		block->next = cache->freeLists[block->sizeClass];
+		cache->freeLists[block->sizeClass] = block;
+		block = next;
 	}
+}
 
-	float3 halfSize = {
-		(info.bounds.max.x - info.bounds.min.x) / 2.0f,
-		(info.bounds.max.y - info.bounds.min.y) / 2.0f,
-		(info.bounds.max.z - info.bounds.min.z) / 2.0f
-	};
+// Staging memory for the buffers handed to Filament, released by DeleteBuffer on the driver thread
+static void* UploadAlloc(size_t size, UploadTag tag) {
 
-	float3 center = {
-		(info.bounds.max.x + info.bounds.min.x) / 2.0f,
-		(info.bounds.max.y + info.bounds.min.y) / 2.0f,
-		(info.bounds.max.z + info.bounds.min.z) / 2.0f
-	};
+	auto& pool = s_uploadPool;
 
-	result.ib = ib;
-	result.vb = vb;
-	result.box = { center, halfSize };
-	result.primitive = info.primitive;	
+	UploadBlock* block = nullptr;
+	UploadThreadCache* cache = nullptr;
+	size_t classSize = size;
+	uint32_t sizeClass = UPLOAD_POOL_CLASSES;
 
-	app->geometries[id] = result;
-}
+	if (size <= UPLOAD_POOL_MAX_BLOCK) {
 
-void UpdateMeshGeometry(FilamentApp* app, OBJID meshId, OBJID geometryId, const GeometryInfo& info) {
-	
-	auto oldGeo = app->geometries[geometryId];
+		sizeClass = UploadSizeClass(size, classSize);
+		cache = GetUploadCache();
 
-	AddGeometry(app, geometryId, info);
+		if (cache->freeLists[sizeClass] == nullptr && cache->remote.load(std::memory_order_relaxed) != nullptr)
+			DrainRemoteBlocks(cache);
 
-	auto geo = app->geometries[geometryId];
+		block = cache->freeLists[sizeClass];
 
-	auto mesh = app->entities[meshId];	
+		if (block != nullptr) {
+			cache->freeLists[sizeClass] = block->next;
+			pool.retainedBytes.fetch_sub(classSize, std::memory_order_relaxed);
+			pool.poolHits.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
 
-	auto& rm = app->engine->getRenderableManager();
+	if (block == nullptr) {
+		block = (UploadBlock*)::operator new(sizeof(UploadBlock) + classSize, std::align_val_t(alignof(UploadBlock)));
+		block->owner = cache;
+		block->sizeClass = sizeClass;
+		pool.heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
 
-	rm.setGeometryAt(rm.getInstance(mesh), 0, 
-		geo.primitive,
-		geo.vb, geo.ib, 0, geo.ib->getIndexCount());
+	block->size = size;
+	block->tag = tag;
+	block->next = nullptr;
 
-	app->engine->destroy(oldGeo.vb);
-	app->engine->destroy(oldGeo.ib);
+	CountUpload(tag, (int64_t)size, 1);
 
-	oldGeo.vb = nullptr;
-	oldGeo.ib = nullptr;
-	oldGeo.soBuffer = nullptr;
+	return block + 1;
 }
 
+// Lock free from any thread: cached by the owner, or given back to the heap over the retained limit
+static void UploadFree(void* data) {
 
-/*
-void AddGeometryV3(FilamentApp* app, OBJID id, const GeometryInfo& info)
-{
-	auto indices = info.indices;
-	auto indicesCount = info.indicesCount;
-
-	if (info.indicesCount == 0) {
-		indices = new uint32_t[info.verticesCount];
-		for (uint32_t i = 0; i < info.verticesCount; i++)
-			indices[i] = i;
-		indicesCount = info.verticesCount;
-	}
+	if (data == nullptr)
+		return;
 
-	auto ib = IndexBuffer::Builder()
-		.indexCount(indicesCount)
-		.bufferType(IndexBuffer::IndexType::UINT)
-		.build(*app->engine);
+	auto& pool = s_uploadPool;
+	auto block = (UploadBlock*)data - 1;
 
-	auto ibSizeByte = sizeof(uint32_t) * indicesCount;
+	CountUpload(block->tag, -(int64_t)block->size, 0);
 
-	if (info.indicesCount > 0) {
-		auto ibBuffer = new uint8_t[ibSizeByte];
-		memcpy(ibBuffer, info.indices, ibSizeByte);
-		ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor(ibBuffer, ibSizeByte, DeleteBuffer, (void*)"IB"));
+	if (block->sizeClass == UPLOAD_POOL_CLASSES) {
+		FreeUploadBlock(block);
+		return;
 	}
-	else
-		ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor(indices, ibSizeByte, DeleteBuffer, (void*)"IB-GEN"));
 
+	auto classSize = UploadClassSize(block->sizeClass);
 
-	auto vbBuilder = VertexBuffer::Builder()
-		.vertexCount(info.verticesCount);
+	if (pool.retainedBytes.fetch_add(classSize, std::memory_order_relaxed) + classSize > pool.retainedLimit.load(std::memory_order_relaxed)) {
+		pool.retainedBytes.fetch_sub(classSize, std::memory_order_relaxed);
+		FreeUploadBlock(block);
+		return;
+	}
 
-	auto surfBuilder = geometry::SurfaceOrientation::Builder();
-	surfBuilder
-		.triangles((uint3*)info.indices)
-		.triangleCount(info.indicesCount / 3)
-		.vertexCount(info.verticesCount);
+	auto owner = block->owner;
 
+	if (owner == t_uploadCache) {
+		block->next = owner->freeLists[block->sizeClass];
+		owner->freeLists[block->sizeClass] = block;
+		return;
+	}
 
-	bool hasNormals = false;
-	bool hasTangents = false;
+	auto head = owner->remote.load(std::memory_order_relaxed);
+	do {
+		block->next = head;
+	} while (!owner->remote.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+}
 
-	float3* normals = nullptr;
-	float2* uvs = nullptr;
-	float3* positions = nullptr;
-	float4* tangents = nullptr;
+// Memory from Allocate is counted as Other until it's known what it's uploaded as
+static void UploadRetag(void* data, UploadTag tag) {
 
-	Geometry result;
+	auto block = (UploadBlock*)data - 1;
+	if (block->tag == tag)
+		return;
 
-	for (uint32_t i = 0; i < info.layout.attributeCount; i++) {
-		auto& attr = info.layout.attributes[i];
+	CountUpload(block->tag, -(int64_t)block->size, -1);
+	CountUpload(tag, (int64_t)block->size, 1);
 
-		filament::VertexAttribute va;
-		VertexBuffer::AttributeType at;
+	block->tag = tag;
+}
 
-		bool isMainBuffer = true;
+static UploadBlock* ReleaseUploadBlocks(UploadBlock* list, uint64_t target) {
 
-		switch (attr.type)
-		{
-		case VertexAttributeType::Position:
-			va = filament::VertexAttribute::POSITION;
-			at = VertexBuffer::AttributeType::FLOAT3;
-			positions = UnpackBuffer<float3>(info.vertices, attr.offset, info.layout.sizeByte, info.verticesCount);
-			surfBuilder.positions((float3*)positions);
+	auto& pool = s_uploadPool;
 
-			break;
-		case VertexAttributeType::Normal:
-			normals = UnpackBuffer<float3>(info.vertices, attr.offset, info.layout.sizeByte, info.verticesCount);
-			surfBuilder.normals(normals);
-			hasNormals = true;
-			isMainBuffer = false;
-			break;
-		case VertexAttributeType::Tangent:
-			va = filament::VertexAttribute::TANGENTS;
-			at = VertexBuffer::AttributeType::FLOAT4;
-			tangents = UnpackBuffer<float4>(info.vertices, attr.offset, info.layout.sizeByte, info.verticesCount);
-			surfBuilder.tangents(tangents);
-			hasTangents = false;
-			isMainBuffer = false;
-			break;
-		case VertexAttributeType::Color:
-			va = filament::VertexAttribute::COLOR;
-			at = VertexBuffer::AttributeType::FLOAT4;
-			break;
-		case VertexAttributeType::UV0:
-			va = filament::VertexAttribute::UV0;
-			at = VertexBuffer::AttributeType::FLOAT2;
-			
-			uvs = UnpackBuffer<float2>(info.vertices, attr.offset, info.layout.sizeByte, info.verticesCount);
-			surfBuilder.uvs(uvs);
+	while (list != nullptr && pool.retainedBytes.load(std::memory_order_relaxed) > target) {
+		auto next = list->next;
+		pool.retainedBytes.fetch_sub(UploadClassSize(list->sizeClass), std::memory_order_relaxed);
+		FreeUploadBlock(list);
+		list = next;
+	}
 
-			break;
-		case VertexAttributeType::UV1:
-			va = filament::VertexAttribute::UV1;
-			at = VertexBuffer::AttributeType::FLOAT2;
-			break;
-		default:
-			break;
+	return list;
+}
+
+// Only the free lists of the calling thread and of orphaned caches can be walked, the other threads
+// give back what's pending in their remote list
+uint64_t TrimUploadPool(uint64_t targetBytes) {
+
+	auto& pool = s_uploadPool;
+
+	std::lock_guard<std::mutex> lock(pool.lock);
+
+	for (auto cache : pool.threads) {
+
+		if (cache->orphaned) {
+			DrainRemoteBlocks(cache);
+			for (uint32_t i = 0; i < UPLOAD_POOL_CLASSES; i++)
+				cache->freeLists[i] = ReleaseUploadBlocks(cache->freeLists[i], targetBytes);
+			continue;
 		}
 
-		if (isMainBuffer)
-			vbBuilder.attribute(va, 0, at, attr.offset, info.layout.sizeByte);
-	};
+		auto rest = ReleaseUploadBlocks(cache->remote.exchange(nullptr, std::memory_order_acquire), targetBytes);
 
-	bool hasOrientation = hasNormals && !hasTangents;
+		while (rest != nullptr) {
+			auto next = rest->next;
+			auto head = cache->remote.load(std::memory_order_relaxed);
+			do {
+				rest->next = head;
+			} while (!cache->remote.compare_exchange_weak(head, rest, std::memory_order_release, std::memory_order_relaxed));
+			rest = next;
+		}
+	}
 
-	vbBuilder.bufferCount(hasOrientation ? 2 : 1);
+	if (auto cache = t_uploadCache) {
+		for (uint32_t i = 0; i < UPLOAD_POOL_CLASSES; i++)
+			cache->freeLists[i] = ReleaseUploadBlocks(cache->freeLists[i], targetBytes);
+	}
 
-	if (hasOrientation) {
-		vbBuilder.attribute(filament::VertexAttribute::TANGENTS, 1, VertexBuffer::AttributeType::SHORT4);
-		vbBuilder.normalized(filament::VertexAttribute::TANGENTS);
+	return pool.retainedBytes.load(std::memory_order_relaxed);
+}
+
+void SetUploadPoolLimit(uint64_t bytes) {
+	s_uploadPool.retainedLimit.store(bytes, std::memory_order_relaxed);
+	TrimUploadPool(bytes);
+}
+
+void GetUploadPoolStats(UploadPoolStats& stats) {
+
+	auto& pool = s_uploadPool;
+
+	for (uint32_t i = 0; i < (uint32_t)UploadTag::Count; i++) {
+		auto& src = pool.tags[i];
+		auto& dst = stats.tags[i];
+		dst.allocations = src.allocations.load(std::memory_order_relaxed);
+		dst.liveBytes = src.liveBytes.load(std::memory_order_relaxed);
+		dst.peakBytes = src.peakBytes.load(std::memory_order_relaxed);
+		dst.totalBytes = src.totalBytes.load(std::memory_order_relaxed);
 	}
 
-	auto vb = vbBuilder.build(*app->engine);
+	stats.retainedBytes = pool.retainedBytes.load(std::memory_order_relaxed);
+	stats.retainedLimit = pool.retainedLimit.load(std::memory_order_relaxed);
+	stats.poolHits = pool.poolHits.load(std::memory_order_relaxed);
+	stats.heapAllocations = pool.heapAllocations.load(std::memory_order_relaxed);
+}
 
-	auto vbSize = info.verticesCount * info.layout.sizeByte;
-	auto vbBuffer = new uint8_t[vbSize];
-	memcpy(vbBuffer, info.vertices, vbSize);
+static void DeleteBuffer(void* buffer, size_t size, void* user) {
+	UploadFree(buffer);
+}
 
-	vb->setBufferAt(*app->engine, 0, VertexBuffer::BufferDescriptor(vbBuffer, vbSize, DeleteBuffer, (void*)"VB"));
+// Upload bytes per tag since the last frame, GPU timings and scene counts, then published in the ring
+static void PublishFrameStats(FilamentApp* app, FrameStats& stats) {
 
-	if (hasOrientation) {
+	auto& ring = app->frameStats;
 
-		auto so = surfBuilder.
-			build();
+	for (uint32_t i = 0; i < (uint32_t)UploadTag::Count; i++) {
+		auto total = s_uploadPool.tags[i].totalBytes.load(std::memory_order_relaxed);
+		stats.uploadBytes[i] = total - ring.uploadTotals[i];
+		ring.uploadTotals[i] = total;
+	}
 
-		result.soBuffer = new short4[so->getVertexCount()];
-		memset(result.soBuffer, 0, so->getVertexCount() * sizeof(short4));
-		so->getQuats(result.soBuffer, so->getVertexCount());
-		vb->setBufferAt(*app->engine, 1, VertexBuffer::BufferDescriptor(result.soBuffer, so->getVertexCount() * sizeof(short4), DeleteBuffer, (void*)"QUAD"));
+	stats.renderables = (uint32_t)app->scene->getRenderableCount();
+	stats.lights = (uint32_t)app->scene->getLightCount();
+	stats.entities = (uint32_t)app->scene->getEntityCount();
 
-		delete so;
+	auto history = app->renderer->getFrameInfoHistory(1);
+	if (!history.empty()) {
+		auto& info = history[0];
+		stats.gpuFrameId = info.frameId;
+		stats.gpuTime = info.gpuFrameDuration / 1e6f;
+		stats.gpuTimeDenoised = info.denoisedGpuFrameDuration / 1e6f;
 	}
 
-	float3 halfSize = {
-		(info.bounds.max.x - info.bounds.min.x) / 2.0f,
-		(info.bounds.max.y - info.bounds.min.y) / 2.0f,
-		(info.bounds.max.z - info.bounds.min.z) / 2.0f
-	};
+	auto index = ring.count.load(std::memory_order_relaxed);
+	auto& slot = ring.slots[index % FRAME_STATS_HISTORY];
 
-	float3 center = {
-		(info.bounds.max.x + info.bounds.min.x) / 2.0f,
-		(info.bounds.max.y + info.bounds.min.y) / 2.0f,
-		(info.bounds.max.z + info.bounds.min.z) / 2.0f
-	};
+	auto sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
 
-	result.ib = ib;
-	result.vb = vb;
-	result.box = { center, halfSize };
+	slot.stats = stats;
 
-	app->geometries[id] = result;
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+	ring.count.store(index + 1, std::memory_order_release);
 }
 
+// False when the slot is being written or was overwritten during the copy
+static bool ReadFrameStats(const FrameStatsRing::Slot& slot, FrameStats& stats) {
+
+	auto before = slot.sequence.load(std::memory_order_acquire);
+	if (before & 1)
+		return false;
 
+	stats = slot.stats;
 
-void AddGeometryV2(FilamentApp* app, OBJID id, const GeometryInfo& info)
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot.sequence.load(std::memory_order_relaxed) == before;
+}
+
+bool GetFrameStats(FilamentApp* app, FrameStats& stats)
 {
-	auto indices = info.indices;
-	auto indicesCount = info.indicesCount;
+	auto& ring = app->frameStats;
 
-	if (info.indicesCount == 0) {
-		indices = new uint32_t[info.verticesCount];
-		for (uint32_t i = 0; i < info.verticesCount; i++)
-			indices[i] = i;
-		indicesCount = info.verticesCount;
+	for (int retry = 0; retry < 4; retry++) {
+		auto count = ring.count.load(std::memory_order_acquire);
+		if (count == 0)
+			return false;
+		if (ReadFrameStats(ring.slots[(count - 1) % FRAME_STATS_HISTORY], stats))
+			return true;
 	}
 
-	auto tangentMeshBld = geometry::TangentSpaceMesh::Builder();
+	return false;
+}
 
-	tangentMeshBld.triangles((uint3*)indices)
-		.triangleCount(info.indicesCount / 3)
-		.algorithm((geometry::TangentSpaceMesh::Algorithm)5)
-		.vertexCount(info.verticesCount);
+// Newest first, frames overwritten while reading are skipped; callable from any thread
+uint32_t GetFrameStatsHistory(FilamentApp* app, FrameStats stats[], uint32_t capacity)
+{
+	auto& ring = app->frameStats;
 
-	for (uint32_t i = 0; i < info.layout.attributeCount; i++) {
-		auto& attr = info.layout.attributes[i];
-		switch (attr.type)
-		{
-		case VertexAttributeType::Position:
-			tangentMeshBld.positions((float3*)(info.vertices + attr.offset), info.layout.sizeByte);
-			break;
-		case VertexAttributeType::Normal:
-			tangentMeshBld.normals((float3*)(info.vertices + attr.offset), info.layout.sizeByte);
-			break;
-		case VertexAttributeType::Tangent:
-			tangentMeshBld.tangents((float4*)(info.vertices + attr.offset), info.layout.sizeByte);
-			break;
-		case VertexAttributeType::UV0:
-			tangentMeshBld.uvs((float2*)(info.vertices + attr.offset), info.layout.sizeByte);
-			break;
-		}
-	};
+	auto count = ring.count.load(std::memory_order_acquire);
+	auto available = (uint32_t)std::min<uint64_t>({ count, FRAME_STATS_HISTORY, capacity });
 
-	auto tangentMesh = tangentMeshBld
-		.build();
+	uint32_t result = 0;
+
+	for (uint32_t i = 0; i < available; i++) {
+		if (ReadFrameStats(ring.slots[(count - 1 - i) % FRAME_STATS_HISTORY], stats[result]))
+			result++;
+	}
+
+	return result;
+}
+
+
+
+template <typename T>
+T* UnpackBuffer(uint8_t* pSrc, int offset, size_t stride, size_t count) {
+	T* pDst = new T[count];
+	T* curDst = pDst;
+	pSrc += offset;
+	while (count-- > 0)
+	{
+		*curDst = *(T*)pSrc;
+		pSrc += stride;
+		curDst++;
+	}
+	return pDst;
+}
+
+// Tagged as Other until the native side knows what the memory is uploaded as
+uint8_t* Allocate(size_t size) {
+	return (uint8_t*)UploadAlloc(size, UploadTag::Other);
+}
+
+struct BufferRelease {
+	ReleaseBufferFunc release;
+	void* user;
+};
+
+static void ReleaseBuffer(void* buffer, size_t size, void* user) {
+	auto ctx = (BufferRelease*)user;
+	ctx->release(buffer, ctx->user);
+	delete ctx;
+}
+
+// Wraps geometry memory in a descriptor according to info.upload, only Copy duplicates it
+static IndexBuffer::BufferDescriptor GeometryBuffer(const GeometryInfo& info, void* data, size_t size, void* user, const char* tag) {
+
+	switch (info.upload) {
+	case GeometryUpload::Owned:
+		UploadRetag(data, UploadTagFromName(tag));
+		return IndexBuffer::BufferDescriptor(data, size, DeleteBuffer, (void*)tag);
+	case GeometryUpload::Borrowed:
+		if (info.release == nullptr)
+			return IndexBuffer::BufferDescriptor(data, size);
+		return IndexBuffer::BufferDescriptor(data, size, ReleaseBuffer, new BufferRelease{ info.release, user });
+	default:
+		auto copy = UploadAlloc(size, UploadTagFromName(tag));
+		memcpy(copy, data, size);
+		return IndexBuffer::BufferDescriptor(copy, size, DeleteBuffer, (void*)tag);
+	}
+}
 
+// Filament always draws indexed: non indexed geometry draws a prefix of one shared 0..n buffer
+static IndexBuffer* GetSequentialIndices(FilamentApp* app, uint32_t count) {
+
+	auto& buffers = app->sequentialIndices;
+
+	if (!buffers.empty() && buffers.back()->getIndexCount() >= count)
+		return buffers.back();
+
+	uint32_t size = buffers.empty() ? 1024 : buffers.back()->getIndexCount() * 2;
+	while (size < count)
+		size *= 2;
 
 	auto ib = IndexBuffer::Builder()
-		.indexCount(tangentMesh->getTriangleCount() * 3)
+		.indexCount(size)
 		.bufferType(IndexBuffer::IndexType::UINT)
 		.build(*app->engine);
 
-	auto ibBuffer = new uint3[tangentMesh->getTriangleCount()];
-	tangentMesh->getTriangles(ibBuffer);
-	ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor(ibBuffer, sizeof(uint3) * tangentMesh->getTriangleCount(), DeleteBuffer));
+	auto indices = (uint32_t*)UploadAlloc(size * sizeof(uint32_t), UploadTag::IB);
+	for (uint32_t i = 0; i < size; i++)
+		indices[i] = i;
 
-	auto vb = VertexBuffer::Builder()
-		.vertexCount(tangentMesh->getVertexCount())
-		.bufferCount(1)
-		.attribute(filament::VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3, 0, 36)
-		.attribute(filament::VertexAttribute::UV0, 0, VertexBuffer::AttributeType::FLOAT2, 12, 36)
-		.attribute(filament::VertexAttribute::TANGENTS, 0, VertexBuffer::AttributeType::FLOAT2, 20, 36)
-		.build(*app->engine);
+	ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor(indices, size * sizeof(uint32_t), DeleteBuffer, (void*)"IB-SEQ"));
 
+	buffers.push_back(ib);
 
-	auto vbBuffer = new uint8_t[tangentMesh->getVertexCount() * 36];
-	tangentMesh->getPositions((float3*)vbBuffer, 36);
-	tangentMesh->getUVs((float2*)(vbBuffer + 12), 36);
-	tangentMesh->getQuats((quatf*)(vbBuffer + 20), 36);
+	return ib;
+}
+
+
+static void ReleaseGeometrySource(const GeometryInfo& info, void* data, void* user) {
+	if (info.upload == GeometryUpload::Owned)
+		UploadFree(data);
+	else if (info.upload == GeometryUpload::Borrowed && info.release != nullptr)
+		info.release(data, user);
+}
+
+static void ResolveVertexFormat(VertexFormat format, VertexBuffer::AttributeType& type, bool& normalized, uint32_t& size) {
+
+	normalized = false;
+
+	switch (format) {
+	case VertexFormat::Float2: type = VertexBuffer::AttributeType::FLOAT2; size = 8; break;
+	case VertexFormat::Float3: type = VertexBuffer::AttributeType::FLOAT3; size = 12; break;
+	case VertexFormat::Float4: type = VertexBuffer::AttributeType::FLOAT4; size = 16; break;
+	case VertexFormat::Half2: type = VertexBuffer::AttributeType::HALF2; size = 4; break;
+	case VertexFormat::Half4: type = VertexBuffer::AttributeType::HALF4; size = 8; break;
+	case VertexFormat::UByte4Norm: type = VertexBuffer::AttributeType::UBYTE4; size = 4; normalized = true; break;
+	case VertexFormat::Short2Norm: type = VertexBuffer::AttributeType::SHORT2; size = 4; normalized = true; break;
+	case VertexFormat::Short4Norm: type = VertexBuffer::AttributeType::SHORT4; size = 8; normalized = true; break;
+	case VertexFormat::UShort2Norm: type = VertexBuffer::AttributeType::USHORT2; size = 4; normalized = true; break;
+	default: break;
+	}
+}
+
+enum class VertexConvert {
+	None,
+	HalfUV,
+	UByteColor
+};
+
+struct PackedAttribute {
+	filament::VertexAttribute va;
+	VertexBuffer::AttributeType type;
+	bool normalized;
+	uint32_t srcOffset;
+	uint32_t dstOffset;
+	uint32_t size;
+	VertexConvert convert;
+};
+
+// What the shader reads from one vertex of an attribute, components past the format's are 0
+static void DecodeVertexFloats(VertexFormat format, const uint8_t* src, float* out, uint32_t components) {
+
+	float v[4] = {};
+
+	switch (format) {
+	case VertexFormat::Default: memcpy(v, src, components * sizeof(float)); break;
+	case VertexFormat::Float2: memcpy(v, src, 8); break;
+	case VertexFormat::Float3: memcpy(v, src, 12); break;
+	case VertexFormat::Float4: memcpy(v, src, 16); break;
+	case VertexFormat::Half2:
+	case VertexFormat::Half4: {
+		half h[4] = {};
+		memcpy(h, src, format == VertexFormat::Half2 ? 4 : 8);
+		for (int c = 0; c < 4; c++)
+			v[c] = float(h[c]);
+		break;
+	}
+	case VertexFormat::UByte4Norm:
+		for (int c = 0; c < 4; c++)
+			v[c] = src[c] / 255.0f;
+		break;
+	case VertexFormat::Short2Norm:
+	case VertexFormat::Short4Norm: {
+		int16_t s[4] = {};
+		memcpy(s, src, format == VertexFormat::Short2Norm ? 4 : 8);
+		for (int c = 0; c < 4; c++)
+			v[c] = std::max(s[c] / 32767.0f, -1.0f);
+		break;
+	}
+	case VertexFormat::UShort2Norm: {
+		uint16_t u[2];
+		memcpy(u, src, 4);
+		v[0] = u[0] / 65535.0f;
+		v[1] = u[1] / 65535.0f;
+		break;
+	}
+	}
+
+	memcpy(out, v, components * sizeof(float));
+}
+
+static void PackVertices(const GeometryInfo& info, const std::vector<PackedAttribute>& attributes, uint32_t stride, uint8_t* dst) {
+
+	for (auto& attr : attributes) {
+
+		auto src = info.vertices + attr.srcOffset;
+		auto out = dst + attr.dstOffset;
+
+		for (uint32_t i = 0; i < info.verticesCount; i++, src += info.layout.sizeByte, out += stride) {
+			switch (attr.convert) {
+			case VertexConvert::HalfUV: {
+				auto uv = (const float*)src;
+				auto h = (half*)out;
+				h[0] = half(uv[0]);
+				h[1] = half(uv[1]);
+				break;
+			}
+			case VertexConvert::UByteColor: {
+				auto color = (const float*)src;
+				for (int c = 0; c < 4; c++)
+					out[c] = (uint8_t)(std::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+				break;
+			}
+			default:
+				memcpy(out, src, attr.size);
+				break;
+			}
+		}
+	}
+}
+
+struct OrientationSource {
+	const uint8_t* positions;
+	const uint8_t* normals;
+	const uint8_t* tangents;
+	const uint8_t* uvs;
+	uint32_t stride;
+	uint32_t vertexCount;
+	const void* indices;
+	bool shortIndices;
+	uint32_t triangleCount;
+};
+
+static void BuildQuats(const OrientationSource& src, short4* quats, bool normalsOnly) {
+
+	auto builder = geometry::SurfaceOrientation::Builder();
+	builder
+		.vertexCount(src.vertexCount)
+		.normals((const float3*)src.normals, src.stride);
+
+	if (!normalsOnly) {
+		builder.triangleCount(src.triangleCount);
+		if (src.shortIndices)
+			builder.triangles((const ushort3*)src.indices);
+		else
+			builder.triangles((const uint3*)src.indices);
+		if (src.positions)
+			builder.positions((const float3*)src.positions, src.stride);
+		if (src.tangents)
+			builder.tangents((const float4*)src.tangents, src.stride);
+		if (src.uvs)
+			builder.uvs((const float2*)src.uvs, src.stride);
+	}
+
+	auto so = builder.build();
+	so->getQuats(quats, src.vertexCount);
+	delete so;
+}
+
+// Points src at the position, normal, tangent and uv0 of the vertices (src.stride apart). SurfaceOrientation reads
+// floats only: when any of them is packed, all are decoded to 'decoded' and src is pointed there instead
+static void ResolveOrientationInputs(OrientationSource& src, const uint8_t* vertices, const ::VertexAttribute* const attributes[4], std::vector<float>& decoded) {
+
+	const uint8_t** targets[4] = { &src.positions, &src.normals, &src.tangents, &src.uvs };
+	const uint32_t components[4] = { 3, 3, 4, 2 };
+	const uint32_t offsets[4] = { 0, 3, 6, 10 };
+
+	bool packed = false;
+	for (uint32_t a = 0; a < 4; a++)
+		packed |= attributes[a] != nullptr && attributes[a]->format != VertexFormat::Default;
+
+	const uint32_t stride = src.stride;
+
+	if (packed) {
+		decoded.resize((size_t)src.vertexCount * 12);
+		src.stride = 12 * sizeof(float);
+	}
+
+	for (uint32_t a = 0; a < 4; a++) {
+		auto attr = attributes[a];
+		if (attr == nullptr)
+			continue;
+		if (!packed) {
+			*targets[a] = vertices + attr->offset;
+			continue;
+		}
+		auto data = vertices + attr->offset;
+		for (uint32_t i = 0; i < src.vertexCount; i++, data += stride)
+			DecodeVertexFloats(attr->format, data, &decoded[(size_t)i * 12 + offsets[a]], components[a]);
+		*targets[a] = (const uint8_t*)(decoded.data() + offsets[a]);
+	}
+
+	// The uv based generation needs the positions too
+	if (src.positions == nullptr)
+		src.uvs = nullptr;
+}
+
+// Only the uv based generation walks the triangles, the normals / tangents paths are cheap enough inline
+static bool IsOrientationCostly(const OrientationSource& src) {
+	return src.tangents == nullptr && src.positions != nullptr && src.uvs != nullptr && src.triangleCount > 0;
+}
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+
+	auto p = (const uint8_t*)data;
+
+	for (; size >= 8; p += 8, size -= 8) {
+		uint64_t word;
+		memcpy(&word, p, 8);
+		hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+		hash ^= hash >> 29;
+	}
+
+	for (; size > 0; p++, size--)
+		hash = (hash ^ *p) * 0x100000001B3ull;
+
+	return hash;
+}
+
+// Content hash of everything the generation reads, keys the tangent cache
+static uint64_t HashOrientation(const OrientationSource& src) {
+
+	uint64_t hash = HashBytes(0xCBF29CE484222325ull, QUAT_VERSION, strlen(QUAT_VERSION));
+	hash = HashBytes(hash, &src.vertexCount, sizeof(uint32_t));
+	hash = HashBytes(hash, &src.triangleCount, sizeof(uint32_t));
+
+	for (uint32_t i = 0; i < src.vertexCount; i++) {
+		auto offset = (size_t)i * src.stride;
+		hash = HashBytes(hash, src.positions + offset, sizeof(float3));
+		hash = HashBytes(hash, src.normals + offset, sizeof(float3));
+		hash = HashBytes(hash, src.uvs + offset, sizeof(float2));
+	}
+
+	return HashBytes(hash, src.indices, (size_t)src.triangleCount * 3 * (src.shortIndices ? sizeof(uint16_t) : sizeof(uint32_t)));
+}
+
+static std::string QuatCacheFile(FilamentApp* app, uint64_t hash) {
+
+	if (app->materialCachePath.length() == 0)
+		return std::string();
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.quat", (unsigned long long)hash);
+
+	return app->materialCachePath + "/" + name;
+}
+
+static bool LoadQuats(const std::string& fileName, short4* quats, uint32_t count) {
+
+	if (fileName.length() == 0 || !std::filesystem::exists(fileName))
+		return false;
+
+	FILE* fd;
+	if (fopen_s(&fd, fileName.c_str(), "rb") != 0)
+		return false;
+
+	uint32_t header[2];
+	bool ok = fread(header, sizeof(header), 1, fd) == 1 &&
+		header[0] == QUAT_CACHE_MAGIC && header[1] == count &&
+		fread(quats, sizeof(short4), count, fd) == count;
+
+	fclose(fd);
+
+	return ok;
+}
+
+// Written aside and renamed, a reader never sees a partial file
+static void SaveQuats(const std::string& fileName, const short4* quats, uint32_t count) {
+
+	if (fileName.length() == 0)
+		return;
+
+	auto tmpName = fileName + ".tmp";
+
+	FILE* fd;
+	if (fopen_s(&fd, tmpName.c_str(), "wb") != 0)
+		return;
+
+	uint32_t header[2] = { QUAT_CACHE_MAGIC, count };
+	bool ok = fwrite(header, sizeof(header), 1, fd) == 1 &&
+		fwrite(quats, sizeof(short4), count, fd) == count;
+
+	fclose(fd);
+
+	std::error_code ec;
+	if (ok)
+		std::filesystem::rename(tmpName, fileName, ec);
+	else
+		std::filesystem::remove(tmpName, ec);
+}
+
+static void QueueOrientation(FilamentApp* app, VertexBuffer* vb, const OrientationSource& src, std::string&& cacheFile) {
+
+	auto task = new OrientationTask();
+	task->vb = vb;
+	task->vertexCount = src.vertexCount;
+	task->triangleCount = src.triangleCount;
+	task->vertices = new OrientationVertex[src.vertexCount];
+	task->indices = new uint32_t[(size_t)src.triangleCount * 3];
+	task->quats = (short4*)UploadAlloc(src.vertexCount * sizeof(short4), UploadTag::QUAD);
+	task->cacheFile = std::move(cacheFile);
+	task->done.store(false, std::memory_order_relaxed);
+
+	for (uint32_t i = 0; i < src.vertexCount; i++) {
+		auto offset = (size_t)i * src.stride;
+		auto& v = task->vertices[i];
+		memcpy(&v.position, src.positions + offset, sizeof(float3));
+		memcpy(&v.normal, src.normals + offset, sizeof(float3));
+		memcpy(&v.uv, src.uvs + offset, sizeof(float2));
+	}
+
+	auto indexCount = (size_t)src.triangleCount * 3;
+	if (src.shortIndices) {
+		auto indices = (const uint16_t*)src.indices;
+		for (size_t i = 0; i < indexCount; i++)
+			task->indices[i] = indices[i];
+	}
+	else
+		memcpy(task->indices, src.indices, indexCount * sizeof(uint32_t));
+
+	auto& js = app->engine->getJobSystem();
+
+	task->job = jobs::createJob(js, nullptr, [task]() {
+
+		OrientationSource src = {};
+		src.positions = (const uint8_t*)&task->vertices[0].position;
+		src.normals = (const uint8_t*)&task->vertices[0].normal;
+		src.uvs = (const uint8_t*)&task->vertices[0].uv;
+		src.stride = sizeof(OrientationVertex);
+		src.vertexCount = task->vertexCount;
+		src.indices = task->indices;
+		src.triangleCount = task->triangleCount;
+
+		BuildQuats(src, task->quats, false);
+		SaveQuats(task->cacheFile, task->quats, task->vertexCount);
+
+		task->done.store(true, std::memory_order_release);
+	});
+
+	js.runAndRetain(task->job);
+
+	app->orientationTasks.push_back(task);
+}
+
+// Uploads the finished tangent frames over their placeholder; wait blocks until every job is done
+static void CompleteOrientationTasks(FilamentApp* app, bool wait) {
+
+	auto& tasks = app->orientationTasks;
+	if (tasks.empty())
+		return;
+
+	auto& js = app->engine->getJobSystem();
+
+	for (size_t i = 0; i < tasks.size();) {
+
+		auto task = tasks[i];
+
+		if (wait)
+			js.waitAndRelease(task->job);
+		else if (task->done.load(std::memory_order_acquire))
+			js.release(task->job);
+		else {
+			i++;
+			continue;
+		}
+
+		if (task->vb)
+			task->vb->setBufferAt(*app->engine, 1, VertexBuffer::BufferDescriptor(task->quats, task->vertexCount * sizeof(short4), DeleteBuffer, (void*)"QUAD"));
+		else
+			UploadFree(task->quats);
+
+		delete[] task->vertices;
+		delete[] task->indices;
+		delete task;
+
+		tasks[i] = tasks.back();
+		tasks.pop_back();
+	}
+}
+
+static void CancelOrientation(FilamentApp* app, VertexBuffer* vb) {
+	for (auto task : app->orientationTasks) {
+		if (task->vb == vb)
+			task->vb = nullptr;
+	}
+}
+
+void WaitGeometryJobs(FilamentApp* app) {
+	CompleteOrientationTasks(app, true);
+}
+
+static Box BoundsToBox(const Bounds3& bounds) {
+
+	float3 halfSize = {
+		(bounds.max.x - bounds.min.x) / 2.0f,
+		(bounds.max.y - bounds.min.y) / 2.0f,
+		(bounds.max.z - bounds.min.z) / 2.0f
+	};
+
+	float3 center = {
+		(bounds.max.x + bounds.min.x) / 2.0f,
+		(bounds.max.y + bounds.min.y) / 2.0f,
+		(bounds.max.z + bounds.min.z) / 2.0f
+	};
+
+	return { center, halfSize };
+}
+
+OBJHANDLE AddGeometry(FilamentApp* app, OBJID id, const GeometryInfo& info)
+{
+	Geometry result = {};
+
+	const bool srcShortIndices = info.indexFormat == IndexFormat::UShort;
+	const bool shortIndices = srcShortIndices || ((info.quantize & QUANTIZE_INDICES) != 0 && info.verticesCount < 65536);
+
+	if (info.indicesCount > 0) {
+
+		result.ib = IndexBuffer::Builder()
+			.indexCount(info.indicesCount)
+			.bufferType(shortIndices ? IndexBuffer::IndexType::USHORT : IndexBuffer::IndexType::UINT)
+			.build(*app->engine);
+
+		result.indexCount = info.indicesCount;
+		result.sharedIb = false;
+	}
+	else {
+		result.ib = GetSequentialIndices(app, info.verticesCount);
+		result.indexCount = info.verticesCount;
+		result.sharedIb = true;
+	}
+
+	auto vbBuilder = VertexBuffer::Builder()
+		.vertexCount(info.verticesCount);
+
+	OrientationSource soSource = {};
+	soSource.stride = info.layout.sizeByte;
+	soSource.vertexCount = info.verticesCount;
+	soSource.indices = info.indices;
+	soSource.shortIndices = srcShortIndices;
+	soSource.triangleCount = info.indicesCount / 3;
+
+	bool hasNormals = false;
+	bool hasTangents = false;
+
+	// Position, normal, tangent and uv0 read by the orientation
+	const ::VertexAttribute* soAttributes[4] = {};
+
+	std::vector<PackedAttribute> attributes;
+	bool mustPack = false;
+
+	for (uint32_t i = 0; i < info.layout.attributeCount; i++) {
+		auto& attr = info.layout.attributes[i];
+
+		const bool isFloat = attr.format == VertexFormat::Default;
+
+		PackedAttribute packed = {};
+		packed.srcOffset = attr.offset;
+		packed.convert = VertexConvert::None;
+
+		switch (attr.type)
+		{
+		case VertexAttributeType::Position:
+			packed.va = filament::VertexAttribute::POSITION;
+			packed.type = VertexBuffer::AttributeType::FLOAT3;
+			packed.size = 12;
+			soAttributes[0] = &attr;
+			break;
+		case VertexAttributeType::Normal:
+			soAttributes[1] = &attr;
+			hasNormals = true;
+			continue;
+		case VertexAttributeType::Tangent:
+			soAttributes[2] = &attr;
+			continue;
+		case VertexAttributeType::Color:
+			packed.va = filament::VertexAttribute::COLOR;
+			packed.type = VertexBuffer::AttributeType::FLOAT4;
+			packed.size = 16;
+			if (isFloat && (info.quantize & QUANTIZE_COLOR) != 0) {
+				packed.type = VertexBuffer::AttributeType::UBYTE4;
+				packed.normalized = true;
+				packed.size = 4;
+				packed.convert = VertexConvert::UByteColor;
+			}
+			break;
+		case VertexAttributeType::UV0:
+		case VertexAttributeType::UV1:
+			packed.va = attr.type == VertexAttributeType::UV0 ? filament::VertexAttribute::UV0 : filament::VertexAttribute::UV1;
+			packed.type = VertexBuffer::AttributeType::FLOAT2;
+			packed.size = 8;
+			if (attr.type == VertexAttributeType::UV0)
+				soAttributes[3] = &attr;
+			if (isFloat && (info.quantize & QUANTIZE_UV) != 0) {
+				packed.type = VertexBuffer::AttributeType::HALF2;
+				packed.size = 4;
+				packed.convert = VertexConvert::HalfUV;
+			}
+			break;
+		default:
+			continue;
+		}
+
+		if (!isFloat)
+			ResolveVertexFormat(attr.format, packed.type, packed.normalized, packed.size);
+
+		mustPack |= packed.convert != VertexConvert::None;
+
+		attributes.push_back(packed);
+	};
+
+	// Converted attributes are repacked tight (4 bytes aligned), otherwise the source layout is uploaded as is
+	uint32_t stride = 0;
+
+	for (auto& attr : attributes) {
+		if (mustPack) {
+			attr.dstOffset = stride;
+			stride += (attr.size + 3) & ~3u;
+		}
+		else
+			attr.dstOffset = attr.srcOffset;
+	}
+
+	if (!mustPack)
+		stride = info.layout.sizeByte;
+
+	for (auto& attr : attributes) {
+		vbBuilder.attribute(attr.va, 0, attr.type, attr.dstOffset, stride);
+		if (attr.normalized)
+			vbBuilder.normalized(attr.va);
+	}
+
+	bool hasOrientation = hasNormals && !hasTangents && info.primitive == PrimitiveType::TRIANGLES;
+
+	vbBuilder.bufferCount(hasOrientation ? 2 : 1);
+
+	if (hasOrientation) {
+		vbBuilder.attribute(filament::VertexAttribute::TANGENTS, 1, VertexBuffer::AttributeType::SHORT4);
+		vbBuilder.normalized(filament::VertexAttribute::TANGENTS);
+	}
+
+	auto vb = vbBuilder.build(*app->engine);
+
+	std::vector<float> soDecoded;
+
+	if (hasOrientation)
+		ResolveOrientationInputs(soSource, info.vertices, soAttributes, soDecoded);
+
+	// Non indexed triangles still need a triangle list for the uv based generation, 0..n as the baseline did
+	std::vector<uint32_t> sequential;
+
+	if (hasOrientation && info.indicesCount == 0) {
+		sequential.resize(info.verticesCount - info.verticesCount % 3);
+		for (uint32_t i = 0; i < sequential.size(); i++)
+			sequential[i] = i;
+		soSource.indices = sequential.data();
+		soSource.shortIndices = false;
+		soSource.triangleCount = (uint32_t)sequential.size() / 3;
+	}
+
+	if (hasOrientation) {
+
+		result.soBuffer = (short4*)UploadAlloc(info.verticesCount * sizeof(short4), UploadTag::QUAD);
+
+		if (!IsOrientationCostly(soSource))
+			BuildQuats(soSource, result.soBuffer, false);
+		else {
+			auto cacheFile = QuatCacheFile(app, HashOrientation(soSource));
+			// Shading from the normals alone until the full frame is ready
+			if (!LoadQuats(cacheFile, result.soBuffer, info.verticesCount)) {
+				BuildQuats(soSource, result.soBuffer, true);
+				QueueOrientation(app, vb, soSource, std::move(cacheFile));
+			}
+		}
+
+		vb->setBufferAt(*app->engine, 1, VertexBuffer::BufferDescriptor(result.soBuffer, info.verticesCount * sizeof(short4), DeleteBuffer, (void*)"QUAD"));
+	}
+
+	// Queued after the surface orientation is done reading vertices and indices, a borrowed buffer can be released as soon as it's uploaded
+	if (mustPack) {
+		auto packedSize = (size_t)info.verticesCount * stride;
+		auto packed = (uint8_t*)UploadAlloc(packedSize, UploadTag::VB);
+		PackVertices(info, attributes, stride, packed);
+		vb->setBufferAt(*app->engine, 0, VertexBuffer::BufferDescriptor(packed, packedSize, DeleteBuffer, (void*)"VB"));
+		ReleaseGeometrySource(info, info.vertices, info.verticesUser);
+	}
+	else {
+		auto vbSize = (size_t)info.verticesCount * info.layout.sizeByte;
+		vb->setBufferAt(*app->engine, 0, GeometryBuffer(info, info.vertices, vbSize, info.verticesUser, "VB"));
+	}
+
+	if (!result.sharedIb) {
+		if (shortIndices && !srcShortIndices) {
+			auto indices = (uint16_t*)UploadAlloc(sizeof(uint16_t) * info.indicesCount, UploadTag::IB);
+			for (uint32_t i = 0; i < info.indicesCount; i++)
+				indices[i] = (uint16_t)info.indices[i];
+			result.ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor(indices, sizeof(uint16_t) * info.indicesCount, DeleteBuffer, (void*)"IB"));
+			ReleaseGeometrySource(info, info.indices, info.indicesUser);
+		}
+		else
+			result.ib->setBuffer(*app->engine, GeometryBuffer(info, info.indices, (shortIndices ? sizeof(uint16_t) : sizeof(uint32_t)) * info.indicesCount, info.indicesUser, "IB"));
+	}
+
+	result.vb = vb;
+	result.box = BoundsToBox(info.bounds);
+	result.primitive = info.primitive;	
+
+	return app->geometries.set(id, result);
+}
+
+static void SlotUploaded(void* buffer, size_t size, void* user) {
+	((DynamicGeometrySlot*)user)->pending.fetch_sub(1, std::memory_order_release);
+}
+
+static void ResetDirty(DynamicGeometrySlot& slot) {
+	slot.dirtyVertexBegin = UINT32_MAX;
+	slot.dirtyVertexEnd = 0;
+	slot.dirtyIndexBegin = UINT32_MAX;
+	slot.dirtyIndexEnd = 0;
+}
+
+static void MarkDirty(DynamicGeometry* dyn, uint32_t vertexBegin, uint32_t vertexEnd, uint32_t indexBegin, uint32_t indexEnd) {
+
+	for (uint32_t i = 0; i < dyn->bufferCount; i++) {
+		auto& slot = dyn->slots[i];
+		if (vertexBegin < vertexEnd) {
+			slot.dirtyVertexBegin = std::min(slot.dirtyVertexBegin, vertexBegin);
+			slot.dirtyVertexEnd = std::max(slot.dirtyVertexEnd, vertexEnd);
+		}
+		if (indexBegin < indexEnd) {
+			slot.dirtyIndexBegin = std::min(slot.dirtyIndexBegin, indexBegin);
+			slot.dirtyIndexEnd = std::max(slot.dirtyIndexEnd, indexEnd);
+		}
+	}
+}
+
+static DynamicGeometry* CreateDynamicGeometry(FilamentApp* app, const ::VertexAttribute* attributes, uint32_t attributeCount, uint32_t stride,
+	PrimitiveType primitive, bool indexed, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t bufferCount) {
+
+	auto dyn = new DynamicGeometry();
+	dyn->attributes.assign(attributes, attributes + attributeCount);
+	dyn->stride = stride;
+	dyn->primitive = primitive;
+	dyn->indexed = indexed;
+	dyn->vertexCapacity = vertexCapacity;
+	dyn->indexCapacity = indexed ? indexCapacity : 0;
+	dyn->vertexCount = 0;
+	dyn->indexCount = 0;
+	dyn->bufferCount = bufferCount;
+	dyn->current = 0;
+
+	auto vbBuilder = VertexBuffer::Builder()
+		.vertexCount(vertexCapacity);
+
+	bool hasNormals = false;
+
+	// Same layout as the source, no quantization: updates are copied as they are
+	for (auto& attr : dyn->attributes) {
+
+		filament::VertexAttribute va;
+		VertexBuffer::AttributeType type;
+		bool normalized = false;
+		uint32_t size = 0;
+
+		switch (attr.type)
+		{
+		case VertexAttributeType::Position:
+			va = filament::VertexAttribute::POSITION;
+			type = VertexBuffer::AttributeType::FLOAT3;
+			break;
+		case VertexAttributeType::Normal:
+			hasNormals = true;
+			continue;
+		case VertexAttributeType::Color:
+			va = filament::VertexAttribute::COLOR;
+			type = VertexBuffer::AttributeType::FLOAT4;
+			break;
+		case VertexAttributeType::UV0:
+		case VertexAttributeType::UV1:
+			va = attr.type == VertexAttributeType::UV0 ? filament::VertexAttribute::UV0 : filament::VertexAttribute::UV1;
+			type = VertexBuffer::AttributeType::FLOAT2;
+			break;
+		default:
+			continue;
+		}
+
+		if (attr.format != VertexFormat::Default)
+			ResolveVertexFormat(attr.format, type, normalized, size);
+
+		vbBuilder.attribute(va, 0, type, attr.offset, stride);
+		if (normalized)
+			vbBuilder.normalized(va);
+	}
+
+	dyn->hasOrientation = hasNormals && primitive == PrimitiveType::TRIANGLES;
+
+	if (dyn->hasOrientation && !indexed) {
+		dyn->sequential.resize(vertexCapacity);
+		for (uint32_t i = 0; i < vertexCapacity; i++)
+			dyn->sequential[i] = i;
+	}
+
+	vbBuilder.bufferCount(dyn->hasOrientation ? 2 : 1);
+
+	if (dyn->hasOrientation) {
+		vbBuilder.attribute(filament::VertexAttribute::TANGENTS, 1, VertexBuffer::AttributeType::SHORT4);
+		vbBuilder.normalized(filament::VertexAttribute::TANGENTS);
+	}
+
+	for (uint32_t i = 0; i < bufferCount; i++) {
+		auto& slot = dyn->slots[i];
+
+		slot.vb = vbBuilder.build(*app->engine);
+		slot.vertices = new uint8_t[(size_t)vertexCapacity * stride];
+		slot.quats = dyn->hasOrientation ? new short4[vertexCapacity] : nullptr;
+
+		if (indexed) {
+			slot.ib = IndexBuffer::Builder()
+				.indexCount(indexCapacity)
+				.bufferType(IndexBuffer::IndexType::UINT)
+				.build(*app->engine);
+			slot.indices = new uint32_t[indexCapacity];
+		}
+		else {
+			slot.ib = GetSequentialIndices(app, vertexCapacity);
+			slot.indices = nullptr;
+		}
+
+		slot.pending.store(0, std::memory_order_relaxed);
+		ResetDirty(slot);
+	}
+
+	return dyn;
+}
+
+static void DestroyDynamicGeometry(FilamentApp* app, DynamicGeometry* dyn) {
+
+	// Staging memory can't go away while the driver still reads it
+	for (uint32_t i = 0; i < dyn->bufferCount; i++) {
+		if (dyn->slots[i].pending.load(std::memory_order_acquire) != 0) {
+			app->engine->flushAndWait();
+			break;
+		}
+	}
+
+	for (uint32_t i = 0; i < dyn->bufferCount; i++) {
+		auto& slot = dyn->slots[i];
+		app->engine->destroy(slot.vb);
+		if (dyn->indexed)
+			app->engine->destroy(slot.ib);
+		delete[] slot.vertices;
+		delete[] slot.indices;
+		delete[] slot.quats;
+	}
+
+	delete dyn;
+}
+
+static void ComputeOrientation(DynamicGeometry* dyn, DynamicGeometrySlot& slot) {
+
+	OrientationSource src = {};
+	src.stride = dyn->stride;
+	src.vertexCount = dyn->vertexCount;
+	src.indices = dyn->indexed ? slot.indices : dyn->sequential.data();
+	src.triangleCount = (dyn->indexed ? dyn->indexCount : dyn->vertexCount) / 3;
+
+	const ::VertexAttribute* attributes[4] = {};
+
+	for (auto& attr : dyn->attributes) {
+		switch (attr.type)
+		{
+		case VertexAttributeType::Position: attributes[0] = &attr; break;
+		case VertexAttributeType::Normal: attributes[1] = &attr; break;
+		case VertexAttributeType::Tangent: attributes[2] = &attr; break;
+		case VertexAttributeType::UV0: attributes[3] = &attr; break;
+		default: break;
+		}
+	}
+
+	std::vector<float> decoded;
+	ResolveOrientationInputs(src, slot.vertices, attributes, decoded);
+
+	BuildQuats(src, slot.quats, false);
+}
+
+// Uploads what changed since the slot was last used, straight from its staging memory
+static void UploadSlot(FilamentApp* app, DynamicGeometry* dyn, DynamicGeometrySlot& slot) {
+
+	if (slot.dirtyVertexBegin < slot.dirtyVertexEnd) {
+		auto offset = (size_t)slot.dirtyVertexBegin * dyn->stride;
+		auto size = (size_t)(slot.dirtyVertexEnd - slot.dirtyVertexBegin) * dyn->stride;
+		slot.pending.fetch_add(1, std::memory_order_relaxed);
+		slot.vb->setBufferAt(*app->engine, 0, VertexBuffer::BufferDescriptor(slot.vertices + offset, size, SlotUploaded, &slot), (uint32_t)offset);
+	}
+
+	if (dyn->indexed && slot.dirtyIndexBegin < slot.dirtyIndexEnd) {
+		auto offset = (size_t)slot.dirtyIndexBegin * sizeof(uint32_t);
+		auto size = (size_t)(slot.dirtyIndexEnd - slot.dirtyIndexBegin) * sizeof(uint32_t);
+		slot.pending.fetch_add(1, std::memory_order_relaxed);
+		slot.ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor((uint8_t*)slot.indices + offset, size, SlotUploaded, &slot), (uint32_t)offset);
+	}
+
+	// Orientation depends on the neighbour triangles, always recomputed as a whole
+	if (dyn->hasOrientation && dyn->vertexCount > 0) {
+		ComputeOrientation(dyn, slot);
+		slot.pending.fetch_add(1, std::memory_order_relaxed);
+		slot.vb->setBufferAt(*app->engine, 1, VertexBuffer::BufferDescriptor(slot.quats, dyn->vertexCount * sizeof(short4), SlotUploaded, &slot));
+	}
+
+	ResetDirty(slot);
+}
+
+static InstancedMesh* FindInstancedMesh(FilamentApp* app, Entity entity) {
+	for (auto& item : app->instancedMeshes) {
+		if (item.second->entity == entity)
+			return item.second;
+	}
+	return nullptr;
+}
+
+// Points the geometry and every mesh using it to the current slot
+static void BindDynamicGeometry(FilamentApp* app, Geometry& geo, const Box& box) {
+
+	auto dyn = geo.dynamic;
+	auto& slot = dyn->slots[dyn->current];
+
+	geo.vb = slot.vb;
+	geo.ib = slot.ib;
+	geo.indexCount = dyn->indexed ? dyn->indexCount : dyn->vertexCount;
+	geo.sharedIb = !dyn->indexed;
+	geo.primitive = dyn->primitive;
+	geo.box = box;
+
+	auto& rm = app->engine->getRenderableManager();
+
+	for (auto mesh : dyn->meshes) {
+		auto instance = rm.getInstance(mesh);
+		if (!instance.isValid())
+			continue;
+		rm.setGeometryAt(instance, 0, geo.primitive, geo.vb, geo.ib, 0, geo.indexCount);
+
+		// Instanced meshes keep the union of their instances, rebuilt from the new box on the next flush
+		if (auto instanced = FindInstancedMesh(app, mesh)) {
+			instanced->geometryBox = box;
+			instanced->dirty = true;
+		}
+		else
+			rm.setAxisAlignedBoundingBox(instance, box);
+	}
+}
+
+static void UpdateDynamicGeometry(FilamentApp* app, Geometry& geo, const GeometryUpdate& update) {
+
+	auto dyn = geo.dynamic;
+
+	const uint32_t vertexEnd = update.vertexOffset + update.vertexCount;
+	const uint32_t indexEnd = update.indexOffset + update.indexCount;
+
+	const uint32_t totalVertices = update.totalVertices > 0 ? update.totalVertices : std::max(dyn->vertexCount, vertexEnd);
+	const uint32_t totalIndices = !dyn->indexed ? 0 : update.totalIndices > 0 ? update.totalIndices : std::max(dyn->indexCount, indexEnd);
+
+	const uint32_t needVertices = std::max(totalVertices, vertexEnd);
+	const uint32_t needIndices = dyn->indexed ? std::max(totalIndices, indexEnd) : 0;
+
+	DynamicGeometry* retired = nullptr;
+
+	// Over capacity: move to larger buffers, the content is carried over in the current slot and reaches the others as they rotate in
+	if (needVertices > dyn->vertexCapacity || needIndices > dyn->indexCapacity) {
+
+		retired = dyn;
+
+		dyn = CreateDynamicGeometry(app, retired->attributes.data(), (uint32_t)retired->attributes.size(), retired->stride, retired->primitive, retired->indexed,
+			std::max(needVertices, retired->vertexCapacity * 2),
+			retired->indexed ? std::max(needIndices, retired->indexCapacity * 2) : 0,
+			retired->bufferCount);
+
+		auto& src = retired->slots[retired->current];
+		memcpy(dyn->slots[0].vertices, src.vertices, (size_t)retired->vertexCount * retired->stride);
+		if (retired->indexed)
+			memcpy(dyn->slots[0].indices, src.indices, (size_t)retired->indexCount * sizeof(uint32_t));
+
+		dyn->vertexCount = retired->vertexCount;
+		dyn->indexCount = retired->indexCount;
+		dyn->meshes = std::move(retired->meshes);
+
+		MarkDirty(dyn, 0, dyn->vertexCount, 0, dyn->indexCount);
+
+		geo.dynamic = dyn;
+	}
+
+	auto& prev = dyn->slots[dyn->current];
+	auto next = (dyn->current + 1) % dyn->bufferCount;
+	auto& slot = dyn->slots[next];
+
+	// More updates than frames in flight: the driver is still reading this slot
+	if (slot.pending.load(std::memory_order_acquire) != 0)
+		app->engine->flushAndWait();
+
+	// Catch up with the changes made while the slot was out of rotation
+	if (slot.dirtyVertexBegin < slot.dirtyVertexEnd) {
+		auto offset = (size_t)slot.dirtyVertexBegin * dyn->stride;
+		memcpy(slot.vertices + offset, prev.vertices + offset, (size_t)(slot.dirtyVertexEnd - slot.dirtyVertexBegin) * dyn->stride);
+	}
+
+	if (dyn->indexed && slot.dirtyIndexBegin < slot.dirtyIndexEnd)
+		memcpy(slot.indices + slot.dirtyIndexBegin, prev.indices + slot.dirtyIndexBegin, (size_t)(slot.dirtyIndexEnd - slot.dirtyIndexBegin) * sizeof(uint32_t));
+
+	if (update.vertexCount > 0)
+		memcpy(slot.vertices + (size_t)update.vertexOffset * dyn->stride, update.vertices, (size_t)update.vertexCount * dyn->stride);
+
+	if (dyn->indexed && update.indexCount > 0)
+		memcpy(slot.indices + update.indexOffset, update.indices, (size_t)update.indexCount * sizeof(uint32_t));
+
+	dyn->vertexCount = totalVertices;
+	dyn->indexCount = totalIndices;
+
+	MarkDirty(dyn, update.vertexOffset, vertexEnd, dyn->indexed ? update.indexOffset : 0, dyn->indexed ? indexEnd : 0);
+
+	UploadSlot(app, dyn, slot);
+
+	dyn->current = next;
+
+	BindDynamicGeometry(app, geo, BoundsToBox(update.bounds));
+
+	geo.updateCount++;
+
+	if (retired)
+		DestroyDynamicGeometry(app, retired);
+}
+
+// Copies the source in the first slot, the geometry owns nothing of info once this returns
+static Geometry CreateDynamicFromInfo(FilamentApp* app, const GeometryInfo& info, const DynamicGeometryOptions& options) {
+
+	const bool indexed = info.indicesCount > 0 || options.indexCapacity > 0;
+	const uint32_t bufferCount = std::clamp(options.bufferCount, 2u, (uint32_t)GEOMETRY_MAX_BUFFERS);
+
+	auto dyn = CreateDynamicGeometry(app, info.layout.attributes, info.layout.attributeCount, info.layout.sizeByte, info.primitive, indexed,
+		std::max({ options.vertexCapacity, info.verticesCount, 1u }),
+		std::max({ options.indexCapacity, info.indicesCount, 3u }),
+		bufferCount);
+
+	auto& slot = dyn->slots[0];
+
+	memcpy(slot.vertices, info.vertices, (size_t)info.verticesCount * info.layout.sizeByte);
+
+	if (info.indicesCount > 0) {
+		if (info.indexFormat == IndexFormat::UShort) {
+			auto src = (const uint16_t*)info.indices;
+			for (uint32_t i = 0; i < info.indicesCount; i++)
+				slot.indices[i] = src[i];
+		}
+		else
+			memcpy(slot.indices, info.indices, (size_t)info.indicesCount * sizeof(uint32_t));
+	}
+
+	dyn->vertexCount = info.verticesCount;
+	dyn->indexCount = info.indicesCount;
+
+	MarkDirty(dyn, 0, dyn->vertexCount, 0, dyn->indexCount);
+	UploadSlot(app, dyn, slot);
+
+	ReleaseGeometrySource(info, info.vertices, info.verticesUser);
+	if (info.indicesCount > 0)
+		ReleaseGeometrySource(info, info.indices, info.indicesUser);
+
+	Geometry result = {};
+	result.dynamic = dyn;
+	BindDynamicGeometry(app, result, BoundsToBox(info.bounds));
+
+	return result;
+}
+
+static bool DynamicLayoutMatches(const DynamicGeometry* dyn, const GeometryInfo& info) {
+
+	if (dyn->primitive != info.primitive || dyn->stride != info.layout.sizeByte ||
+		dyn->indexed != (info.indicesCount > 0) || dyn->attributes.size() != info.layout.attributeCount)
+		return false;
+
+	for (uint32_t i = 0; i < info.layout.attributeCount; i++) {
+		auto& a = dyn->attributes[i];
+		auto& b = info.layout.attributes[i];
+		if (a.type != b.type || a.offset != b.offset || a.format != b.format)
+			return false;
+	}
+
+	return true;
+}
+
+OBJHANDLE AddDynamicGeometry(FilamentApp* app, OBJID id, const GeometryInfo& info, const DynamicGeometryOptions& options)
+{
+	return app->geometries.set(id, CreateDynamicFromInfo(app, info, options));
+}
+
+void UpdateGeometryRange(FilamentApp* app, OBJID geometryId, const GeometryUpdate& update)
+{
+	auto geo = app->geometries.find(geometryId);
+	if (!geo || !geo->dynamic)
+		return;
+
+	UpdateDynamicGeometry(app, *geo, update);
+}
+
+// First update rebuilds the geometry, from the second one on it's promoted to dynamic and updated in place
+void UpdateMeshGeometry(FilamentApp* app, OBJID meshId, OBJID geometryId, const GeometryInfo& info) {
+	
+	auto mesh = app->entities.find(meshId);
+	if (!mesh)
+		return;
+
+	auto cur = app->geometries.find(geometryId);
+
+	if (cur && cur->dynamic && DynamicLayoutMatches(cur->dynamic, info)) {
+
+		auto& meshes = cur->dynamic->meshes;
+		if (std::find(meshes.begin(), meshes.end(), *mesh) == meshes.end())
+			meshes.push_back(*mesh);
+
+		std::vector<uint32_t> wide;
+
+		GeometryUpdate update = {};
+		update.vertices = info.vertices;
+		update.vertexCount = info.verticesCount;
+		update.totalVertices = info.verticesCount;
+		update.indices = info.indices;
+		update.indexCount = info.indicesCount;
+		update.totalIndices = info.indicesCount;
+		update.bounds = info.bounds;
+
+		if (info.indexFormat == IndexFormat::UShort) {
+			auto src = (const uint16_t*)info.indices;
+			wide.assign(src, src + info.indicesCount);
+			update.indices = wide.data();
+		}
+
+		UpdateDynamicGeometry(app, *cur, update);
+
+		ReleaseGeometrySource(info, info.vertices, info.verticesUser);
+		if (info.indicesCount > 0)
+			ReleaseGeometrySource(info, info.indices, info.indicesUser);
+		return;
+	}
+
+	Geometry oldGeo = {};
+	if (cur)
+		oldGeo = *cur;
+
+	Geometry* geo;
+
+	if (oldGeo.updateCount > 0) {
+
+		DynamicGeometryOptions options = {};
+		options.vertexCapacity = info.verticesCount + info.verticesCount / 2;
+		options.indexCapacity = info.indicesCount + info.indicesCount / 2;
+		options.bufferCount = 2;
+
+		geo = app->geometries.get(app->geometries.set(geometryId, CreateDynamicFromInfo(app, info, options)));
+
+		auto& meshes = geo->dynamic->meshes;
+		if (oldGeo.dynamic)
+			meshes = std::move(oldGeo.dynamic->meshes);
+		if (std::find(meshes.begin(), meshes.end(), *mesh) == meshes.end())
+			meshes.push_back(*mesh);
+
+		BindDynamicGeometry(app, *geo, geo->box);
+	}
+	else {
+		geo = app->geometries.get(AddGeometry(app, geometryId, info));
+
+		auto& rm = app->engine->getRenderableManager();
+
+		rm.setGeometryAt(rm.getInstance(*mesh), 0, 
+			geo->primitive,
+			geo->vb, geo->ib, 0, geo->indexCount);
+	}
+
+	geo->updateCount = oldGeo.updateCount + 1;
+
+	if (oldGeo.dynamic)
+		DestroyDynamicGeometry(app, oldGeo.dynamic);
+	else {
+		CancelOrientation(app, oldGeo.vb);
+		if (oldGeo.vb)
+			app->engine->destroy(oldGeo.vb);
+		if (oldGeo.ib && !oldGeo.sharedIb)
+			app->engine->destroy(oldGeo.ib);
+	}
+}
+
+
+/*
+void AddGeometryV3(FilamentApp* app, OBJID id, const GeometryInfo& info)
+{
+	auto indices = info.indices;
+	auto indicesCount = info.indicesCount;
+
+	if (info.indicesCount == 0) {
+		indices = new uint32_t[info.verticesCount];
+		for (uint32_t i = 0; i < info.verticesCount; i++)
+			indices[i] = i;
+		indicesCount = info.verticesCount;
+	}
+
+	auto ib = IndexBuffer::Builder()
+		.indexCount(indicesCount)
+		.bufferType(IndexBuffer::IndexType::UINT)
+		.build(*app->engine);
+
+	auto ibSizeByte = sizeof(uint32_t) * indicesCount;
+
+	if (info.indicesCount > 0) {
+		auto ibBuffer = new uint8_t[ibSizeByte];
+		memcpy(ibBuffer, info.indices, ibSizeByte);
+		ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor(ibBuffer, ibSizeByte, DeleteBuffer, (void*)"IB"));
+	}
+	else
+		ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor(indices, ibSizeByte, DeleteBuffer, (void*)"IB-GEN"));
+
+
+	auto vbBuilder = VertexBuffer::Builder()
+		.vertexCount(info.verticesCount);
+
+	auto surfBuilder = geometry::SurfaceOrientation::Builder();
+	surfBuilder
+		.triangles((uint3*)info.indices)
+		.triangleCount(info.indicesCount / 3)
+		.vertexCount(info.verticesCount);
+
+
+	bool hasNormals = false;
+	bool hasTangents = false;
+
+	float3* normals = nullptr;
+	float2* uvs = nullptr;
+	float3* positions = nullptr;
+	float4* tangents = nullptr;
+
+	Geometry result;
+
+	for (uint32_t i = 0; i < info.layout.attributeCount; i++) {
+		auto& attr = info.layout.attributes[i];
+
+		filament::VertexAttribute va;
+		VertexBuffer::AttributeType at;
+
+		bool isMainBuffer = true;
+
+		switch (attr.type)
+		{
+		case VertexAttributeType::Position:
+			va = filament::VertexAttribute::POSITION;
+			at = VertexBuffer::AttributeType::FLOAT3;
+			positions = UnpackBuffer<float3>(info.vertices, attr.offset, info.layout.sizeByte, info.verticesCount);
+			surfBuilder.positions((float3*)positions);
+
+			break;
+		case VertexAttributeType::Normal:
+			normals = UnpackBuffer<float3>(info.vertices, attr.offset, info.layout.sizeByte, info.verticesCount);
+			surfBuilder.normals(normals);
+			hasNormals = true;
+			isMainBuffer = false;
+			break;
+		case VertexAttributeType::Tangent:
+			va = filament::VertexAttribute::TANGENTS;
+			at = VertexBuffer::AttributeType::FLOAT4;
+			tangents = UnpackBuffer<float4>(info.vertices, attr.offset, info.layout.sizeByte, info.verticesCount);
+			surfBuilder.tangents(tangents);
+			hasTangents = false;
+			isMainBuffer = false;
+			break;
+		case VertexAttributeType::Color:
+			va = filament::VertexAttribute::COLOR;
+			at = VertexBuffer::AttributeType::FLOAT4;
+			break;
+		case VertexAttributeType::UV0:
+			va = filament::VertexAttribute::UV0;
+			at = VertexBuffer::AttributeType::FLOAT2;
+			
+			uvs = UnpackBuffer<float2>(info.vertices, attr.offset, info.layout.sizeByte, info.verticesCount);
+			surfBuilder.uvs(uvs);
+
+			break;
+		case VertexAttributeType::UV1:
+			va = filament::VertexAttribute::UV1;
+			at = VertexBuffer::AttributeType::FLOAT2;
+			break;
+		default:
+			break;
+		}
+
+		if (isMainBuffer)
+			vbBuilder.attribute(va, 0, at, attr.offset, info.layout.sizeByte);
+	};
+
+	bool hasOrientation = hasNormals && !hasTangents;
+
+	vbBuilder.bufferCount(hasOrientation ? 2 : 1);
+
+	if (hasOrientation) {
+		vbBuilder.attribute(filament::VertexAttribute::TANGENTS, 1, VertexBuffer::AttributeType::SHORT4);
+		vbBuilder.normalized(filament::VertexAttribute::TANGENTS);
+	}
+
+	auto vb = vbBuilder.build(*app->engine);
+
+	auto vbSize = info.verticesCount * info.layout.sizeByte;
+	auto vbBuffer = new uint8_t[vbSize];
+	memcpy(vbBuffer, info.vertices, vbSize);
+
+	vb->setBufferAt(*app->engine, 0, VertexBuffer::BufferDescriptor(vbBuffer, vbSize, DeleteBuffer, (void*)"VB"));
+
+	if (hasOrientation) {
+
+		auto so = surfBuilder.
+			build();
+
+		result.soBuffer = new short4[so->getVertexCount()];
+		memset(result.soBuffer, 0, so->getVertexCount() * sizeof(short4));
+		so->getQuats(result.soBuffer, so->getVertexCount());
+		vb->setBufferAt(*app->engine, 1, VertexBuffer::BufferDescriptor(result.soBuffer, so->getVertexCount() * sizeof(short4), DeleteBuffer, (void*)"QUAD"));
+
+		delete so;
+	}
+
+	float3 halfSize = {
+		(info.bounds.max.x - info.bounds.min.x) / 2.0f,
+		(info.bounds.max.y - info.bounds.min.y) / 2.0f,
+		(info.bounds.max.z - info.bounds.min.z) / 2.0f
+	};
+
+	float3 center = {
+		(info.bounds.max.x + info.bounds.min.x) / 2.0f,
+		(info.bounds.max.y + info.bounds.min.y) / 2.0f,
+		(info.bounds.max.z + info.bounds.min.z) / 2.0f
+	};
+
+	result.ib = ib;
+	result.vb = vb;
+	result.box = { center, halfSize };
+
+	app->geometries.set(id, result);
+}
+
+
+
+void AddGeometryV2(FilamentApp* app, OBJID id, const GeometryInfo& info)
+{
+	auto indices = info.indices;
+	auto indicesCount = info.indicesCount;
+
+	if (info.indicesCount == 0) {
+		indices = new uint32_t[info.verticesCount];
+		for (uint32_t i = 0; i < info.verticesCount; i++)
+			indices[i] = i;
+		indicesCount = info.verticesCount;
+	}
+
+	auto tangentMeshBld = geometry::TangentSpaceMesh::Builder();
+
+	tangentMeshBld.triangles((uint3*)indices)
+		.triangleCount(info.indicesCount / 3)
+		.algorithm((geometry::TangentSpaceMesh::Algorithm)5)
+		.vertexCount(info.verticesCount);
+
+	for (uint32_t i = 0; i < info.layout.attributeCount; i++) {
+		auto& attr = info.layout.attributes[i];
+		switch (attr.type)
+		{
+		case VertexAttributeType::Position:
+			tangentMeshBld.positions((float3*)(info.vertices + attr.offset), info.layout.sizeByte);
+			break;
+		case VertexAttributeType::Normal:
+			tangentMeshBld.normals((float3*)(info.vertices + attr.offset), info.layout.sizeByte);
+			break;
+		case VertexAttributeType::Tangent:
+			tangentMeshBld.tangents((float4*)(info.vertices + attr.offset), info.layout.sizeByte);
+			break;
+		case VertexAttributeType::UV0:
+			tangentMeshBld.uvs((float2*)(info.vertices + attr.offset), info.layout.sizeByte);
+			break;
+		}
+	};
+
+	auto tangentMesh = tangentMeshBld
+		.build();
+
+
+	auto ib = IndexBuffer::Builder()
+		.indexCount(tangentMesh->getTriangleCount() * 3)
+		.bufferType(IndexBuffer::IndexType::UINT)
+		.build(*app->engine);
+
+	auto ibBuffer = new uint3[tangentMesh->getTriangleCount()];
+	tangentMesh->getTriangles(ibBuffer);
+	ib->setBuffer(*app->engine, IndexBuffer::BufferDescriptor(ibBuffer, sizeof(uint3) * tangentMesh->getTriangleCount(), DeleteBuffer));
+
+	auto vb = VertexBuffer::Builder()
+		.vertexCount(tangentMesh->getVertexCount())
+		.bufferCount(1)
+		.attribute(filament::VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3, 0, 36)
+		.attribute(filament::VertexAttribute::UV0, 0, VertexBuffer::AttributeType::FLOAT2, 12, 36)
+		.attribute(filament::VertexAttribute::TANGENTS, 0, VertexBuffer::AttributeType::FLOAT2, 20, 36)
+		.build(*app->engine);
+
+
+	auto vbBuffer = new uint8_t[tangentMesh->getVertexCount() * 36];
+	tangentMesh->getPositions((float3*)vbBuffer, 36);
+	tangentMesh->getUVs((float2*)(vbBuffer + 12), 36);
+	tangentMesh->getQuats((quatf*)(vbBuffer + 20), 36);
+
+	vb->setBufferAt(*app->engine, 0, VertexBuffer::BufferDescriptor(vbBuffer, tangentMesh->getVertexCount() * 36, DeleteBuffer));
+
+	geometry::TangentSpaceMesh::destroy(tangentMesh);
+
+	float3 halfSize = {
+		(info.bounds.max.x - info.bounds.min.x) / 2.0f,
+		(info.bounds.max.y - info.bounds.min.y) / 2.0f,
+		(info.bounds.max.z - info.bounds.min.z) / 2.0f
+	};
+
+	float3 center = {
+		(info.bounds.max.x + info.bounds.min.x) / 2.0f,
+		(info.bounds.max.y + info.bounds.min.y) / 2.0f,
+		(info.bounds.max.z + info.bounds.min.z) / 2.0f
+	};
+
+	Geometry result;
+
+	result.ib = ib;
+	result.vb = vb;
+	result.box = { center, halfSize };
+
+	app->geometries.set(id, result);
+}
+*/
+
+OBJHANDLE AddGroup(FilamentApp* app, OBJID id) {
+
+	auto group = EntityManager::get().create();
+	auto& tcm = app->engine->getTransformManager();
+	tcm.create(group);
+	app->scene->addEntity(group);
+	return app->entities.set(id, group);
+}
+
+// Meshes put on a fallback instance are moved to the real one when its variant is ready
+static void TrackPendingMaterial(FilamentApp* app, OBJHANDLE matHandle, Entity mesh) {
+	for (auto& pending : app->pendingMaterials) {
+		if (pending.handle == matHandle) {
+			pending.meshes.push_back(mesh);
+			break;
+		}
+	}
+}
+
+void SetMeshMaterialByHandle(FilamentApp* app, OBJHANDLE handle, OBJHANDLE matHandle) {
+	auto obj = app->entities.get(handle);
+	auto mat = app->materialsInst.get(matHandle);
+	if (!obj || !mat)
+		return;
+	auto& rm = app->engine->getRenderableManager();
+	rm.setMaterialInstanceAt(rm.getInstance(*obj), 0, *mat);
+	TrackPendingMaterial(app, matHandle, *obj);
+}
+
+void SetMeshMaterial(FilamentApp* app, const OBJID id, const OBJID matId) {
+	SetMeshMaterialByHandle(app, app->entities.handle(id), app->materialsInst.handle(matId));
+}
+
+
+OBJHANDLE AddMesh(FilamentApp* app, OBJID id, const MeshInfo& info)
+{
+	auto geo = app->geometries.find(info.geometryId);
+	auto mat = app->materialsInst.find(info.materialId);
+	if (!geo || !mat)
+		return NULL_HANDLE;
+
+	auto mesh = EntityManager::get().create();
+
+	RenderableManager::Builder(1)
+		.boundingBox(geo->box)
+		.culling(info.culling)
+		.castShadows(info.castShadows)
+		.receiveShadows(info.receiveShadows)
+		.material(0, *mat)
+		.fog(info.fog)
+		.geometry(0, geo->primitive, geo->vb, geo->ib, 0, geo->indexCount)
+		.build(*app->engine, mesh);
+
+	auto& tcm = app->engine->getTransformManager();
+	auto& rm = app->engine->getRenderableManager();
+	rm.setLayerMask(rm.getInstance(mesh), MAIN_LAYER, MAIN_LAYER);
+
+	if (geo->dynamic)
+		geo->dynamic->meshes.push_back(mesh);
+
+	TrackPendingMaterial(app, app->materialsInst.handle(info.materialId), mesh);
+
+	tcm.create(mesh);
+	app->scene->addEntity(mesh);
+	return app->entities.set(id, mesh);
+}
+
+OBJHANDLE AddInstancedMesh(FilamentApp* app, OBJID id, const MeshInfo& info, uint32_t instanceCount)
+{
+	auto geo = app->geometries.find(info.geometryId);
+	auto mat = app->materialsInst.find(info.materialId);
+	if (!geo || !mat)
+		return NULL_HANDLE;
+
+	if (instanceCount == 0)
+		throw "Instanced mesh needs at least one instance";
+
+	auto mesh = EntityManager::get().create();
+
+	auto instanced = new InstancedMesh();
+	instanced->entity = mesh;
+	instanced->geometryBox = geo->box;
+	instanced->capacity = instanceCount;
+	instanced->transforms.assign(instanceCount, mat4f());
+	instanced->visible.assign(instanceCount, 1);
+	instanced->packed.resize(instanceCount);
+	instanced->visibleCount = instanceCount;
+	instanced->dirty = true;
+
+	instanced->buffer = InstanceBuffer::Builder(instanceCount)
+		.localTransforms(instanced->transforms.data())
+		.build(*app->engine);
+
+	RenderableManager::Builder(1)
+		.boundingBox(geo->box)
+		.culling(info.culling)
+		.castShadows(info.castShadows)
+		.receiveShadows(info.receiveShadows)
+		.material(0, *mat)
+		.fog(info.fog)
+		.geometry(0, geo->primitive, geo->vb, geo->ib, 0, geo->indexCount)
+		.instances(instanceCount, instanced->buffer)
+		.build(*app->engine, mesh);
+
+	auto& tcm = app->engine->getTransformManager();
+	auto& rm = app->engine->getRenderableManager();
+	rm.setLayerMask(rm.getInstance(mesh), MAIN_LAYER, MAIN_LAYER);
+
+	if (geo->dynamic)
+		geo->dynamic->meshes.push_back(mesh);
+
+	TrackPendingMaterial(app, app->materialsInst.handle(info.materialId), mesh);
+
+	tcm.create(mesh);
+	app->scene->addEntity(mesh);
+
+	auto handle = app->entities.set(id, mesh);
+	app->instancedMeshes[handle] = instanced;
+
+	return handle;
+}
+
+static InstancedMesh* GetInstancedMesh(FilamentApp* app, OBJHANDLE handle) {
+	auto cur = app->instancedMeshes.find(handle);
+	return cur != app->instancedMeshes.end() ? cur->second : nullptr;
+}
+
+// Matrix4x4 and mat4f are both column major floats, the batch is copied as is
+void SetInstanceTransformsByHandle(FilamentApp* app, OBJHANDLE handle, const Matrix4x4 matrices[], uint32_t first, uint32_t count)
+{
+	auto instanced = GetInstancedMesh(app, handle);
+	if (!instanced || first >= instanced->capacity)
+		return;
+
+	count = std::min(count, instanced->capacity - first);
+	memcpy(&instanced->transforms[first], matrices, count * sizeof(mat4f));
+	instanced->dirty = true;
+}
+
+void SetInstanceTransforms(FilamentApp* app, OBJID id, const Matrix4x4 matrices[], uint32_t first, uint32_t count)
+{
+	SetInstanceTransformsByHandle(app, app->entities.handle(id), matrices, first, count);
+}
+
+void SetInstanceVisibilityByHandle(FilamentApp* app, OBJHANDLE handle, const uint8_t visible[], uint32_t first, uint32_t count)
+{
+	auto instanced = GetInstancedMesh(app, handle);
+	if (!instanced || first >= instanced->capacity)
+		return;
+
+	count = std::min(count, instanced->capacity - first);
+	memcpy(&instanced->visible[first], visible, count);
+	instanced->dirty = true;
+}
+
+void SetInstanceVisibility(FilamentApp* app, OBJID id, const uint8_t visible[], uint32_t first, uint32_t count)
+{
+	SetInstanceVisibilityByHandle(app, app->entities.handle(id), visible, first, count);
+}
+
+uint32_t GetVisibleInstanceCount(FilamentApp* app, OBJID id)
+{
+	auto instanced = GetInstancedMesh(app, app->entities.handle(id));
+	return instanced ? instanced->visibleCount : 0;
+}
+
+// Packs the visible instances at the front, the renderable box becomes the union of their geometry boxes
+static void PackInstances(FilamentApp* app, InstancedMesh* instanced) {
+
+	auto& box = instanced->geometryBox;
+	float3 lo(std::numeric_limits<float>::max());
+	float3 hi(-std::numeric_limits<float>::max());
+
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < instanced->capacity; i++) {
+
+		if (!instanced->visible[i])
+			continue;
+
+		auto& m = instanced->transforms[i];
+		instanced->packed[count++] = m;
+
+		auto center = (m * float4(box.center, 1.0f)).xyz;
+		auto extent = abs(m[0].xyz) * box.halfExtent.x + abs(m[1].xyz) * box.halfExtent.y + abs(m[2].xyz) * box.halfExtent.z;
+		lo = min(lo, center - extent);
+		hi = max(hi, center + extent);
+	}
+
+	// Collapsed to a point, the hidden tail produces no fragments
+	for (uint32_t i = count; i < instanced->capacity; i++)
+		instanced->packed[i] = mat4f(float4(0.0f), float4(0.0f), float4(0.0f), float4(0.0f));
+
+	instanced->buffer->setLocalTransforms(instanced->packed.data(), instanced->capacity);
+	instanced->visibleCount = count;
+	instanced->dirty = false;
+
+	// With every instance hidden the old box is kept, the zero matrices draw nothing anyway
+	if (count > 0) {
+		auto& rm = app->engine->getRenderableManager();
+		rm.setAxisAlignedBoundingBox(rm.getInstance(instanced->entity), { (lo + hi) * 0.5f, (hi - lo) * 0.5f });
+	}
+}
+
+static void FlushInstancedMeshes(FilamentApp* app) {
+	for (auto& item : app->instancedMeshes) {
+		if (item.second->dirty)
+			PackInstances(app, item.second);
+	}
+}
+
+void SetObjParentByHandle(FilamentApp* app, OBJHANDLE handle, OBJHANDLE parentHandle)
+{
+	auto obj = app->entities.get(handle);
+	auto parentObj = app->entities.get(parentHandle);
+	if (!obj || !parentObj)
+		return;
+	auto& tcm = app->engine->getTransformManager();
+	auto parentInstance = tcm.getInstance(*parentObj);
+	auto objInstance = tcm.getInstance(*obj);
+	tcm.setParent(objInstance, parentInstance);
+}
+
+void SetObjParent(FilamentApp* app, OBJID id, OBJID parentId)
+{
+	SetObjParentByHandle(app, app->entities.handle(id), app->entities.handle(parentId));
+}
+
+void SetObjVisibleByHandle(FilamentApp* app, OBJHANDLE handle, const bool visible)
+{
+	auto obj = app->entities.get(handle);
+	if (!obj)
+		return;
+	auto& rm = app->engine->getRenderableManager();
+	auto objInstance = rm.getInstance(*obj);
+
+	rm.setLayerMask(objInstance, INVISIBLE_LAYER, visible ? 0 : INVISIBLE_LAYER);
+	rm.setLayerMask(objInstance, MAIN_LAYER, visible ? MAIN_LAYER : 0);
+}
+
+void SetObjVisible(FilamentApp* app, const OBJID id, const bool visible)
+{
+	SetObjVisibleByHandle(app, app->entities.handle(id), visible);
+}
+
+
+static const TextureSampler s_mapSampler(TextureSampler::MinFilter::LINEAR_MIPMAP_LINEAR,
+	TextureSampler::MagFilter::LINEAR, TextureSampler::WrapMode::REPEAT);
+
+static uint64_t UploadTexture(FilamentApp* app, TextureEntry& entry, const ImageData& data);
+
+static Texture::Usage TextureUsage(uint32_t levels, Texture::Type type) {
+	return levels > 1 && type != Texture::Type::COMPRESSED ?
+		Texture::Usage::DEFAULT | Texture::Usage::GEN_MIPMAPPABLE :
+		Texture::Usage::DEFAULT;
+}
+
+static inline uint32_t LevelSize(uint32_t size, uint32_t level) {
+	return std::max(1u, size >> level);
+}
+
+static inline size_t LevelBytes(const StreamingTexture* st, uint32_t level) {
+	return (size_t)LevelSize(st->width, level) * LevelSize(st->height, level) * st->pixelSize;
+}
+
+static uint64_t ChainBytes(const StreamingTexture* st, uint32_t level) {
+	uint64_t bytes = 0;
+	for (uint32_t i = level; i < st->levelCount; i++)
+		bytes += LevelBytes(st, i);
+	return bytes;
+}
+
+// Bytes per pixel of the data that can be streamed, 0 for the rest (mip chain built on the CPU)
+static uint32_t StreamingPixelSize(uint32_t width, uint32_t height, const ImageData& data) {
+
+	if (data.data == nullptr || data.type != Texture::Type::UBYTE || data.isBgr)
+		return 0;
+
+	uint32_t size;
+	switch (data.format) {
+	case Texture::Format::R: size = 1; break;
+	case Texture::Format::RG: size = 2; break;
+	case Texture::Format::RGB: size = 3; break;
+	case Texture::Format::RGBA: size = 4; break;
+	default:
+		return 0;
+	}
+
+	if (data.dataSize < (size_t)width * height * size)
+		return 0;
+
+	return size;
+}
+
+struct SrgbTables {
+	float toLinear[256];
+	uint8_t fromLinear[4096];
+};
+
+static const SrgbTables& GetSrgbTables() {
+
+	static const SrgbTables tables = []() {
+		SrgbTables result;
+		for (int i = 0; i < 256; i++) {
+			float c = i / 255.0f;
+			result.toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < 4096; i++) {
+			float c = i / 4095.0f;
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+			result.fromLinear[i] = (uint8_t)(s * 255.0f + 0.5f);
+		}
+		return result;
+	}();
+
+	return tables;
+}
+
+// 2x2 box filter, odd sizes repeat their last row / column; sRGB color channels are averaged in linear space
+static void DownsampleLevel(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t pixelSize, bool srgb) {
+
+	auto& tables = GetSrgbTables();
+	uint32_t linearChannels = srgb ? std::min(pixelSize, 3u) : 0;
+
+	for (uint32_t y = 0; y < dstHeight; y++) {
+
+		auto row0 = src + (size_t)std::min(y * 2, srcHeight - 1) * srcWidth * pixelSize;
+		auto row1 = src + (size_t)std::min(y * 2 + 1, srcHeight - 1) * srcWidth * pixelSize;
+		auto out = dst + (size_t)y * dstWidth * pixelSize;
+
+		for (uint32_t x = 0; x < dstWidth; x++) {
+
+			auto x0 = std::min(x * 2, srcWidth - 1) * pixelSize;
+			auto x1 = std::min(x * 2 + 1, srcWidth - 1) * pixelSize;
+
+			for (uint32_t c = 0; c < pixelSize; c++) {
+				if (c < linearChannels) {
+					float sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] +
+						tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+					out[c] = tables.fromLinear[(uint32_t)(sum * 0.25f * 4095.0f + 0.5f)];
+				}
+				else
+					out[c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+			}
+
+			out += pixelSize;
+		}
+	}
+}
+
+static void WaitStreamingBuild(FilamentApp* app, StreamingTexture* st) {
+	if (st->job != nullptr) {
+		app->engine->getJobSystem().waitAndRelease(st->job);
+		st->job = nullptr;
+	}
+}
+
+static void FreeStreamingLevels(FilamentApp* app, StreamingTexture* st) {
+
+	if (st->levels[0] != nullptr)
+		app->streamingStats.cpuBytes -= ChainBytes(st, 0);
+
+	for (auto& level : st->levels) {
+		UploadFree(level);
+		level = nullptr;
+	}
+}
+
+// Takes level 0 from data (adopted when autoFree) and builds the rest of the chain off the render thread
+static void StartStreamingBuild(FilamentApp* app, StreamingTexture* st, const ImageData& data, uint32_t pixelSize) {
+
+	WaitStreamingBuild(app, st);
+
+	if (pixelSize != st->pixelSize)
+		FreeStreamingLevels(app, st);
+	else if (st->levels[0] != nullptr) {
+		app->streamingStats.cpuBytes -= ChainBytes(st, 0);
+		UploadFree(st->levels[0]);
+		st->levels[0] = nullptr;
+	}
+
+	st->format = data.format;
+	st->pixelSize = pixelSize;
+
+	if (data.autoFree) {
+		UploadRetag(data.data, UploadTag::TEX);
+		st->levels[0] = data.data;
+	}
+	else {
+		auto size = LevelBytes(st, 0);
+		st->levels[0] = (uint8_t*)UploadAlloc(size, UploadTag::TEX);
+		memcpy(st->levels[0], data.data, size);
+	}
+
+	for (uint32_t i = 1; i < st->levelCount; i++) {
+		if (st->levels[i] == nullptr)
+			st->levels[i] = (uint8_t*)UploadAlloc(LevelBytes(st, i), UploadTag::TEX);
+	}
+
+	app->streamingStats.cpuBytes += ChainBytes(st, 0);
+
+	st->built.store(false, std::memory_order_relaxed);
+
+	auto& js = app->engine->getJobSystem();
+
+	st->job = jobs::createJob(js, nullptr, [st]() {
+
+		for (uint32_t i = 1; i < st->levelCount; i++) {
+			DownsampleLevel(st->levels[i - 1], LevelSize(st->width, i - 1), LevelSize(st->height, i - 1),
+				st->levels[i], LevelSize(st->width, i), LevelSize(st->height, i), st->pixelSize, st->srgb);
+		}
+
+		st->built.store(true, std::memory_order_release);
+	});
+
+	js.runAndRetain(st->job);
+}
+
+// The texture object changes with the resident levels, every material using it is pointed to the new one
+static void ReplaceStreamingTexture(FilamentApp* app, TextureEntry& entry, Texture* texture) {
+
+	for (auto& binding : entry.streaming->bindings)
+		binding.instance->setParameter(binding.name, texture, s_mapSampler);
+
+	if (entry.texture != nullptr)
+		app->engine->destroy(entry.texture);
+
+	entry.texture = texture;
+}
+
+static Texture* BuildStreamingTexture(FilamentApp* app, const StreamingTexture* st, uint32_t level, Texture::Usage usage) {
+	return Texture::Builder()
+		.width(LevelSize(st->width, level))
+		.height(LevelSize(st->height, level))
+		.levels(st->levelCount - level)
+		.format(st->internalFormat)
+		.usage(usage | Texture::Usage::UPLOADABLE)
+		.sampler(Texture::Sampler::SAMPLER_2D)
+		.build(*app->engine);
+}
+
+// Recreates the texture with the levels from 'level' down, returns the bytes uploaded
+static uint64_t UploadStreamingLevels(FilamentApp* app, TextureEntry& entry, uint32_t level) {
+
+	auto st = entry.streaming;
+	auto texture = BuildStreamingTexture(app, st, level, Texture::Usage::DEFAULT);
+
+	uint64_t bytes = 0;
+
+	for (uint32_t i = level; i < st->levelCount; i++) {
+		auto size = LevelBytes(st, i);
+		auto copy = UploadAlloc(size, UploadTag::TEX);
+		memcpy(copy, st->levels[i], size);
+		texture->setImage(*app->engine, i - level, Texture::PixelBufferDescriptor(copy, size,
+			st->format, Texture::Type::UBYTE, DeleteBuffer, (void*)"TEX"));
+		bytes += size;
+	}
+
+	ReplaceStreamingTexture(app, entry, texture);
+
+	auto& stats = app->streamingStats;
+	stats.residentBytes += bytes - st->residentBytes;
+	stats.uploadedBytes += bytes;
+	stats.lastFrameBytes += bytes;
+
+	st->residentLevel = level;
+	st->residentBytes = bytes;
+	st->dirty = false;
+
+	return bytes;
+}
+
+// Point sampled first level, usable until the chain is built
+static uint64_t UploadStreamingPreview(FilamentApp* app, TextureEntry& entry, const ImageData& data, uint32_t level) {
+
+	auto st = entry.streaming;
+	auto texture = BuildStreamingTexture(app, st, level, TextureUsage(st->levelCount - level, Texture::Type::UBYTE));
+
+	auto width = LevelSize(st->width, level);
+	auto height = LevelSize(st->height, level);
+	auto size = (size_t)width * height * st->pixelSize;
+	auto preview = (uint8_t*)UploadAlloc(size, UploadTag::TEX);
+
+	for (uint32_t y = 0; y < height; y++) {
+		auto src = data.data + (size_t)std::min(y << level, st->height - 1) * st->width * st->pixelSize;
+		auto dst = preview + (size_t)y * width * st->pixelSize;
+		for (uint32_t x = 0; x < width; x++)
+			memcpy(dst + x * st->pixelSize, src + (size_t)std::min(x << level, st->width - 1) * st->pixelSize, st->pixelSize);
+	}
+
+	texture->setImage(*app->engine, 0, Texture::PixelBufferDescriptor(preview, size,
+		st->format, Texture::Type::UBYTE, DeleteBuffer, (void*)"TEX"));
+
+	if (texture->getLevels() > 1)
+		texture->generateMipmaps(*app->engine);
+
+	ReplaceStreamingTexture(app, entry, texture);
+
+	auto bytes = ChainBytes(st, level);
+	auto& stats = app->streamingStats;
+	stats.residentBytes += bytes - st->residentBytes;
+	stats.uploadedBytes += size;
+	stats.lastFrameBytes += size;
+
+	st->residentLevel = level;
+	st->residentBytes = bytes;
+	st->dirty = true;
+
+	return size;
+}
+
+static Texture* CreateStreamingTexture(FilamentApp* app, const TextureInfo& info, uint32_t pixelSize, MaterialUpdateStats& stats) {
+
+	auto st = new StreamingTexture();
+	st->id = info.textureId;
+	st->width = info.width;
+	st->height = info.height;
+	st->internalFormat = info.internalFormat;
+	st->format = info.data.format;
+	st->pixelSize = pixelSize;
+	st->srgb = info.internalFormat == Texture::InternalFormat::SRGB8 || info.internalFormat == Texture::InternalFormat::SRGB8_A8;
+	st->levelCount = std::min({ info.levels, HighestBit(std::max(info.width, info.height)) + 1, (uint32_t)TEXTURE_MAX_LEVELS });
+	st->wantedLevel = 0;
+	st->lastSeenFrame = app->frameIndex;
+
+	auto initialSize = std::max(app->textureStreaming.initialSize, 1u);
+	uint32_t level = 0;
+	while (level + 1 < st->levelCount && std::max(LevelSize(st->width, level), LevelSize(st->height, level)) > initialSize)
+		level++;
+
+	TextureEntry entry = { nullptr, info.data.version, st };
+
+	stats.bytesUploaded += UploadStreamingPreview(app, entry, info.data, level);
+	stats.texturesUploaded++;
+
+	StartStreamingBuild(app, st, info.data, pixelSize);
+
+	app->textures.set(info.textureId, entry);
+	app->streamingTextures.push_back(st);
+	app->streamingStats.textures++;
+
+	return entry.texture;
+}
+
+// Data that can't be streamed any more (e.g. float) goes back to a full size texture
+static void StopStreaming(FilamentApp* app, TextureEntry& entry, Texture::Type type) {
+
+	auto st = entry.streaming;
+
+	WaitStreamingBuild(app, st);
+
+	ReplaceStreamingTexture(app, entry, BuildStreamingTexture(app, st, 0, TextureUsage(st->levelCount, type)));
+
+	auto& list = app->streamingTextures;
+	list.erase(std::find(list.begin(), list.end(), st));
+
+	app->streamingStats.residentBytes -= st->residentBytes;
+	app->streamingStats.textures--;
+
+	FreeStreamingLevels(app, st);
+	delete st;
+
+	entry.streaming = nullptr;
+}
+
+static void UnbindStreaming(FilamentApp* app, const OBJID& textureId, MaterialInstance* instance, const char* name) {
+
+	auto entry = app->textures.find(textureId);
+	if (entry == nullptr || entry->streaming == nullptr)
+		return;
+
+	auto& bindings = entry->streaming->bindings;
+	for (size_t i = 0; i < bindings.size(); i++) {
+		if (bindings[i].instance == instance && strcmp(bindings[i].name, name) == 0) {
+			bindings[i] = bindings.back();
+			bindings.pop_back();
+			return;
+		}
+	}
+}
+
+// Screen size of the visible renderables with the first target's camera, the largest one using a texture sets its wanted level
+static void EstimateTextureUsage(FilamentApp* app, const ::RenderTarget& target) {
+
+	auto& rm = app->engine->getRenderableManager();
+	auto& tm = app->engine->getTransformManager();
+
+	auto& camera = target.camera;
+	float3 eye(camera.transform[12], camera.transform[13], camera.transform[14]);
+	float3 forward(-camera.transform[8], -camera.transform[9], -camera.transform[10]);
+
+	auto viewHeight = target.viewport.height > 0 ? target.viewport.height : app->views[target.viewId].viewport.height;
+	// Diameter in pixels is 2 * radius * P11 / distance * viewHeight / 2
+	auto pixelScale = camera.projection[5] * viewHeight;
+
+	std::unordered_map<MaterialInstance*, float> coverage;
+
+	app->scene->forEach([&](Entity entity) {
+
+		auto renderable = rm.getInstance(entity);
+		if (!renderable.isValid() || (rm.getLayerMask(renderable) & MAIN_LAYER) == 0)
+			return;
+
+		auto box = rm.getAxisAlignedBoundingBox(renderable);
+		auto world = tm.getWorldTransform(tm.getInstance(entity));
+
+		auto center = (world * float4(box.center, 1.0f)).xyz;
+		auto scale = std::max({ length(world[0].xyz), length(world[1].xyz), length(world[2].xyz) });
+		auto radius = length(box.halfExtent) * scale;
+
+		auto toCenter = center - eye;
+		if (dot(toCenter, forward) < -radius)
+			return;
+
+		auto distance = std::max(length(toCenter) - radius, camera.near);
+		auto pixels = radius * pixelScale / distance;
+
+		for (size_t i = 0; i < rm.getPrimitiveCount(renderable); i++) {
+			auto& value = coverage[rm.getMaterialInstanceAt(renderable, i)];
+			value = std::max(value, pixels);
+		}
+	});
+
+	for (auto st : app->streamingTextures) {
+
+		float pixels = 0;
+		for (auto& binding : st->bindings) {
+			auto cur = coverage.find(binding.instance);
+			if (cur != coverage.end())
+				pixels = std::max(pixels, cur->second);
+		}
+
+		if (pixels <= 0)
+			continue;
+
+		auto size = std::max(st->width, st->height);
+		uint32_t level = 0;
+		while (level + 1 < st->levelCount && LevelSize(size, level + 1) >= pixels)
+			level++;
+
+		st->wantedLevel = level;
+		st->lastSeenFrame = app->frameIndex;
+	}
+}
+
+// Run once per frame: uploads rebuilt chains, drops the top levels over the memory budget and refines within the frame budget
+static void UpdateTextureStreaming(FilamentApp* app, const ::RenderTarget* target) {
+
+	auto& list = app->streamingTextures;
+	auto& options = app->textureStreaming;
+	auto& stats = app->streamingStats;
+
+	stats.lastFrameBytes = 0;
+
+	if (list.empty())
+		return;
+
+	auto frame = app->frameIndex;
+
+	if (options.usageInterval == 0) {
+		for (auto st : list) {
+			st->wantedLevel = 0;
+			st->lastSeenFrame = frame;
+		}
+	}
+	else if (target != nullptr && frame % options.usageInterval == 0)
+		EstimateTextureUsage(app, *target);
 
-	vb->setBufferAt(*app->engine, 0, VertexBuffer::BufferDescriptor(vbBuffer, tangentMesh->getVertexCount() * 36, DeleteBuffer));
+	auto& js = app->engine->getJobSystem();
 
-	geometry::TangentSpaceMesh::destroy(tangentMesh);
+	std::vector<StreamingTexture*> ready;
+	ready.reserve(list.size());
+	stats.building = 0;
 
-	float3 halfSize = {
-		(info.bounds.max.x - info.bounds.min.x) / 2.0f,
-		(info.bounds.max.y - info.bounds.min.y) / 2.0f,
-		(info.bounds.max.z - info.bounds.min.z) / 2.0f
-	};
+	for (auto st : list) {
+		if (st->job != nullptr) {
+			if (!st->built.load(std::memory_order_acquire)) {
+				stats.building++;
+				continue;
+			}
+			js.release(st->job);
+			st->job = nullptr;
+		}
+		ready.push_back(st);
+	}
 
-	float3 center = {
-		(info.bounds.max.x + info.bounds.min.x) / 2.0f,
-		(info.bounds.max.y + info.bounds.min.y) / 2.0f,
-		(info.bounds.max.z + info.bounds.min.z) / 2.0f
+	// New content replaces the preview (or old content) at the resident level, outside the budget
+	for (auto st : ready) {
+		if (st->dirty)
+			UploadStreamingLevels(app, *app->textures.find(st->id), st->residentLevel);
+	}
+
+	auto recent = [&](const StreamingTexture* st) {
+		return frame - st->lastSeenFrame <= options.evictFrames;
 	};
 
-	Geometry result;
+	if (options.memoryBudget > 0 && stats.residentBytes > options.memoryBudget) {
 
-	result.ib = ib;
-	result.vb = vb;
-	result.box = { center, halfSize };
+		// Not seen recently first, then the ones with more levels than they need, oldest first
+		std::vector<StreamingTexture*> victims;
+		for (auto st : ready) {
+			if (st->levels[0] != nullptr && st->residentLevel + 1 < st->levelCount && (!recent(st) || st->residentLevel < st->wantedLevel))
+				victims.push_back(st);
+		}
 
-	app->geometries[id] = result;
-}
-*/
+		std::sort(victims.begin(), victims.end(), [&](const StreamingTexture* a, const StreamingTexture* b) {
+			if (recent(a) != recent(b))
+				return !recent(a);
+			return a->lastSeenFrame < b->lastSeenFrame;
+		});
+
+		for (auto st : victims) {
+			if (stats.residentBytes <= options.memoryBudget)
+				break;
+			UploadStreamingLevels(app, *app->textures.find(st->id), st->residentLevel + 1);
+			stats.evictions++;
+		}
+	}
 
-void AddGroup(FilamentApp* app, OBJID id) {
+	// Refined one level at a time, the most recently seen and furthest from their wanted level first
+	std::vector<StreamingTexture*> refine;
+	for (auto st : ready) {
+		if (st->residentLevel > st->wantedLevel && recent(st))
+			refine.push_back(st);
+	}
 
-	auto group = EntityManager::get().create();
-	auto& tcm = app->engine->getTransformManager();
-	tcm.create(group);
-	app->scene->addEntity(group);
-	app->entities[id] = group;
-}
+	std::sort(refine.begin(), refine.end(), [](const StreamingTexture* a, const StreamingTexture* b) {
+		if (a->lastSeenFrame != b->lastSeenFrame)
+			return a->lastSeenFrame > b->lastSeenFrame;
+		return a->residentLevel - a->wantedLevel > b->residentLevel - b->wantedLevel;
+	});
 
-void SetMeshMaterial(FilamentApp* app, const OBJID id, const OBJID matId) {
-	auto mat = app->materialsInst[matId];
-	auto& rm = app->engine->getRenderableManager();
-	auto& obj = app->entities[id];
-	rm.setMaterialInstanceAt(rm.getInstance(obj), 0, mat);	
-}
+	uint64_t spent = 0;
 
+	for (auto st : refine) {
 
-void AddMesh(FilamentApp* app, OBJID id, const MeshInfo& info)
-{
-	auto mesh = EntityManager::get().create();
+		auto bytes = ChainBytes(st, st->residentLevel - 1);
 
-	auto geo = app->geometries[info.geometryId];
-	auto mat = app->materialsInst[info.materialId];
+		if (options.frameBudget > 0 && spent > 0 && spent + bytes > options.frameBudget)
+			break;
 
-	RenderableManager::Builder(1)
-		.boundingBox(geo.box)
-		.culling(info.culling)
-		.castShadows(info.castShadows)
-		.receiveShadows(info.receiveShadows)
-		.material(0, mat)
-		.fog(info.fog)
-		.geometry(0, geo.primitive, geo.vb, geo.ib)
-		.build(*app->engine, mesh);
+		if (options.memoryBudget > 0 && stats.residentBytes - st->residentBytes + bytes > options.memoryBudget)
+			continue;
 
-	auto& tcm = app->engine->getTransformManager();
-	auto& rm = app->engine->getRenderableManager();
-	rm.setLayerMask(rm.getInstance(mesh), MAIN_LAYER, MAIN_LAYER);
+		spent += UploadStreamingLevels(app, *app->textures.find(st->id), st->residentLevel - 1);
+		stats.refinements++;
+	}
 
-	tcm.create(mesh);
-	app->scene->addEntity(mesh);
-	app->entities[id] = mesh;
+	// A chain fully resident has nothing left to refine and its CPU copy (4/3 of level 0) costs more than evicting could
+	// ever free (3/4 of it): the copy is dropped and the texture stays at level 0 until new data comes
+	for (auto st : ready) {
+		if (st->residentLevel == 0 && !st->dirty && st->levels[0] != nullptr)
+			FreeStreamingLevels(app, st);
+	}
 }
 
-void SetObjParent(FilamentApp* app, OBJID id, OBJID parentId)
+void SetTextureStreaming(FilamentApp* app, const TextureStreamingOptions& options)
 {
-	auto& tcm = app->engine->getTransformManager();
-	auto& parentObj = app->entities[parentId];
-	auto& obj = app->entities[id];
-	auto parentInstance = tcm.getInstance(parentObj);
-	auto objInstance = tcm.getInstance(obj);
-	tcm.setParent(objInstance, parentInstance);
+	app->textureStreaming = options;
 }
 
-void SetObjVisible(FilamentApp* app, const OBJID id, const bool visible)
+void GetTextureStreamingStats(FilamentApp* app, TextureStreamingStats& stats)
 {
-	auto& obj = app->entities[id];
-	auto& rm = app->engine->getRenderableManager();
-	auto objInstance = rm.getInstance(obj);
-
-	rm.setLayerMask(objInstance, INVISIBLE_LAYER, visible ? 0 : INVISIBLE_LAYER);
-	rm.setLayerMask(objInstance, MAIN_LAYER, visible ? MAIN_LAYER : 0);
+	stats = app->streamingStats;
 }
 
+static Texture* CreateTexture(FilamentApp* app, const TextureInfo& info, MaterialUpdateStats& stats) {
 
-static Texture* CreateTexture(FilamentApp* app, const TextureInfo& info) {
+	if (app->textureStreaming.enabled && info.levels > 1) {
+		auto pixelSize = StreamingPixelSize(info.width, info.height, info.data);
+		if (pixelSize != 0)
+			return CreateStreamingTexture(app, info, pixelSize, stats);
+	}
 
-	auto usage = info.levels > 1 && info.data.type != Texture::Type::COMPRESSED ?
-		Texture::Usage::DEFAULT | Texture::Usage::GEN_MIPMAPPABLE :
-		Texture::Usage::DEFAULT;
+	auto usage = TextureUsage(info.levels, info.data.type);
 
 	#ifdef __ANDROID__
 		__android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, "width=%u height=%u fmt=%d levels=%u texId=%u",
@@ -895,36 +3135,97 @@ static Texture* CreateTexture(FilamentApp* app, const TextureInfo& info) {
 		.sampler(Texture::Sampler::SAMPLER_2D)
 		.build(*app->engine);
 
-	app->textures[info.textureId] = texture;
+	TextureEntry entry = { texture, 0, nullptr };
+
+	stats.bytesUploaded += UploadTexture(app, entry, info.data);
+	stats.texturesUploaded++;
 
-	UpdateTexture(app, info.textureId, info.data);
+	app->textures.set(info.textureId, entry);
 	
 	return texture;
 }
 
-static Texture* GetOrCreateTexture(FilamentApp* app, const TextureInfo& info) {
+static Texture* GetOrCreateTexture(FilamentApp* app, const TextureInfo& info, MaterialUpdateStats& stats) {
 
-	if (app->textures.count(info.textureId) > 0) {
-		auto texture = app->textures[info.textureId];
-		if (info.data.dataSize > 0)
-			UpdateTexture(app, info.textureId, info.data);
-		return texture;
+	if (auto cur = app->textures.find(info.textureId)) {
+		auto bytes = UploadTexture(app, *cur, info.data);
+		if (bytes > 0) {
+			stats.bytesUploaded += bytes;
+			stats.texturesUploaded++;
+		}
+		return cur->texture;
 	}
+
+	// Referenced by id only, but never uploaded
+	if (info.data.data == nullptr)
+		return nullptr;
 	
-	return CreateTexture(app, info);
+	return CreateTexture(app, info, stats);
 }
 
-bool UpdateTexture(FilamentApp* app, OBJID textId, const ImageData& data) {
+// Map data still owned by the info: PreloadMaterialTextures clears dataSize of what it hands over
+static void FreeTextureData(const TextureInfo& map) {
+	if (map.data.autoFree && map.data.data != nullptr && map.data.dataSize != 0)
+		UploadFree(map.data.data);
+}
 
-	if (app->textures.count(textId) == 0)
-		return false;
+// For an info that won't be applied, else its autoFree maps leak
+static void FreeMaterialTextures(const ::MaterialInfo& info) {
+	const TextureInfo* maps[] = { &info.baseColorMap, &info.normalMap, &info.metallicRoughnessMap, &info.aoMap, &info.emissiveMap };
+	for (auto map : maps)
+		FreeTextureData(*map);
+}
+
+// Only meaningful on an info gone through ResolveMaterialMaps
+static bool HasMap(const TextureInfo& map) {
+	return map.textureId != 0 || map.data.data != nullptr;
+}
+
+// An id with no data and no texture created yet is no map, else the shader would sample an unbound one
+static void ResolveMaterialMaps(FilamentApp* app, ::MaterialInfo& info) {
+
+	TextureInfo* maps[] = { &info.baseColorMap, &info.normalMap, &info.metallicRoughnessMap, &info.aoMap };
+
+	for (auto map : maps) {
+		if (map->data.data != nullptr || map->textureId == 0)
+			continue;
+		auto entry = app->textures.find(map->textureId);
+		if (entry == nullptr || entry->texture == nullptr)
+			map->textureId = 0;
+	}
+}
+
+// Uploads data unless its version is the one already in the texture, returns the bytes uploaded
+static uint64_t UploadTexture(FilamentApp* app, TextureEntry& entry, const ImageData& data) {
+
+	if (data.data == nullptr || data.dataSize == 0)
+		return 0;
+
+	if (data.version != 0 && data.version == entry.version) {
+		if (data.autoFree)
+			UploadFree(data.data);
+		return 0;
+	}
+
+	// Streamed textures get the new chain once it's built, at the levels already resident
+	if (auto st = entry.streaming) {
+		auto pixelSize = StreamingPixelSize(st->width, st->height, data);
+		if (pixelSize == 0)
+			StopStreaming(app, entry, data.type);
+		else {
+			StartStreamingBuild(app, st, data, pixelSize);
+			st->dirty = true;
+			entry.version = data.version;
+			return 0;
+		}
+	}
 
-	Texture* texture = app->textures[textId];
+	Texture* texture = entry.texture;
 
 	if (data.isBgr) {
 
 		auto lineSize = texture->getWidth() * 4;
-		auto bgrData = new uint8_t[data.dataSize];
+		auto bgrData = (uint8_t*)UploadAlloc(data.dataSize, UploadTag::TEX);
 		auto src = data.data;
 		auto h = texture->getHeight();
 
@@ -945,9 +3246,15 @@ bool UpdateTexture(FilamentApp* app, OBJID textId, const ImageData& data) {
 			data.format, data.type, DeleteBuffer, (void*)"TEX");
 
 		texture->setImage(*app->engine, 0, std::move(buffer));
+
+		if (data.autoFree)
+			UploadFree(data.data);
 	}
 	else {
 
+		if (data.autoFree)
+			UploadRetag(data.data, UploadTag::TEX);
+
 		Texture::PixelBufferDescriptor buffer(data.data, data.dataSize,
 			data.format, data.type, data.autoFree ? DeleteBuffer : nullptr, (void*)"TEX");
 		texture->setImage(*app->engine, 0, std::move(buffer));
@@ -956,6 +3263,19 @@ bool UpdateTexture(FilamentApp* app, OBJID textId, const ImageData& data) {
 	if (texture->getLevels() > 1 && data.type != Texture::Type::COMPRESSED)
 		texture->generateMipmaps(*app->engine);
 
+	entry.version = data.version;
+
+	return data.dataSize;
+}
+
+bool UpdateTexture(FilamentApp* app, OBJID textId, const ImageData& data) {
+
+	auto cur = app->textures.find(textId);
+	if (!cur)
+		return false;
+
+	UploadTexture(app, *cur, data);
+
 	return true;
 }
 
@@ -1023,276 +3343,749 @@ static Package BuildMaterial(FilamentApp* app, const ::MaterialInfo& info) {
 		.targetApi(targetApiFromBackend(app->engine->getBackend()))
 		.blending(info.blending);
 
-	if (info.blending == BlendingMode::TRANSPARENT || info.blending == BlendingMode::FADE)
-		builder.transparentShadow(true);
+	if (info.blending == BlendingMode::TRANSPARENT || info.blending == BlendingMode::FADE)
+		builder.transparentShadow(true);
+
+	if (!info.isLit && info.isShadowOnly)
+		builder.shadowMultiplier(true);
+
+	builder.parameter("baseColor", MaterialBuilder::UniformType::FLOAT4);
+
+
+	std::string shader = R"SHADER(
+        void material(inout MaterialInputs material) {
+    )SHADER";
+
+	shader += R"SHADER(
+			vec2 uv0 = ${uv};
+			material.baseColor = materialParams.baseColor;
+        )SHADER";
+
+	if (HasMap(info.normalMap)) {
+		shader += R"SHADER(
+            material.normal = texture(materialParams_normalMap, uv0).xyz * 2.0 - 1.0;
+            material.normal.xy *= materialParams.normalScale;
+        )SHADER";
+
+		builder.parameter("normalMap", MaterialBuilder::SamplerType::SAMPLER_2D);
+		builder.parameter("normalScale", MaterialBuilder::UniformType::FLOAT);
+		//builder.require(filament::VertexAttribute::TANGENTS);
+		hasUV = true;
+	}
+
+	shader += R"SHADER(
+        prepareMaterial(material);
+    )SHADER";
+
+
+	if (HasMap(info.baseColorMap)) {
+		shader += R"SHADER(
+            material.baseColor *= texture(materialParams_baseColorMap, uv0);
+        )SHADER";
+		builder.parameter("baseColorMap", MaterialBuilder::SamplerType::SAMPLER_2D);
+		hasUV = true;
+	}
+
+	if (info.blending == BlendingMode::TRANSPARENT) {
+		shader += R"SHADER(
+            material.baseColor.rgb *= material.baseColor.a;
+        )SHADER";
+	}
+
+	builder.parameter("enableDiagnostics", MaterialBuilder::UniformType::BOOL);
+
+	if (info.isLit) {
+
+		builder.parameter("roughnessFactor", MaterialBuilder::UniformType::FLOAT);
+		builder.parameter("metallicFactor", MaterialBuilder::UniformType::FLOAT);
+		builder.parameter("emissiveFactor", MaterialBuilder::UniformType::FLOAT3);
+		builder.parameter("emissiveStrength", MaterialBuilder::UniformType::FLOAT);
+		builder.parameter("reflectance", MaterialBuilder::UniformType::FLOAT);
+
+		shader += R"SHADER(
+                material.roughness = materialParams.roughnessFactor;
+                material.metallic = materialParams.metallicFactor;
+                material.reflectance = materialParams.reflectance;
+				)SHADER";
+
+
+		if (HasMap(info.metallicRoughnessMap)) {
+			shader += R"SHADER(
+            material.metallic *= texture(materialParams_metallicRoughnessMap, uv0).b;
+            material.roughness *= texture(materialParams_metallicRoughnessMap, uv0).g;
+			)SHADER";
+			builder.parameter("metallicRoughnessMap", MaterialBuilder::SamplerType::SAMPLER_2D);
+			hasUV = true;
+		}
+
+		if (HasMap(info.aoMap)) {
+
+			shader += R"SHADER(
+            float occlusion = texture(materialParams_aoMap, uv0).r;
+            material.ambientOcclusion = 1.0 + materialParams.aoStrength * (occlusion - 1.0);
+			)SHADER";
+			builder.parameter("aoMap", MaterialBuilder::SamplerType::SAMPLER_2D);
+			builder.parameter("aoStrength", MaterialBuilder::UniformType::FLOAT);
+			hasUV = true;
+		}
+		else {
+			shader += R"SHADER(
+            material.ambientOcclusion = 1.0;
+			)SHADER";
+		}
+	}
+
+	if (info.lineWidth > 0) {
+
+		builder.require(filament::VertexAttribute::COLOR);
+
+		shader += R"SHADER(
+			material.baseColor = getColor();
+        )SHADER";
+	}
+	
+	shader += "}\n";
+
+	if (hasUV) {
+		builder.require(filament::VertexAttribute::UV0);
+
+		replaceAll(shader, "${uv}", "getUV0()");
+	}
+	else
+		replaceAll(shader, "${uv}", "vec2(0.0)");
+
+
+	builder.material(shader.c_str());
+	builder.optimization(MaterialBuilder::Optimization::NONE);
+	builder.generateDebugInfo(true);
+
+	return builder.build(app->engine->getJobSystem());
+}
+
+
+static MaterialUpdateStats UpdateMaterialInstance(FilamentApp* app, MaterialInstance* instance, const ::MaterialInfo& info);
+
+// Packs everything BuildMaterial branches on, keys both the loaded materials and the package cache
+static MATKEY MaterialKey(FilamentApp* app, const ::MaterialInfo& info)
+{
+	MATKEY key = (MATKEY)app->engine->getBackend() & 0xF;
+
+	key |= ((MATKEY)info.blending & 0xF) << 4;
+
+	uint32_t bit = 8;
+	auto flag = [&](bool value) {
+		if (value)
+			key |= (MATKEY)1 << bit;
+		bit++;
+	};
+
+	flag(info.doubleSided);
+	flag(HasMap(info.normalMap));
+	flag(HasMap(info.baseColorMap));
+	flag(HasMap(info.metallicRoughnessMap));
+	flag(HasMap(info.aoMap));
+	flag(app->isStereo);
+	flag(!info.isLit);
+	flag(!info.writeColor);
+	flag(!info.writeDepth);
+	flag(!info.useDepth);
+	flag(info.isShadowOnly);
+	flag(info.lineWidth > 0);
+
+	return key;
+}
+
+static bool MapMaterialArchive(MaterialArchive* archive)
+{
+#ifdef _WINDOWS
+	archive->file = CreateFileA(archive->path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (archive->file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(archive->file, &size) || size.QuadPart < (LONGLONG)sizeof(MaterialArchiveHeader)) {
+		CloseHandle(archive->file);
+		return false;
+	}
+
+	archive->mapHandle = CreateFileMappingA(archive->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	archive->mapping = archive->mapHandle ? (const uint8_t*)MapViewOfFile(archive->mapHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	archive->mappedSize = (size_t)size.QuadPart;
+
+	if (archive->mapping == nullptr) {
+		if (archive->mapHandle)
+			CloseHandle(archive->mapHandle);
+		CloseHandle(archive->file);
+		return false;
+	}
+#else
+	int fd = open(archive->path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MaterialArchiveHeader)) {
+		close(fd);
+		return false;
+	}
+
+	auto mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+		return false;
+
+	archive->mapping = (const uint8_t*)mapping;
+	archive->mappedSize = (size_t)st.st_size;
+#endif
+	return true;
+}
+
+static void UnmapMaterialArchive(MaterialArchive* archive)
+{
+	if (archive->mapping == nullptr)
+		return;
+#ifdef _WINDOWS
+	UnmapViewOfFile(archive->mapping);
+	CloseHandle(archive->mapHandle);
+	CloseHandle(archive->file);
+#else
+	munmap((void*)archive->mapping, archive->mappedSize);
+#endif
+	archive->mapping = nullptr;
+	archive->mappedSize = 0;
+	archive->index.clear();
+}
+
+static uint64_t RecordBytes(uint64_t size)
+{
+	return sizeof(MaterialRecord) + ((size + 7) & ~7ull);
+}
+
+// Indexes the records up to the first incomplete one (interrupted append), returns the bytes held by other versions
+static uint64_t ScanMaterialArchive(MaterialArchive* archive)
+{
+	archive->end = sizeof(MaterialArchiveHeader);
+
+	auto header = (const MaterialArchiveHeader*)archive->mapping;
+	if (header->magic != MAT_ARCHIVE_MAGIC || header->format != MAT_ARCHIVE_FORMAT)
+		return 0;
+
+	uint64_t stale = 0;
+	uint64_t pos = archive->end;
+
+	while (pos + sizeof(MaterialRecord) <= archive->mappedSize) {
+
+		auto record = (const MaterialRecord*)(archive->mapping + pos);
+		auto bytes = RecordBytes(record->size);
+		auto data = archive->mapping + pos + sizeof(MaterialRecord);
+
+		if (record->magic != MAT_RECORD_MAGIC || record->size > archive->mappedSize - pos - sizeof(MaterialRecord) ||
+			HashBytes(record->key, data, record->size) != record->checksum)
+			break;
 
-	if (!info.isLit && info.isShadowOnly)
-		builder.shadowMultiplier(true);
+		if (strncmp(record->version, MAT_VERSION, sizeof(record->version)) == 0) {
+			auto cur = archive->index.find(record->key);
+			if (cur != archive->index.end())
+				stale += RecordBytes(cur->second.size);
+			archive->index[record->key] = { data, record->size };
+		}
+		else
+			stale += bytes;
 
-	builder.parameter("baseColor", MaterialBuilder::UniformType::FLOAT4);
+		pos += bytes;
+		archive->end = pos;
+	}
 
+	return stale;
+}
 
-	std::string shader = R"SHADER(
-        void material(inout MaterialInputs material) {
-    )SHADER";
+static bool WriteMaterialRecord(FILE* fd, MATKEY key, const uint8_t* data, uint64_t size)
+{
+	MaterialRecord record = {};
+	record.magic = MAT_RECORD_MAGIC;
+	record.key = key;
+	memcpy(record.version, MAT_VERSION, std::min(sizeof(record.version), strlen(MAT_VERSION)));
+	record.size = size;
+	record.checksum = HashBytes(key, data, size);
+
+	const uint64_t zero = 0;
+	auto pad = (size_t)(RecordBytes(size) - sizeof(MaterialRecord) - size);
+
+	return fwrite(&record, sizeof(record), 1, fd) == 1 &&
+		fwrite(data, 1, size, fd) == size &&
+		fwrite(&zero, 1, pad, fd) == pad;
+}
 
-	shader += R"SHADER(
-			vec2 uv0 = ${uv};
-			material.baseColor = materialParams.baseColor;
-        )SHADER";
+// Rewrites the current version records in a new file swapped in by rename
+static bool CompactMaterialArchive(MaterialArchive* archive)
+{
+	auto tmpPath = archive->path + ".tmp";
 
-	if (info.normalMap.data.data != nullptr) {
-		shader += R"SHADER(
-            material.normal = texture(materialParams_normalMap, uv0).xyz * 2.0 - 1.0;
-            material.normal.xy *= materialParams.normalScale;
-        )SHADER";
+	FILE* fd;
+	if (fopen_s(&fd, tmpPath.c_str(), "wb") != 0)
+		return false;
 
-		builder.parameter("normalMap", MaterialBuilder::SamplerType::SAMPLER_2D);
-		builder.parameter("normalScale", MaterialBuilder::UniformType::FLOAT);
-		//builder.require(filament::VertexAttribute::TANGENTS);
-		hasUV = true;
+	MaterialArchiveHeader header = { MAT_ARCHIVE_MAGIC, MAT_ARCHIVE_FORMAT, 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, fd) == 1;
+
+	for (auto& item : archive->index) {
+		if (!ok)
+			break;
+		ok = WriteMaterialRecord(fd, item.first, item.second.data, item.second.size);
 	}
 
-	shader += R"SHADER(
-        prepareMaterial(material);
-    )SHADER";
+	ok = fflush(fd) == 0 && ok;
+	fclose(fd);
 
+	UnmapMaterialArchive(archive);
 
-	if (info.baseColorMap.textureId != (OBJID)0) {
-		shader += R"SHADER(
-            material.baseColor *= texture(materialParams_baseColorMap, uv0);
-        )SHADER";
-		builder.parameter("baseColorMap", MaterialBuilder::SamplerType::SAMPLER_2D);
-		hasUV = true;
+	std::error_code ec;
+	if (ok)
+		std::filesystem::rename(tmpPath, archive->path, ec);
+	else
+		std::filesystem::remove(tmpPath, ec);
+
+	return ok && !ec;
+}
+
+static MaterialArchive* OpenMaterialArchive(const std::string& dir)
+{
+	auto archive = new MaterialArchive();
+	archive->path = dir + "/materials.pak";
+	archive->mapping = nullptr;
+	archive->mappedSize = 0;
+	archive->end = 0;
+
+	if (!MapMaterialArchive(archive))
+		return archive;
+
+	auto stale = ScanMaterialArchive(archive);
+
+	// Worth a rewrite once a quarter of the file is dead
+	if (stale > 0 && stale * 4 >= archive->end) {
+		CompactMaterialArchive(archive);
+		if (MapMaterialArchive(archive))
+			ScanMaterialArchive(archive);
 	}
 
-	if (info.blending == BlendingMode::TRANSPARENT) {
-		shader += R"SHADER(
-            material.baseColor.rgb *= material.baseColor.a;
-        )SHADER";
+	return archive;
+}
+
+static const MaterialArchiveEntry* FindArchivedMaterial(MaterialArchive* archive, MATKEY key)
+{
+	if (archive == nullptr)
+		return nullptr;
+
+	auto cur = archive->index.find(key);
+
+	return cur != archive->index.end() ? &cur->second : nullptr;
+}
+
+// Called from the build jobs; a record only counts once complete, an interrupted one is overwritten by the next append
+static void AppendMaterialArchive(MaterialArchive* archive, MATKEY key, const uint8_t* data, uint64_t size)
+{
+	std::lock_guard<std::mutex> lock(archive->appendLock);
+
+	FILE* fd;
+
+	if (archive->end <= sizeof(MaterialArchiveHeader)) {
+		if (fopen_s(&fd, archive->path.c_str(), "wb") != 0)
+			return;
+		MaterialArchiveHeader header = { MAT_ARCHIVE_MAGIC, MAT_ARCHIVE_FORMAT, 0 };
+		fwrite(&header, sizeof(header), 1, fd);
+		archive->end = sizeof(MaterialArchiveHeader);
 	}
+	else if (fopen_s(&fd, archive->path.c_str(), "r+b") != 0)
+		return;
 
-	builder.parameter("enableDiagnostics", MaterialBuilder::UniformType::BOOL);
+	fseek(fd, (long)archive->end, SEEK_SET);
 
-	if (info.isLit) {
+	bool ok = WriteMaterialRecord(fd, key, data, size);
+	ok = fflush(fd) == 0 && ok;
+	fclose(fd);
 
-		builder.parameter("roughnessFactor", MaterialBuilder::UniformType::FLOAT);
-		builder.parameter("metallicFactor", MaterialBuilder::UniformType::FLOAT);
-		builder.parameter("emissiveFactor", MaterialBuilder::UniformType::FLOAT3);
-		builder.parameter("emissiveStrength", MaterialBuilder::UniformType::FLOAT);
-		builder.parameter("reflectance", MaterialBuilder::UniformType::FLOAT);
+	if (ok)
+		archive->end += RecordBytes(size);
+}
 
-		shader += R"SHADER(
-                material.roughness = materialParams.roughnessFactor;
-                material.metallic = materialParams.metallicFactor;
-                material.reflectance = materialParams.reflectance;
-				)SHADER";
+// Loads the package from the archive or compiles it; touches no engine state, runs on the JobSystem
+static void BuildVariant(FilamentApp* app, MaterialVariant* variant)
+{
+	auto start = std::chrono::steady_clock::now();
 
+	if (auto entry = FindArchivedMaterial(app->materialArchive, variant->key)) {
+		variant->package = entry->data;
+		variant->packageSize = (size_t)entry->size;
+		variant->source = MaterialSource::Cache;
+	}
+	else {
 
-		if (info.metallicRoughnessMap.data.data != nullptr) {
-			shader += R"SHADER(
-            material.metallic *= texture(materialParams_metallicRoughnessMap, uv0).b;
-            material.roughness *= texture(materialParams_metallicRoughnessMap, uv0).g;
-			)SHADER";
-			builder.parameter("metallicRoughnessMap", MaterialBuilder::SamplerType::SAMPLER_2D);
-			hasUV = true;
-		}
+		auto package = BuildMaterial(app, variant->info);
 
-		if (info.aoMap.data.data != nullptr) {
+		if (package.isValid()) {
 
-			shader += R"SHADER(
-            float occlusion = texture(materialParams_aoMap, uv0).r;
-            material.ambientOcclusion = 1.0 + materialParams.aoStrength * (occlusion - 1.0);
-			)SHADER";
-			builder.parameter("aoMap", MaterialBuilder::SamplerType::SAMPLER_2D);
-			builder.parameter("aoStrength", MaterialBuilder::UniformType::FLOAT);
-			hasUV = true;
-		}
-		else {
-			shader += R"SHADER(
-            material.ambientOcclusion = 1.0;
-			)SHADER";
+			variant->packageSize = package.getSize();
+			variant->ownedPackage = new uint8_t[variant->packageSize];
+			memcpy(variant->ownedPackage, package.getData(), variant->packageSize);
+			variant->package = variant->ownedPackage;
+			variant->source = MaterialSource::Compiled;
+
+			if (app->materialArchive)
+				AppendMaterialArchive(app->materialArchive, variant->key, variant->package, variant->packageSize);
 		}
 	}
 
-	if (info.lineWidth > 0) {
+	variant->milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-		builder.require(filament::VertexAttribute::COLOR);
+	variant->state.store((uint32_t)(variant->package != nullptr ? MaterialState::Built : MaterialState::Failed), std::memory_order_release);
+}
 
-		shader += R"SHADER(
-			material.baseColor = getColor();
-        )SHADER";
+// Finds the variant of info, a new one is built inline or queued on the JobSystem
+static MaterialVariant* GetMaterialVariant(FilamentApp* app, const ::MaterialInfo& info, bool async)
+{
+	// Resolved here, the build may run on the JobSystem where app->textures can't be read
+	::MaterialInfo resolved = info;
+	ResolveMaterialMaps(app, resolved);
+
+	auto key = MaterialKey(app, resolved);
+
+	auto cur = app->materials.find(key);
+	if (cur != app->materials.end())
+		return cur->second;
+
+	auto variant = new MaterialVariant();
+	variant->key = key;
+	variant->material = nullptr;
+	variant->package = nullptr;
+	variant->packageSize = 0;
+	variant->ownedPackage = nullptr;
+	variant->source = MaterialSource::Compiled;
+	variant->milliseconds = 0;
+	variant->job = nullptr;
+	variant->state.store((uint32_t)MaterialState::Pending, std::memory_order_relaxed);
+	variant->info = resolved;
+
+	app->materials[key] = variant;
+
+	if (async) {
+		auto& js = app->engine->getJobSystem();
+		variant->job = jobs::createJob(js, nullptr, [app, variant]() {
+			BuildVariant(app, variant);
+		});
+		js.runAndRetain(variant->job);
 	}
-	
-	shader += "}\n";
+	else
+		BuildVariant(app, variant);
 
-	if (hasUV) {
-		builder.require(filament::VertexAttribute::UV0);
+	return variant;
+}
 
-		replaceAll(shader, "${uv}", "getUV0()");
+// Creates the Material once the package is there; wait blocks on a queued build
+static MaterialState FinishVariant(FilamentApp* app, MaterialVariant* variant, bool wait)
+{
+	if (variant->job) {
+		auto& js = app->engine->getJobSystem();
+		if (wait)
+			js.waitAndRelease(variant->job);
+		else if (variant->state.load(std::memory_order_acquire) == (uint32_t)MaterialState::Pending)
+			return MaterialState::Pending;
+		else
+			js.release(variant->job);
+		variant->job = nullptr;
 	}
-	else
-		replaceAll(shader, "${uv}", "vec2(0.0)");
 
+	auto state = (MaterialState)variant->state.load(std::memory_order_acquire);
 
-	builder.material(shader.c_str());
-	builder.optimization(MaterialBuilder::Optimization::NONE);
-	builder.generateDebugInfo(true);
+	if (state == MaterialState::Built) {
 
-	return builder.build(app->engine->getJobSystem());
-}
+		variant->material = Material::Builder()
+			.package(variant->package, variant->packageSize)
+			.build(*app->engine);
+
+		delete[] variant->ownedPackage;
+		variant->ownedPackage = nullptr;
+		variant->package = nullptr;
 
+		state = variant->material != nullptr ? MaterialState::Ready : MaterialState::Failed;
+		variant->state.store((uint32_t)state, std::memory_order_relaxed);
+	}
+
+	return state;
+}
 
-void AddMaterial(FilamentApp* app, OBJID id, const ::MaterialInfo& info) noexcept(false)
+OBJHANDLE AddMaterial(FilamentApp* app, OBJID id, const ::MaterialInfo& info) noexcept(false)
 {
-	std::string hash("pbr_v4_p");
+	auto variant = GetMaterialVariant(app, info, false);
 
-	hash += std::to_string((int)app->engine->getBackend());
+	if (FinishVariant(app, variant, true) != MaterialState::Ready)
+		throw "Material Build Error";
 
-	hash += "_bl" + std::to_string((int)info.blending);
+	auto instance = variant->material->createInstance();
 
-	if (info.doubleSided)
-		hash += "_ds";
+	UpdateMaterialInstance(app, instance, info);
 
-	if (info.normalMap.data.data != nullptr)
-		hash += "_nm";
+	return app->materialsInst.set(id, instance);
+}
 
-	if (info.baseColorMap.textureId != 0)
-		hash += "_cm";
+// The caller's texture data is only valid during the call: uploaded now, the info keeps the map presence only
+static void PreloadMaterialTextures(FilamentApp* app, ::MaterialInfo& info)
+{
+	TextureInfo* maps[] = { &info.baseColorMap, &info.normalMap, &info.metallicRoughnessMap, &info.aoMap };
 
-	if (info.metallicRoughnessMap.data.data != nullptr)
-		hash += "_mrm";
+	for (auto map : maps) {
+		if (map->data.data != nullptr) {
+			GetOrCreateTexture(app, *map, app->materialUpdateStats);
+			map->data.dataSize = 0;
+		}
+	}
 
-	if (info.aoMap.data.data != nullptr)
-		hash += "_aom";
+	// Not sampled by any variant
+	FreeTextureData(info.emissiveMap);
+	info.emissiveMap.data.dataSize = 0;
+}
 
-	if (app->isStereo)
-		hash += "_st";
+OBJHANDLE AddMaterialAsync(FilamentApp* app, OBJID id, const ::MaterialInfo& info) noexcept(false)
+{
+	auto variant = GetMaterialVariant(app, info, true);
 
-	if (!info.isLit)
-		hash += "_nl";
+	auto state = FinishVariant(app, variant, false);
 
-	if (!info.writeColor)
-		hash += "_nc";
-	
-	if (!info.writeDepth)
-		hash += "_nd";
+	if (state == MaterialState::Ready) {
+		auto instance = variant->material->createInstance();
+		UpdateMaterialInstance(app, instance, info);
+		return app->materialsInst.set(id, instance);
+	}
 
-	if (!info.useDepth)
-		hash += "_nud";
+	if (state == MaterialState::Failed)
+		throw "Material Build Error";
 
-	if (info.isShadowOnly)
-		hash += "_so";
+	PendingMaterial pending = {};
+	pending.id = id;
+	pending.variant = variant;
+	pending.info = info;
 
-	if (info.lineWidth > 0)
-		hash += "_l";
+	PreloadMaterialTextures(app, pending.info);
 
-	hash += MAT_VERSION;
+	pending.fallback = app->engine->getDefaultMaterial()->createInstance();
+	pending.handle = app->materialsInst.set(id, pending.fallback);
 
-	Material* flMat;
+	app->pendingMaterials.push_back(std::move(pending));
 
-	if (app->materials.find(hash) == app->materials.end()) {
+	return app->pendingMaterials.back().handle;
+}
 
-		Package package;
-		bool mustBuild = true;
+// Swaps the fallbacks of the variants done building; wait blocks until all of them are
+static void CompleteMaterials(FilamentApp* app, bool wait)
+{
+	auto& pendings = app->pendingMaterials;
+	auto& rm = app->engine->getRenderableManager();
 
-		if (app->materialCachePath.length() > 0) {
+	for (size_t i = 0; i < pendings.size();) {
 
-			std::string fileName = app->materialCachePath + "/" + hash + ".mat";
+		auto& pending = pendings[i];
 
-			if (std::filesystem::exists(fileName)) {
+		auto state = FinishVariant(app, pending.variant, wait);
 
-				FILE* fd;
-				
-				if (fopen_s(&fd, fileName.c_str(), "rb") != 0)
-					throw "Backed material open failed";
+		if (state == MaterialState::Pending) {
+			i++;
+			continue;
+		}
 
-				fseek(fd, 0L, SEEK_END);
-				auto sz = ftell(fd);
-				rewind(fd);
-				auto pack = new uint8_t[sz];
-				fread(pack, 1, sz, fd);
-				fclose(fd);
+		// A failed variant keeps rendering with the default material
+		if (state == MaterialState::Ready) {
 
-				package = Package(pack, sz);
+			auto instance = pending.variant->material->createInstance();
+			UpdateMaterialInstance(app, instance, pending.info);
+			app->materialsInst.set(pending.id, instance);
 
-				mustBuild = false;
+			for (auto mesh : pending.meshes) {
+				auto renderable = rm.getInstance(mesh);
+				if (renderable.isValid() && rm.getMaterialInstanceAt(renderable, 0) == pending.fallback)
+					rm.setMaterialInstanceAt(renderable, 0, instance);
 			}
+
+			app->engine->destroy(pending.fallback);
 		}
-		if (mustBuild) {
 
-			package = BuildMaterial(app, info);
-			
-			if (!package.isValid())
-				throw "Material Build Error";
+		pendings[i] = std::move(pendings.back());
+		pendings.pop_back();
+	}
+}
 
-			if (app->materialCachePath.length() > 0) {
+uint32_t PrewarmMaterials(FilamentApp* app, const ::MaterialInfo infos[], uint32_t count)
+{
+	std::vector<MaterialVariant*> variants;
+	variants.reserve(count);
 
-				std::string fileName = app->materialCachePath + "/" + hash + ".mat";
+	// Everything queued before waiting, the builds run in parallel
+	for (uint32_t i = 0; i < count; i++)
+		variants.push_back(GetMaterialVariant(app, infos[i], true));
 
-				FILE* fd;
-				if (fopen_s(&fd, fileName.c_str(), "wb") == 0) {
+	uint32_t ready = 0;
 
-					fwrite(package.getData(), 1, package.getSize(), fd);
-					fflush(fd);
-					fclose(fd);
-				}
-	
-			}
+	for (auto variant : variants) {
+		if (FinishVariant(app, variant, true) == MaterialState::Ready)
+			ready++;
+	}
+
+	CompleteMaterials(app, false);
+
+	return ready;
+}
+
+uint32_t GetMaterialTimings(FilamentApp* app, MaterialTiming timings[], uint32_t capacity)
+{
+	uint32_t count = 0;
+
+	for (auto& item : app->materials) {
+		if (count < capacity) {
+			auto& timing = timings[count];
+			auto variant = item.second;
+			timing.key = variant->key;
+			timing.milliseconds = variant->milliseconds;
+			timing.source = variant->source;
+			timing.state = (MaterialState)variant->state.load(std::memory_order_acquire);
 		}
+		count++;
+	}
 
-		flMat = Material::Builder()
-			.package(package.getData(), package.getSize())
-			.build(*app->engine);
+	return count;
+}
 
-		app->materials[hash] = flMat;
+static MaterialUpdateStats UpdateMaterialByHandle(FilamentApp* app, OBJHANDLE handle, const ::MaterialInfo& info)
+{
+	for (auto& pending : app->pendingMaterials) {
+		if (pending.handle != handle)
+			continue;
+
+		pending.info = info;
+		PreloadMaterialTextures(app, pending.info);
+		return {};
 	}
-	else
-		flMat = app->materials[hash];
 
-	app->materialsInst[id] = flMat->createInstance();
+	if (auto instance = app->materialsInst.get(handle))
+		return UpdateMaterialInstance(app, *instance, info);
+
+	FreeMaterialTextures(info);
+
+	return {};
+}
+
+MaterialUpdateStats UpdateMaterial(FilamentApp* app, OBJID id, const ::MaterialInfo& info) 
+{
+	return UpdateMaterialByHandle(app, app->materialsInst.handle(id), info);
+}
+
+static void SetMaterialTexture(FilamentApp* app, MaterialInstance* instance, const char* name, const TextureInfo& map, const TextureInfo* last, MaterialUpdateStats& stats)
+{
+	// Always through GetOrCreateTexture: it owns the version check and frees autoFree data it skips
+	bool created = !app->textures.find(map.textureId);
+
+	auto texture = GetOrCreateTexture(app, map, stats);
 
-	UpdateMaterial(app, id, info);
+	if (texture != nullptr && (created || last == nullptr || last->textureId != map.textureId)) {
+
+		if (last != nullptr && last->textureId != map.textureId)
+			UnbindStreaming(app, last->textureId, instance, name);
+
+		instance->setParameter(name, texture, s_mapSampler);
+		stats.parametersChanged++;
+
+		if (auto st = app->textures.find(map.textureId)->streaming)
+			st->bindings.push_back({ instance, name });
+	}
 }
 
-void UpdateMaterial(FilamentApp* app, OBJID id, const ::MaterialInfo& info) 
+// Sets only what differs from the last info applied to the instance
+static MaterialUpdateStats UpdateMaterialInstance(FilamentApp* app, MaterialInstance* instance, const ::MaterialInfo& info)
 {
-	auto instance = app->materialsInst[id];
+	MaterialUpdateStats stats = {};
 
-	TextureSampler sampler(TextureSampler::MinFilter::LINEAR_MIPMAP_LINEAR,
-		TextureSampler::MagFilter::LINEAR, TextureSampler::WrapMode::REPEAT);
+	auto cur = app->appliedMaterials.find(instance);
+	const ::MaterialInfo* last = cur != app->appliedMaterials.end() ? &cur->second : nullptr;
 
-	instance->setParameter("enableDiagnostics", false);
-	instance->setParameter("baseColor", RgbaType::LINEAR, float4(info.baseColorFactor.r, info.baseColorFactor.g, info.baseColorFactor.b, info.baseColorFactor.a));
+	auto changed = [&](bool differs) {
+		if (differs)
+			stats.parametersChanged++;
+		return differs;
+	};
+
+	// Maps are bound as the variant was built, a map arriving later needs a new material
+	auto material = instance->getMaterial();
+
+	if (last == nullptr)
+		instance->setParameter("enableDiagnostics", false);
+
+	if (changed(!last || memcmp(&last->baseColorFactor, &info.baseColorFactor, sizeof(Color4)) != 0))
+		instance->setParameter("baseColor", RgbaType::LINEAR, float4(info.baseColorFactor.r, info.baseColorFactor.g, info.baseColorFactor.b, info.baseColorFactor.a));
 	
-	if (info.blending == BlendingMode::MASKED)
+	if (info.blending == BlendingMode::MASKED && changed(!last || last->alphaCutoff != info.alphaCutoff))
 		instance->setMaskThreshold(info.alphaCutoff);
 
-	if (info.baseColorMap.data.data != nullptr)
-		instance->setParameter("baseColorMap", GetOrCreateTexture(app, info.baseColorMap), sampler);
+	// Maps the instance has no parameter for are never uploaded, their data is freed instead
+	if (material->hasParameter("baseColorMap"))
+		SetMaterialTexture(app, instance, "baseColorMap", info.baseColorMap, last ? &last->baseColorMap : nullptr, stats);
+	else
+		FreeTextureData(info.baseColorMap);
 
 	if (info.isLit) {
 
-		instance->setParameter("metallicFactor", info.metallicFactor);
-		instance->setParameter("roughnessFactor", info.roughnessFactor);
-		instance->setParameter("emissiveStrength", info.emissiveStrength);
-		instance->setParameter("reflectance", info.reflectance);
-		instance->setParameter("emissiveFactor", float3(info.emissiveFactor.r, info.emissiveFactor.g, info.emissiveFactor.b));
-
-		if (info.normalMap.data.data != nullptr) {
-			instance->setParameter("normalMap", GetOrCreateTexture(app, info.normalMap), sampler);
-			instance->setParameter("normalScale", info.normalScale);
+		if (changed(!last || last->metallicFactor != info.metallicFactor))
+			instance->setParameter("metallicFactor", info.metallicFactor);
+		if (changed(!last || last->roughnessFactor != info.roughnessFactor))
+			instance->setParameter("roughnessFactor", info.roughnessFactor);
+		if (changed(!last || last->emissiveStrength != info.emissiveStrength))
+			instance->setParameter("emissiveStrength", info.emissiveStrength);
+		if (changed(!last || last->reflectance != info.reflectance))
+			instance->setParameter("reflectance", info.reflectance);
+		if (changed(!last || memcmp(&last->emissiveFactor, &info.emissiveFactor, sizeof(Color3)) != 0))
+			instance->setParameter("emissiveFactor", float3(info.emissiveFactor.r, info.emissiveFactor.g, info.emissiveFactor.b));
+
+		if (material->hasParameter("normalMap")) {
+			SetMaterialTexture(app, instance, "normalMap", info.normalMap, last ? &last->normalMap : nullptr, stats);
+			if (changed(!last || last->normalScale != info.normalScale))
+				instance->setParameter("normalScale", info.normalScale);
 		}
+		else
+			FreeTextureData(info.normalMap);
 
+		if (material->hasParameter("metallicRoughnessMap"))
+			SetMaterialTexture(app, instance, "metallicRoughnessMap", info.metallicRoughnessMap, last ? &last->metallicRoughnessMap : nullptr, stats);
+		else
+			FreeTextureData(info.metallicRoughnessMap);
 
-		if (info.metallicRoughnessMap.data.data != nullptr)
-			instance->setParameter("metallicRoughnessMap", GetOrCreateTexture(app, info.metallicRoughnessMap), sampler);
-
-		if (info.aoMap.data.data != nullptr) {
-			instance->setParameter("aoStrength", info.aoStrength);
-			instance->setParameter("aoMap", GetOrCreateTexture(app, info.aoMap), sampler);
+		if (material->hasParameter("aoMap")) {
+			if (changed(!last || last->aoStrength != info.aoStrength))
+				instance->setParameter("aoStrength", info.aoStrength);
+			SetMaterialTexture(app, instance, "aoMap", info.aoMap, last ? &last->aoMap : nullptr, stats);
 		}
+		else
+			FreeTextureData(info.aoMap);
+	}
+	else {
+		FreeTextureData(info.normalMap);
+		FreeTextureData(info.metallicRoughnessMap);
+		FreeTextureData(info.aoMap);
 	}
+
+	FreeTextureData(info.emissiveMap);
+
+	app->appliedMaterials[instance] = info;
+
+	auto& total = app->materialUpdateStats;
+	total.bytesUploaded += stats.bytesUploaded;
+	total.parametersChanged += stats.parametersChanged;
+	total.texturesUploaded += stats.texturesUploaded;
+
+	return stats;
+}
+
+void GetMaterialUpdateStats(FilamentApp* app, MaterialUpdateStats& stats, bool reset)
+{
+	stats = app->materialUpdateStats;
+	if (reset)
+		app->materialUpdateStats = {};
 }
 
 void AddImageLight(FilamentApp* app, const ImageLightInfo& info) {
@@ -1322,7 +4115,7 @@ void AddImageLight(FilamentApp* app, const ImageLightInfo& info) {
 	__android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, "AddImageLight");
 #endif
 
-	auto equirectTxt = CreateTexture(app, texture);
+	auto equirectTxt = CreateTexture(app, texture, app->materialUpdateStats);
 	
 	IBLPrefilterContext context(*app->engine);	
 	IBLPrefilterContext::EquirectangularToCubemap equirectangularToCubemap(context, { .mirror = false });
@@ -1392,12 +4185,184 @@ bool GetGraphicContext(FilamentApp* app, GraphicContextInfo& info)
 
 void SetObjTransform(FilamentApp* app, OBJID id, const Matrix4x4 matrix)
 {
+	auto obj = app->entities.find(id);
+	if (!obj)
+		return;
 	auto& tcm = app->engine->getTransformManager();
-	auto& obj = app->entities[id];
-	auto instance = tcm.getInstance(obj);
+	auto instance = tcm.getInstance(*obj);
 	tcm.setTransform(instance, MatFromArray(matrix));
 }
 
+void SetObjTransforms(FilamentApp* app, const OBJID ids[], const Matrix4x4 matrices[], uint32_t count)
+{
+	auto& tcm = app->engine->getTransformManager();
+
+	// World transforms of the whole batch are resolved once on commit, instead of once per object
+	tcm.openLocalTransformTransaction();
+
+	for (uint32_t i = 0; i < count; i++) {
+		auto obj = app->entities.find(ids[i]);
+		if (!obj)
+			continue;
+		auto instance = tcm.getInstance(*obj);
+		if (instance)
+			tcm.setTransform(instance, MatFromArray(matrices[i]));
+	}
+
+	tcm.commitLocalTransformTransaction();
+}
+
+OBJHANDLE GetObjHandle(FilamentApp* app, OBJID id)
+{
+	return app->entities.handle(id);
+}
+
+void SetObjTransformsByHandle(FilamentApp* app, const OBJHANDLE handles[], const Matrix4x4 matrices[], uint32_t count)
+{
+	auto& tcm = app->engine->getTransformManager();
+
+	tcm.openLocalTransformTransaction();
+
+	for (uint32_t i = 0; i < count; i++) {
+		auto obj = app->entities.get(handles[i]);
+		if (!obj)
+			continue;
+		auto instance = tcm.getInstance(*obj);
+		if (instance)
+			tcm.setTransform(instance, MatFromArray(matrices[i]));
+	}
+
+	tcm.commitLocalTransformTransaction();
+}
+
+// One ring per app: a writer may still hold the pointer, so a second call returns the existing ring (and its capacity)
+CommandRing* CreateCommandRing(FilamentApp* app, uint32_t capacity)
+{
+	if (app->commandRing)
+		return app->commandRing;
+
+	auto ring = new CommandRing();
+	ring->capacity = std::max<uint64_t>(256, (capacity + 63) & ~63u);
+	ring->data = new uint8_t[ring->capacity];
+	ring->writePos = 0;
+	ring->readPos = 0;
+
+	app->commandRing = ring;
+
+	return ring;
+}
+
+static uint32_t CommandPayloadSize(CommandType type)
+{
+	switch (type) {
+	case CommandType::SetTransform:
+		return sizeof(Matrix4x4);
+	case CommandType::UpdateLight:
+		return sizeof(LightInfo);
+	case CommandType::UpdateMaterial:
+		return sizeof(::MaterialInfo);
+	default:
+		return 0;
+	}
+}
+
+// A command that won't run still owns the autoFree maps of its UpdateMaterial payload, if all of it is there
+static void DropCommand(const CommandHeader* cmd, uint64_t available)
+{
+	if (cmd->type == CommandType::UpdateMaterial && available >= sizeof(CommandHeader) + sizeof(::MaterialInfo))
+		FreeMaterialTextures(*reinterpret_cast<const ::MaterialInfo*>(cmd + 1));
+}
+
+uint32_t ExecuteCommands(FilamentApp* app)
+{
+	auto ring = app->commandRing;
+	if (!ring)
+		return 0;
+
+	uint64_t read = ring->readPos.load(std::memory_order_relaxed);
+	const uint64_t write = ring->writePos.load(std::memory_order_acquire);
+
+	if (read == write)
+		return 0;
+
+	auto& tcm = app->engine->getTransformManager();
+	bool inTransaction = false;
+	uint32_t count = 0;
+	const uint64_t bytes = write - read;
+
+	while (read < write) {
+
+		const uint64_t offset = read % ring->capacity;
+		auto cmd = reinterpret_cast<const CommandHeader*>(ring->data + offset);
+
+		// A malformed size would stall or desync the ring, drop what's left: past this command
+		// nothing can be parsed, so only its own payload is freed
+		if (cmd->size < sizeof(CommandHeader) + CommandPayloadSize(cmd->type) || (cmd->size & 15) != 0 || cmd->size > write - read) {
+			DropCommand(cmd, std::min(write - read, ring->capacity - offset));
+			read = write;
+			break;
+		}
+
+		read += cmd->size;
+
+		// Consecutive transforms share one local transform transaction
+		if (inTransaction && cmd->type != CommandType::SetTransform && cmd->type != CommandType::Skip) {
+			tcm.commitLocalTransformTransaction();
+			inTransaction = false;
+		}
+
+		switch (cmd->type) {
+		case CommandType::Skip:
+			continue;
+		case CommandType::SetTransform:
+			if (auto obj = app->entities.get(cmd->handle)) {
+				if (!inTransaction) {
+					tcm.openLocalTransformTransaction();
+					inTransaction = true;
+				}
+				auto instance = tcm.getInstance(*obj);
+				if (instance)
+					tcm.setTransform(instance, MatFromArray(*reinterpret_cast<const Matrix4x4*>(cmd + 1)));
+			}
+			break;
+		case CommandType::SetVisible:
+			SetObjVisibleByHandle(app, cmd->handle, cmd->param != 0);
+			break;
+		case CommandType::SetParent:
+			SetObjParentByHandle(app, cmd->handle, cmd->param);
+			break;
+		case CommandType::SetMeshMaterial:
+			SetMeshMaterialByHandle(app, cmd->handle, cmd->param);
+			break;
+		case CommandType::UpdateLight:
+			UpdateLightByHandle(app, cmd->handle, *reinterpret_cast<const LightInfo*>(cmd + 1));
+			break;
+		case CommandType::UpdateMaterial:
+			UpdateMaterialByHandle(app, cmd->handle, *reinterpret_cast<const ::MaterialInfo*>(cmd + 1));
+			break;
+		}
+
+		count++;
+	}
+
+	if (inTransaction)
+		tcm.commitLocalTransformTransaction();
+
+	ring->readPos.store(read, std::memory_order_release);
+
+	app->frameCommands += count;
+	app->frameBytes += static_cast<uint32_t>(bytes);
+
+	return count;
+}
+
+void GetCommandStats(FilamentApp* app, CommandStats& stats, bool reset)
+{
+	stats = app->commandStats;
+	if (reset)
+		app->commandStats = {};
+}
+
 
 #ifdef _WINDOWS
 
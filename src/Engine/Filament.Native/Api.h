@@ -13,29 +13,65 @@ extern "C" {
 
 	EXPORT void APIENTRY Render(FilamentApp* app, const ::RenderTarget options[], uint32_t count, bool wait);
 
-	EXPORT void APIENTRY AddLight(FilamentApp* app, OBJID id, const LightInfo& info);
+	EXPORT OBJHANDLE APIENTRY AddLight(FilamentApp* app, OBJID id, const LightInfo& info);
 	
 	EXPORT void APIENTRY UpdateLight(FilamentApp* app, OBJID id, const LightInfo& info);
 
+	EXPORT void APIENTRY UpdateLightByHandle(FilamentApp* app, OBJHANDLE handle, const LightInfo& info);
+
 	EXPORT void APIENTRY AddImageLight(FilamentApp* app, const ImageLightInfo& info);
 
 	EXPORT void APIENTRY UpdateImageLight(FilamentApp* app, const ImageLightInfo& info);
 
-	EXPORT void APIENTRY AddGeometry(FilamentApp* app, OBJID id, const GeometryInfo& info);
+	EXPORT OBJHANDLE APIENTRY AddGeometry(FilamentApp* app, OBJID id, const GeometryInfo& info);
+
+	EXPORT OBJHANDLE APIENTRY AddMesh(FilamentApp* app, OBJID id, const MeshInfo& info);
+
+	EXPORT OBJHANDLE APIENTRY AddInstancedMesh(FilamentApp* app, OBJID id, const MeshInfo& info, uint32_t instanceCount);
+
+	EXPORT void APIENTRY SetInstanceTransforms(FilamentApp* app, OBJID id, const Matrix4x4 matrices[], uint32_t first, uint32_t count);
+
+	EXPORT void APIENTRY SetInstanceTransformsByHandle(FilamentApp* app, OBJHANDLE handle, const Matrix4x4 matrices[], uint32_t first, uint32_t count);
 
-	EXPORT void APIENTRY AddMesh(FilamentApp* app, OBJID id, const MeshInfo& info);
+	EXPORT void APIENTRY SetInstanceVisibility(FilamentApp* app, OBJID id, const uint8_t visible[], uint32_t first, uint32_t count);
 
-	EXPORT void APIENTRY AddGroup(FilamentApp* app, OBJID id);
+	EXPORT void APIENTRY SetInstanceVisibilityByHandle(FilamentApp* app, OBJHANDLE handle, const uint8_t visible[], uint32_t first, uint32_t count);
+
+	EXPORT uint32_t APIENTRY GetVisibleInstanceCount(FilamentApp* app, OBJID id);
+
+	EXPORT OBJHANDLE APIENTRY AddGroup(FilamentApp* app, OBJID id);
 
 	EXPORT void APIENTRY SetObjVisible(FilamentApp* app, const OBJID id, const bool visible);
 
+	EXPORT void APIENTRY SetObjVisibleByHandle(FilamentApp* app, OBJHANDLE handle, const bool visible);
+
 	EXPORT void APIENTRY SetObjTransform(FilamentApp* app, OBJID id, const Matrix4x4 matrix);
 
+	EXPORT void APIENTRY SetObjTransforms(FilamentApp* app, const OBJID ids[], const Matrix4x4 matrices[], uint32_t count);
+
+	EXPORT OBJHANDLE APIENTRY GetObjHandle(FilamentApp* app, OBJID id);
+
+	EXPORT void APIENTRY SetObjTransformsByHandle(FilamentApp* app, const OBJHANDLE handles[], const Matrix4x4 matrices[], uint32_t count);
+
 	EXPORT void APIENTRY SetObjParent(FilamentApp* app, OBJID id, OBJID parentId);
 
-	EXPORT void APIENTRY AddMaterial(FilamentApp* app, OBJID id, const ::MaterialInfo& info) noexcept(false);
+	EXPORT void APIENTRY SetObjParentByHandle(FilamentApp* app, OBJHANDLE handle, OBJHANDLE parentHandle);
+
+	EXPORT OBJHANDLE APIENTRY AddMaterial(FilamentApp* app, OBJID id, const ::MaterialInfo& info) noexcept(false);
+
+	EXPORT MaterialUpdateStats APIENTRY UpdateMaterial(FilamentApp* app, OBJID id, const ::MaterialInfo& info);
+
+	EXPORT void APIENTRY GetMaterialUpdateStats(FilamentApp* app, MaterialUpdateStats& stats, bool reset);
+
+	EXPORT void APIENTRY SetTextureStreaming(FilamentApp* app, const TextureStreamingOptions& options);
+
+	EXPORT void APIENTRY GetTextureStreamingStats(FilamentApp* app, TextureStreamingStats& stats);
+
+	EXPORT OBJHANDLE APIENTRY AddMaterialAsync(FilamentApp* app, OBJID id, const ::MaterialInfo& info) noexcept(false);
 
-	EXPORT void APIENTRY UpdateMaterial(FilamentApp* app, OBJID id, const ::MaterialInfo& info);
+	EXPORT uint32_t APIENTRY PrewarmMaterials(FilamentApp* app, const ::MaterialInfo infos[], uint32_t count);
+
+	EXPORT uint32_t APIENTRY GetMaterialTimings(FilamentApp* app, MaterialTiming timings[], uint32_t capacity);
 
 	EXPORT bool APIENTRY GetGraphicContext(FilamentApp* app, GraphicContextInfo& info);
 
@@ -45,7 +81,37 @@ extern "C" {
 
 	EXPORT void APIENTRY SetMeshMaterial(FilamentApp* app, const OBJID id, const OBJID matId);
 
+	EXPORT void APIENTRY SetMeshMaterialByHandle(FilamentApp* app, OBJHANDLE handle, OBJHANDLE matHandle);
+
 	EXPORT void APIENTRY UpdateMeshGeometry(FilamentApp* app, OBJID meshId, OBJID geometryId, const GeometryInfo& info);
 
+	EXPORT OBJHANDLE APIENTRY AddDynamicGeometry(FilamentApp* app, OBJID id, const GeometryInfo& info, const DynamicGeometryOptions& options);
+
+	EXPORT void APIENTRY UpdateGeometryRange(FilamentApp* app, OBJID geometryId, const GeometryUpdate& update);
+
+	EXPORT void APIENTRY WaitGeometryJobs(FilamentApp* app);
+
 	EXPORT uint8_t* APIENTRY Allocate(size_t size);
+
+	EXPORT uint64_t APIENTRY TrimUploadPool(uint64_t targetBytes);
+
+	EXPORT void APIENTRY SetUploadPoolLimit(uint64_t bytes);
+
+	EXPORT void APIENTRY GetUploadPoolStats(UploadPoolStats& stats);
+
+	EXPORT bool APIENTRY GetFrameStats(FilamentApp* app, FrameStats& stats);
+
+	EXPORT void APIENTRY SetFramesInFlight(FilamentApp* app, uint32_t count);
+
+	EXPORT uint64_t APIENTRY GetCompletedFrame(FilamentApp* app);
+
+	EXPORT bool APIENTRY WaitFrame(FilamentApp* app, uint64_t frameIndex);
+
+	EXPORT uint32_t APIENTRY GetFrameStatsHistory(FilamentApp* app, FrameStats stats[], uint32_t capacity);
+
+	EXPORT CommandRing* APIENTRY CreateCommandRing(FilamentApp* app, uint32_t capacity);
+
+	EXPORT uint32_t APIENTRY ExecuteCommands(FilamentApp* app);
+
+	EXPORT void APIENTRY GetCommandStats(FilamentApp* app, CommandStats& stats, bool reset);
 }
\ No newline at end of file
@@ -5,6 +5,7 @@ typedef float Matrix4x4[16];
 
 typedef int32_t RTID;
 typedef uint32_t VIEWID;
+typedef uint32_t OBJHANDLE;
 typedef std::bitset<128> OBJID;
 
 template <>
@@ -13,6 +14,210 @@ struct std::less<OBJID>
 	bool operator()(const OBJID& a, const OBJID& b) const { return (memcmp(&a, &b, 16) < 0); }
 };
 
+// Handles are the slot index in the low 24 bits and the slot generation in the high 8 bits.
+// Generations start at 1, so 0 is never a valid handle; a removed slot bumps its generation
+// and stale handles stop resolving
+#define HANDLE_INDEX_BITS 24
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define NULL_HANDLE 0
+
+// Marks an erased ObjIdMap bucket, probing continues past it. It would be the last slot index at
+// generation 0xFF, so HandleTable never hands out that index
+#define OBJIDMAP_TOMBSTONE 0xFFFFFFFFu
+
+template <typename T>
+struct HandleTable {
+
+	struct Slot {
+		T item;
+		uint8_t generation;
+		bool live;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+
+	OBJHANDLE add(const T& item) {
+		uint32_t index;
+		if (!freeSlots.empty()) {
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			index = (uint32_t)slots.size();
+			if (index >= HANDLE_INDEX_MASK)
+				throw "Handle table full";
+			slots.push_back({ {}, 1, false });
+		}
+		auto& slot = slots[index];
+		slot.item = item;
+		slot.live = true;
+		return ((uint32_t)slot.generation << HANDLE_INDEX_BITS) | index;
+	}
+
+	T* get(OBJHANDLE handle) {
+		const uint32_t index = handle & HANDLE_INDEX_MASK;
+		if (index >= slots.size())
+			return nullptr;
+		auto& slot = slots[index];
+		if (!slot.live || slot.generation != (handle >> HANDLE_INDEX_BITS))
+			return nullptr;
+		return &slot.item;
+	}
+
+	bool remove(OBJHANDLE handle) {
+		if (!get(handle))
+			return false;
+		const uint32_t index = handle & HANDLE_INDEX_MASK;
+		auto& slot = slots[index];
+		slot.item = {};
+		slot.live = false;
+		slot.generation = slot.generation == 0xFF ? 1 : slot.generation + 1;
+		freeSlots.push_back(index);
+		return true;
+	}
+};
+
+// Open addressing (linear probing) OBJID -> handle map, backs the GUID keyed API
+struct ObjIdMap {
+
+	struct Bucket {
+		OBJID id;
+		OBJHANDLE handle;
+	};
+
+	std::vector<Bucket> buckets;
+	size_t count = 0;
+	size_t used = 0;
+
+	static size_t hash(const OBJID& id) {
+		uint64_t parts[2];
+		memcpy(parts, &id, sizeof(parts));
+		uint64_t h = parts[0] ^ (parts[1] * 0x9E3779B97F4A7C15ull);
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		return (size_t)h;
+	}
+
+	static bool equals(const OBJID& a, const OBJID& b) {
+		return memcmp(&a, &b, sizeof(OBJID)) == 0;
+	}
+
+	OBJHANDLE find(const OBJID& id) const {
+		if (count == 0)
+			return NULL_HANDLE;
+		const size_t mask = buckets.size() - 1;
+		for (size_t i = hash(id) & mask; ; i = (i + 1) & mask) {
+			auto& bucket = buckets[i];
+			if (bucket.handle == NULL_HANDLE)
+				return NULL_HANDLE;
+			if (bucket.handle != OBJIDMAP_TOMBSTONE && equals(bucket.id, id))
+				return bucket.handle;
+		}
+	}
+
+	void set(const OBJID& id, OBJHANDLE handle) {
+		// Both mark bucket states, stored as handles they would hide the entry or end probes early
+		if (handle == NULL_HANDLE || handle == OBJIDMAP_TOMBSTONE)
+			throw "Invalid handle";
+
+		// Keep the load (tombstones included) under 3/4 so probes stay short and always terminate
+		if ((used + 1) * 4 > buckets.size() * 3)
+			rehash(std::max<size_t>(16, count * 4 >= buckets.size() ? buckets.size() * 2 : buckets.size()));
+
+		const size_t mask = buckets.size() - 1;
+		Bucket* target = nullptr;
+		for (size_t i = hash(id) & mask; ; i = (i + 1) & mask) {
+			auto& bucket = buckets[i];
+			if (bucket.handle == NULL_HANDLE) {
+				if (!target) {
+					target = &bucket;
+					used++;
+				}
+				break;
+			}
+			if (bucket.handle == OBJIDMAP_TOMBSTONE) {
+				if (!target)
+					target = &bucket;
+				continue;
+			}
+			if (equals(bucket.id, id)) {
+				bucket.handle = handle;
+				return;
+			}
+		}
+		target->id = id;
+		target->handle = handle;
+		count++;
+	}
+
+	void erase(const OBJID& id) {
+		if (count == 0)
+			return;
+		const size_t mask = buckets.size() - 1;
+		for (size_t i = hash(id) & mask; ; i = (i + 1) & mask) {
+			auto& bucket = buckets[i];
+			if (bucket.handle == NULL_HANDLE)
+				return;
+			if (bucket.handle != OBJIDMAP_TOMBSTONE && equals(bucket.id, id)) {
+				bucket.handle = OBJIDMAP_TOMBSTONE;
+				count--;
+				return;
+			}
+		}
+	}
+
+	void rehash(size_t size) {
+		std::vector<Bucket> old;
+		old.swap(buckets);
+		buckets.resize(size);
+		count = 0;
+		used = 0;
+		for (auto& bucket : old) {
+			if (bucket.handle != NULL_HANDLE && bucket.handle != OBJIDMAP_TOMBSTONE)
+				set(bucket.id, bucket.handle);
+		}
+	}
+};
+
+// Slot storage addressed by handle, plus the OBJID index for the GUID keyed API
+template <typename T>
+struct ObjTable {
+	HandleTable<T> slots;
+	ObjIdMap ids;
+
+	// Assigning an existing id replaces the item in place and keeps its handle
+	OBJHANDLE set(const OBJID& id, const T& item) {
+		auto handle = ids.find(id);
+		if (auto cur = slots.get(handle)) {
+			*cur = item;
+			return handle;
+		}
+		handle = slots.add(item);
+		ids.set(id, handle);
+		return handle;
+	}
+
+	OBJHANDLE handle(const OBJID& id) const {
+		return ids.find(id);
+	}
+
+	T* get(OBJHANDLE handle) {
+		return slots.get(handle);
+	}
+
+	T* find(const OBJID& id) {
+		return slots.get(ids.find(id));
+	}
+
+	bool remove(const OBJID& id) {
+		auto handle = ids.find(id);
+		ids.erase(id);
+		return slots.remove(handle);
+	}
+};
+
 enum class ReleaseContextMode {
 	NotRelease = 0,
 	ReleaseOnExecute = 1,
@@ -43,6 +248,48 @@ enum class VertexAttributeType {
 	UV1
 };
 
+// Storage of a vertex attribute in GeometryInfo.vertices, Default is the float type implied by the attribute.
+// Normal and Tangent are always float, they only feed the orientation quaternions
+enum class VertexFormat : uint32_t {
+	Default = 0,
+	Float2,
+	Float3,
+	Float4,
+	Half2,
+	Half4,
+	UByte4Norm,
+	Short2Norm,
+	Short4Norm,
+	UShort2Norm
+};
+
+enum class IndexFormat : uint8_t {
+	UInt = 0,
+	UShort = 1
+};
+
+// Opt-in conversions AddGeometry applies to float sources before the upload
+enum GeometryQuantize : uint32_t {
+	// 16 bit indices when there are less than 65536 vertices
+	QUANTIZE_INDICES = 1,
+	// UV0 / UV1 as HALF2
+	QUANTIZE_UV = 2,
+	// Color as normalized UBYTE4
+	QUANTIZE_COLOR = 4
+};
+
+// Who owns the vertex / index memory passed to AddGeometry
+enum class GeometryUpload : uint32_t {
+	// Copied before the call returns, the caller keeps its buffers
+	Copy = 0,
+	// Caller memory (e.g. pinned) read in place by the upload, release is called for each buffer once consumed
+	Borrowed = 1,
+	// Memory from Allocate, freed by the native side once consumed
+	Owned = 2
+};
+
+typedef void (APIENTRY* ReleaseBufferFunc)(void* buffer, void* user);
+
 struct Color3 {
 	float r;
 	float g;
@@ -86,12 +333,35 @@ struct InitializeOptions {
 };
 
 
+struct DynamicGeometry;
+
 struct Geometry {
 	VertexBuffer* vb;
 	IndexBuffer* ib;
 	short4* soBuffer;
 	Box box;
 	PrimitiveType primitive;
+	uint32_t indexCount;
+	// ib is the app wide sequential buffer (non indexed geometry), not owned
+	bool sharedIb;
+	// Set for geometry updated in place, vb / ib are then its current slot
+	DynamicGeometry* dynamic;
+	uint32_t updateCount;
+};
+
+// One renderable drawing capacity instances of a geometry. Visible instances are packed at the front
+// of the instance buffer, the hidden tail is collapsed to a zero matrix
+struct InstancedMesh {
+	Entity entity;
+	InstanceBuffer* buffer;
+	Box geometryBox;
+	uint32_t capacity;
+	std::vector<mat4f> transforms;
+	std::vector<uint8_t> visible;
+	std::vector<mat4f> packed;
+	uint32_t visibleCount;
+	// Packed and uploaded once per frame, whatever the number of updates
+	bool dirty;
 };
 
 struct LightInfo {
@@ -176,6 +446,7 @@ struct VertexAttribute {
 	VertexAttributeType type;
 	uint32_t offset;
 	uint32_t size;
+	VertexFormat format;
 };
 
 struct VertexLayout {
@@ -193,6 +464,93 @@ struct GeometryInfo {
 	VertexLayout layout;
 	Bounds3 bounds;
 	PrimitiveType primitive;
+	GeometryUpload upload;
+	ReleaseBufferFunc release;
+	void* verticesUser;
+	void* indicesUser;
+	uint32_t quantize;
+	IndexFormat indexFormat;
+};
+
+struct DynamicGeometryOptions {
+	uint32_t vertexCapacity;
+	uint32_t indexCapacity;
+	// GPU copies rotated on each update (frames in flight), 2 or 3
+	uint32_t bufferCount;
+};
+
+// Partial update of a dynamic geometry; vertices / indices are copied before the call returns
+struct GeometryUpdate {
+	const uint8_t* vertices;
+	uint32_t vertexOffset;
+	uint32_t vertexCount;
+	const uint32_t* indices;
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	// Vertices / indices drawn after the update, indices 0 for non indexed geometry
+	uint32_t totalVertices;
+	uint32_t totalIndices;
+	Bounds3 bounds;
+};
+
+#define GEOMETRY_MAX_BUFFERS 3
+
+struct DynamicGeometrySlot {
+	VertexBuffer* vb;
+	IndexBuffer* ib;
+	// Upload sources, only written when the driver is done with them (pending == 0)
+	uint8_t* vertices;
+	uint32_t* indices;
+	short4* quats;
+	std::atomic<uint32_t> pending;
+	// Ranges changed since the slot was last uploaded, [begin, end) in vertices / indices
+	uint32_t dirtyVertexBegin;
+	uint32_t dirtyVertexEnd;
+	uint32_t dirtyIndexBegin;
+	uint32_t dirtyIndexEnd;
+};
+
+// Preallocated buffers rotated on each update, grown only when the capacity is exceeded.
+// The current slot always holds the full content, the next one catches up from it
+struct DynamicGeometry {
+	std::vector<::VertexAttribute> attributes;
+	uint32_t stride;
+	PrimitiveType primitive;
+	// 32 bit indices, otherwise the slots share the sequential index buffer
+	bool indexed;
+	bool hasOrientation;
+	// 0..vertexCapacity triangle list of the orientation when not indexed
+	std::vector<uint32_t> sequential;
+	uint32_t vertexCapacity;
+	uint32_t indexCapacity;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t bufferCount;
+	uint32_t current;
+	std::vector<Entity> meshes;
+	DynamicGeometrySlot slots[GEOMETRY_MAX_BUFFERS];
+};
+
+// Inputs of the tangent frame generation, copied so the source can be released while the job runs
+struct OrientationVertex {
+	float3 position;
+	float3 normal;
+	float2 uv;
+};
+
+// Tangent frame computed off thread, uploaded over the placeholder by Render once done
+struct OrientationTask {
+	// Reset when the geometry goes away before the job is done
+	VertexBuffer* vb;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	OrientationVertex* vertices;
+	uint32_t* indices;
+	short4* quats;
+	// Empty without materialCachePath
+	std::string cacheFile;
+	JobSystem::Job* job;
+	std::atomic<bool> done;
 };
 
 struct ImageData {
@@ -202,6 +560,78 @@ struct ImageData {
 	uint32_t dataSize;
 	bool autoFree;
 	bool isBgr;
+	// Content version, data matching the texture's version isn't uploaded again; 0 always uploads
+	uint64_t version;
+};
+
+#define TEXTURE_MAX_LEVELS 16
+
+// Material parameter a streamed texture is bound to, set again each time the texture is recreated
+struct StreamingBinding {
+	MaterialInstance* instance;
+	const char* name;
+};
+
+// CPU mip chain of a streamed texture, the GPU texture holds only levels [residentLevel, levelCount)
+struct StreamingTexture {
+	OBJID id;
+	uint32_t width;
+	uint32_t height;
+	Texture::InternalFormat internalFormat;
+	Texture::Format format;
+	uint32_t pixelSize;
+	bool srgb;
+	uint32_t levelCount;
+	// Level 0 is the source data, the others are built by job; all freed once resident for good
+	uint8_t* levels[TEXTURE_MAX_LEVELS];
+	uint32_t residentLevel;
+	uint32_t wantedLevel;
+	uint64_t residentBytes;
+	uint64_t lastSeenFrame;
+	// The chain changed under the resident levels, they're uploaded again
+	bool dirty;
+	JobSystem::Job* job;
+	std::atomic<bool> built;
+	std::vector<StreamingBinding> bindings;
+};
+
+struct TextureEntry {
+	Texture* texture;
+	uint64_t version;
+	StreamingTexture* streaming;
+};
+
+// Byte textures with mips start from their small levels and are refined toward level 0 over the frames
+struct TextureStreamingOptions {
+	bool enabled;
+	// Bytes uploaded per frame by refinements, at least one is done; 0 is unlimited
+	uint32_t frameBudget;
+	// Resident bytes of all the streamed textures, over it the top level of the least needed ones is dropped; 0 is unlimited
+	uint64_t memoryBudget;
+	// Largest size of the preview uploaded on creation
+	uint32_t initialSize;
+	// Frames without being on screen after which a texture is trimmed first
+	uint32_t evictFrames;
+	// Frames between two estimations of the renderables' screen size; 0 keeps every texture wanted at level 0
+	uint32_t usageInterval;
+};
+
+struct TextureStreamingStats {
+	uint32_t textures;
+	uint32_t building;
+	uint64_t residentBytes;
+	// CPU copies of the chains, kept until they are resident at level 0
+	uint64_t cpuBytes;
+	uint64_t uploadedBytes;
+	uint64_t lastFrameBytes;
+	uint32_t refinements;
+	uint32_t evictions;
+};
+
+struct MaterialUpdateStats {
+	uint64_t bytesUploaded;
+	uint32_t parametersChanged;
+	uint32_t texturesUploaded;
 };
 
 struct TextureInfo {
@@ -254,6 +684,96 @@ struct MaterialInfo {
 	float lineWidth;
 };
 
+typedef uint64_t MATKEY;
+
+enum class MaterialState : uint32_t {
+	Pending,
+	// Package ready, the Material is created on the app thread
+	Built,
+	Ready,
+	Failed
+};
+
+enum class MaterialSource : uint32_t {
+	Compiled,
+	Cache
+};
+
+struct MaterialVariant {
+	MATKEY key;
+	Material* material;
+	// Written by the build job, consumed once state is Built; points in the archive mapping or in ownedPackage
+	const uint8_t* package;
+	size_t packageSize;
+	uint8_t* ownedPackage;
+	MaterialSource source;
+	float milliseconds;
+	JobSystem::Job* job;
+	std::atomic<uint32_t> state;
+	// Only flags and map presence are read, texture data isn't valid past AddMaterial
+	::MaterialInfo info;
+};
+
+#define MAT_ARCHIVE_MAGIC 0x4B504D46
+#define MAT_RECORD_MAGIC 0x4345524D
+#define MAT_ARCHIVE_FORMAT 1
+
+struct MaterialArchiveHeader {
+	uint32_t magic;
+	uint32_t format;
+	uint64_t reserved;
+};
+
+// Followed by size bytes of package, padded to 8
+struct MaterialRecord {
+	uint32_t magic;
+	uint32_t reserved;
+	MATKEY key;
+	// MAT_VERSION the package was built with
+	char version[16];
+	uint64_t size;
+	uint64_t checksum;
+};
+
+struct MaterialArchiveEntry {
+	const uint8_t* data;
+	uint64_t size;
+};
+
+// Append only package log, mapped once at startup; records of other versions are dropped by compaction
+struct MaterialArchive {
+	std::string path;
+	const uint8_t* mapping;
+	size_t mappedSize;
+#ifdef _WINDOWS
+	HANDLE file;
+	HANDLE mapHandle;
+#endif
+	// Current version records in the mapping, the last one of a key wins
+	std::unordered_map<MATKEY, MaterialArchiveEntry> index;
+	// End of the last valid record, appends start there
+	uint64_t end;
+	std::mutex appendLock;
+};
+
+// Instance rendered with the default material until its variant is ready
+struct PendingMaterial {
+	OBJID id;
+	OBJHANDLE handle;
+	MaterialVariant* variant;
+	MaterialInstance* fallback;
+	// Textures already uploaded, data sizes cleared
+	::MaterialInfo info;
+	std::vector<Entity> meshes;
+};
+
+struct MaterialTiming {
+	MATKEY key;
+	float milliseconds;
+	MaterialSource source;
+	MaterialState state;
+};
+
 struct GraphicContextInfo {
 	struct 
 	{
@@ -271,6 +791,176 @@ struct GraphicContextInfo {
 	} vulkan;
 };
 
+enum class CommandType : uint32_t {
+	// Padding up to the end of the ring, the next command starts at offset 0
+	Skip = 0,
+	// payload: Matrix4x4
+	SetTransform = 1,
+	// param: visible
+	SetVisible = 2,
+	// param: parent handle
+	SetParent = 3,
+	// param: material handle
+	SetMeshMaterial = 4,
+	// payload: LightInfo
+	UpdateLight = 5,
+	// payload: MaterialInfo
+	UpdateMaterial = 6
+};
+
+// Commands are 16 bytes aligned (the header size), so a tail too short for a header never happens;
+// size includes the header and the payload that follows it
+struct CommandHeader {
+	CommandType type;
+	uint32_t size;
+	OBJHANDLE handle;
+	uint32_t param;
+};
+
+// Single producer (managed side) / single consumer (ExecuteCommands) ring.
+// Positions only grow, the offset in data is position % capacity; a command never wraps,
+// the producer pads the tail with a Skip command instead
+struct CommandRing {
+	uint8_t* data;
+	uint64_t capacity;
+	alignas(64) std::atomic<uint64_t> writePos;
+	alignas(64) std::atomic<uint64_t> readPos;
+};
+
+struct CommandStats {
+	uint64_t frames;
+	uint64_t totalCommands;
+	uint64_t totalBytes;
+	uint32_t lastCommands;
+	uint32_t lastBytes;
+	uint32_t maxCommands;
+	uint32_t maxBytes;
+};
+
+// Size classes of the upload pool: 256 bytes, then 4 per power of two up to UPLOAD_POOL_MAX_BLOCK
+#define UPLOAD_POOL_CLASSES 65
+#define UPLOAD_POOL_MAX_BLOCK (16u << 20)
+#define UPLOAD_POOL_DEFAULT_LIMIT (64ull << 20)
+
+// What staging memory is uploaded as, from the user pointer given to the BufferDescriptor
+enum class UploadTag : uint32_t {
+	Other,
+	VB,
+	IB,
+	TEX,
+	QUAD,
+	Count
+};
+
+struct UploadTagStats {
+	uint64_t allocations;
+	uint64_t liveBytes;
+	uint64_t peakBytes;
+	uint64_t totalBytes;
+};
+
+struct UploadPoolStats {
+	UploadTagStats tags[(uint32_t)UploadTag::Count];
+	uint64_t retainedBytes;
+	uint64_t retainedLimit;
+	uint64_t poolHits;
+	uint64_t heapAllocations;
+};
+
+struct UploadThreadCache;
+
+// Header in front of each staging allocation, keeps the data 16 bytes aligned
+struct alignas(16) UploadBlock {
+	UploadThreadCache* owner;
+	uint64_t size;
+	uint32_t sizeClass;
+	UploadTag tag;
+	UploadBlock* next;
+};
+
+// Free lists are touched only by their thread, other threads (the driver) push back to remote
+struct UploadThreadCache {
+	UploadBlock* freeLists[UPLOAD_POOL_CLASSES];
+	std::atomic<UploadBlock*> remote;
+	// Set under the pool lock when the thread exits, the next new thread adopts the cache and its blocks
+	bool orphaned;
+};
+
+struct UploadTagCounters {
+	std::atomic<uint64_t> allocations;
+	std::atomic<int64_t> liveBytes;
+	std::atomic<int64_t> peakBytes;
+	std::atomic<uint64_t> totalBytes;
+};
+
+struct UploadPool {
+	std::mutex lock;
+	std::vector<UploadThreadCache*> threads;
+	std::atomic<uint64_t> retainedBytes;
+	std::atomic<uint64_t> retainedLimit{ UPLOAD_POOL_DEFAULT_LIMIT };
+	std::atomic<uint64_t> poolHits;
+	std::atomic<uint64_t> heapAllocations;
+	UploadTagCounters tags[(uint32_t)UploadTag::Count];
+};
+
+#define FRAME_STATS_HISTORY 64
+#define FRAME_STATS_MAX_VIEWS 4
+
+enum class FrameFlags : uint32_t {
+	None = 0,
+	// beginFrame asked to skip the frame, nothing was rendered
+	Dropped = 1,
+	NoMainView = 2,
+	// Ended with flushAndWait
+	Waited = 4,
+	// Blocked before beginFrame on the oldest frame in flight
+	Throttled = 8
+};
+
+// CPU times in milliseconds, byte counters are the ones of this frame only
+struct FrameStats {
+	uint64_t frameIndex;
+	uint32_t flags;
+	uint32_t viewsRendered;
+	float totalTime;
+	// Commands, pending jobs, instances and texture streaming before beginFrame
+	float prepareTime;
+	float beginFrameTime;
+	float renderTime;
+	float viewTimes[FRAME_STATS_MAX_VIEWS];
+	float endFrameTime;
+	float flushTime;
+	uint64_t uploadBytes[(uint32_t)UploadTag::Count];
+	uint64_t streamingBytes;
+	uint32_t commands;
+	uint32_t commandBytes;
+	uint32_t renderables;
+	uint32_t lights;
+	uint32_t entities;
+	// Renderer::FrameInfo of an earlier frame (GPU timings lag a few frames), 0 when not available
+	uint32_t gpuFrameId;
+	float gpuTime;
+	float gpuTimeDenoised;
+	float throttleTime;
+};
+
+// Signaled once the GPU is done with every command of the frame
+struct FrameFence {
+	uint64_t frameIndex;
+	Fence* fence;
+};
+
+// Written by the render thread only; a slot is read consistently when its sequence is even and unchanged across the copy
+struct FrameStatsRing {
+	struct Slot {
+		std::atomic<uint64_t> sequence;
+		FrameStats stats;
+	};
+	Slot slots[FRAME_STATS_HISTORY];
+	std::atomic<uint64_t> count;
+	uint64_t uploadTotals[(uint32_t)UploadTag::Count];
+};
+
 
 struct FilamentApp {
 	Engine* engine;
@@ -280,12 +970,31 @@ struct FilamentApp {
 	Camera* camera;
 	std::vector<RenderView> views;
 	std::vector<filament::RenderTarget*> renderTargets;
-	std::map<OBJID, Texture*> textures;	
-	std::map<OBJID, Entity> entities;
-	std::map<OBJID, Geometry> geometries;
-	std::map<OBJID, MaterialInstance*> materialsInst;
-	std::map<std::string, Material*> materials;
+	ObjTable<TextureEntry> textures;
+	ObjTable<Entity> entities;
+	ObjTable<Geometry> geometries;
+	ObjTable<MaterialInstance*> materialsInst;
+	std::unordered_map<MATKEY, MaterialVariant*> materials;
+	MaterialArchive* materialArchive;
+	// Last info set on each instance, updates only touch what differs
+	std::unordered_map<MaterialInstance*, ::MaterialInfo> appliedMaterials;
+	MaterialUpdateStats materialUpdateStats;
+	TextureStreamingOptions textureStreaming;
+	TextureStreamingStats streamingStats;
+	std::vector<StreamingTexture*> streamingTextures;
+	uint64_t frameIndex;
+	FrameStatsRing frameStats;
+	// 0 keeps Render(wait) blocking on flushAndWait, otherwise frames submitted ahead of the GPU
+	uint32_t framesInFlight;
+	// Oldest first
+	std::vector<FrameFence> frameFences;
+	uint64_t completedFrame;
+	std::vector<PendingMaterial> pendingMaterials;
 	std::string materialCachePath;
+	// 0..n index buffers shared by non indexed geometry, last is the largest; older ones stay alive for the renderables using them
+	std::vector<IndexBuffer*> sequentialIndices;
+	std::vector<OrientationTask*> orientationTasks;
+	std::unordered_map<OBJHANDLE, InstancedMesh*> instancedMeshes;
 	Texture* iblSpecTexture;
 	Texture* iblIrrTexture;
 	Texture* skyboxTexture;
@@ -294,4 +1003,9 @@ struct FilamentApp {
 
 	bool isStereo;
 	bool oneViewPerTarget;
+
+	CommandRing* commandRing;
+	CommandStats commandStats;
+	uint32_t frameCommands;
+	uint32_t frameBytes;
 };
@@ -17,6 +17,11 @@
 	#include <backend/platforms/PlatformWGL.h>
 #else
 
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+
 int fopen_s(FILE** _Stream, char const* _FileName, char const* _Mode) {
 	
 	*_Stream = fopen(_FileName, _Mode);
@@ -36,8 +41,15 @@ int fopen_s(FILE** _Stream, char const* _FileName, char const* _Mode) {
 
 #include <filesystem>
 #include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
+#include <limits>
+#include <atomic>
+#include <mutex>
 
 #include <filament/Engine.h>
+#include <filament/Fence.h>
 #include <filament/Texture.h>
 #include <filament/Scene.h>
 #include <filament/RenderTarget.h>
@@ -52,6 +64,7 @@ int fopen_s(FILE** _Stream, char const* _FileName, char const* _Mode) {
 #include <filament/IndexBuffer.h>
 #include <filament/VertexBuffer.h>
 #include <filament/BufferObject.h>
+#include <filament/InstanceBuffer.h>
 #include <filament/Material.h>
 #include <filament/TextureSampler.h>
 #include <filament/Viewport.h>
@@ -62,6 +75,10 @@ int fopen_s(FILE** _Stream, char const* _FileName, char const* _Mode) {
 #include <geometry/SurfaceOrientation.h>
 #include <geometry/TangentSpaceMesh.h>
 
+#include <utils/JobSystem.h>
+
+#include <math/half.h>
+
 #include <utils/EntityManager.h>
 #include <utils/Log.h>
 
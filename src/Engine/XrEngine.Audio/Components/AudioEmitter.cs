@@ -180,6 +180,8 @@ namespace XrEngine.Audio
 
             _curSource = source;
 
+            using var timer = new PrecisionTimer(Math.Max(1000, (ulong)(PoolSleepMs * 1000000)));
+
             while (stream.IsStreaming && !control.IsStopped)
             {
                 while (source.BuffersProcessed > 0)
@@ -200,7 +202,7 @@ namespace XrEngine.Audio
                 if (source.State == SourceState.Stopped)
                     source.Play();
 
-                EngineNativeLib.SleepFor((ulong)(PoolSleepMs * 1000000));
+                timer.WaitNext();
             }
 
             _activeStreams.Remove(stream);
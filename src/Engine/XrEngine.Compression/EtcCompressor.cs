@@ -64,7 +64,9 @@ namespace XrEngine.Compression
 
             if (!data.Format.IsBgr())
             {
-                EngineNativeLib.RgbToBgr(data.Width, data.Height, pData, pData, data.Format.GetPixelSizeBit() / 8);
+                var format = (SwizzleFormat)(data.Format.GetPixelSizeBit() / 8);
+
+                EngineNativeLib.ImageSwizzle(pData, pData, data.Width, data.Height, 0, 0, format, format, SwizzleMask.SwapRB);
 
                 if (data.Format == TextureFormat.Rgba32)
                     data.Format = TextureFormat.Bgra32;
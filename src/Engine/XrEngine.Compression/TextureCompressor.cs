@@ -95,7 +95,7 @@ namespace XrEngine.Compression
 
         public static string TextureHash(TextureData data, TextureCompressionInfo compressor)
         {
-            return Convert.ToHexString(MD5.HashData(data.Data!.AsSpan())) + "_" + compressor.Format + "_" + compressor.BlockSize + "_v6";
+            return Convert.ToHexString(MD5.HashData(data.Data!.AsSpan())) + "_" + compressor.Format + "_" + compressor.BlockSize + "_v7";
         }
 
         public void ClearCache()
@@ -136,18 +136,13 @@ namespace XrEngine.Compression
             {
                 result = new List<TextureData>();
 
-                var level = 0;
+                var levels = ImageUtils.BuildMipChain(data, (uint)mipsLevels + 1);
 
-                var lastData = data;
-
-                while (true)
+                foreach (var resizeData in levels)
                 {
-                    var width = (int)MathF.Max(1, data.Width >> level);
-                    var height = (int)MathF.Max(1, data.Height >> level);
-
-                    var resizeData = ImageUtils.ResizeV2(lastData, width, height);
+                    var level = (int)resizeData.MipLevel;
 
-                    Log.Info(this, "Compressing mip {0} mipsLevels width {1} height {2}", level, width, height);
+                    Log.Info(this, "Compressing mip {0} mipsLevels width {1} height {2}", level, resizeData.Width, resizeData.Height);
 
                     var packData = ImageUtils.Pack(resizeData, compressor.Align);
 
@@ -157,14 +152,10 @@ namespace XrEngine.Compression
                     newData.Width = resizeData.Width;
                     newData.Height = resizeData.Height;
 
-                    lastData = resizeData;
-
                     result.Add(newData);
 
                     if (level >= mipsLevels || newData.Width <= 4 || newData.Height <= 4)
                         break;
-
-                    level++;
                 }
 
                 if (cacheFile != null)
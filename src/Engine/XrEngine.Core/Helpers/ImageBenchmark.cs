@@ -0,0 +1,85 @@
+﻿using Common.Interop;
+using SkiaSharp;
+using System.Diagnostics;
+
+namespace XrEngine
+{
+    /// <summary>
+    /// Compares the native resize paths on a 4K texture, byte filtering against linear-light (sRGB) filtering,
+    /// and the native blur against the Skia one
+    /// </summary>
+    public class ImageBenchmark
+    {
+        public void Bench()
+        {
+            const uint srcSize = 4096;
+            const uint dstSize = 2048;
+
+            var src = MemoryBuffer.Create<byte>(srcSize * srcSize * 4);
+            var dst = MemoryBuffer.Create<byte>(dstSize * dstSize * 4);
+
+            Random.Shared.NextBytes(src.AsSpan());
+
+            using var pSrc = src.MemoryLock();
+            using var pDst = dst.MemoryLock();
+
+            nint srcPtr = pSrc;
+            nint dstPtr = pDst;
+
+            Bench(srcSize * srcSize * 4, 20,
+                () => Resize(srcPtr, srcSize, dstPtr, dstSize, false),
+                () => Resize(srcPtr, srcSize, dstPtr, dstSize, true),
+                () => Resize(dstPtr, dstSize, srcPtr, srcSize, false),
+                () => Resize(dstPtr, dstSize, srcPtr, srcSize, true));
+        }
+
+        public unsafe void BenchBlur()
+        {
+            const int size = 2048;
+
+            using var bitmap = new SKBitmap(size, size, SKColorType.Rgba8888, SKAlphaType.Premul);
+
+            Random.Shared.NextBytes(new Span<byte>((void*)bitmap.GetPixels(), bitmap.ByteCount));
+
+            Bench(size * size * 4, 5,
+                () => ImageUtils.ApplyGaussianBlur(bitmap, 2).Dispose(),
+                () => ImageUtils.ApplyGaussianBlurSkia(bitmap, 2).Dispose(),
+                () => ImageUtils.ApplyGaussianBlur(bitmap, 10).Dispose(),
+                () => ImageUtils.ApplyGaussianBlurSkia(bitmap, 10).Dispose());
+        }
+
+        static unsafe void Resize(nint src, uint srcSize, nint dst, uint dstSize, bool srgb)
+        {
+            if (srgb)
+                EngineNativeLib.ImageResizeBilinearSrgbU8(srcSize, srcSize, (byte*)src, dstSize, dstSize, (byte*)dst, 4);
+            else
+                EngineNativeLib.ImageResizeBilinearU8(srcSize, srcSize, (byte*)src, dstSize, dstSize, (byte*)dst, 4);
+        }
+
+        public void Bench(long bytes, int iterations, params Action[] actions)
+        {
+            var task = 0;
+            foreach (var action in actions)
+            {
+                Log.Info(this, "Running Task: {0}", task);
+                Debug.WriteLine("Running Task: {0}", task);
+
+                action();
+
+                var time = Stopwatch.GetTimestamp();
+
+                for (var i = 0; i < iterations; i++)
+                    action();
+
+                var diff = Stopwatch.GetElapsedTime(time);
+
+                var ms = diff.TotalMilliseconds / iterations;
+                var mbs = bytes / (1024.0 * 1024.0) / diff.TotalSeconds * iterations;
+
+                Log.Info(this, "Task: {0}, {1} ms, {2} MB/s", task, ms, mbs);
+                Debug.WriteLine("Task: {0}, {1} ms, {2} MB/s", task, ms, mbs);
+                task++;
+            }
+        }
+    }
+}
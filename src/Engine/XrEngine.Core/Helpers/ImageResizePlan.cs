@@ -0,0 +1,78 @@
+﻿using Common.Interop;
+
+namespace XrEngine
+{
+    /// <summary>
+    /// Native bilinear resize with precomputed tables, to reuse when the same sizes are resized many times (video frames, thumbnails)
+    /// </summary>
+    public class ImageResizePlan : IDisposable
+    {
+        nint _handle;
+
+        public ImageResizePlan(uint srcWidth, uint srcHeight, uint dstWidth, uint dstHeight, uint channels, ResizeFlags flags = ResizeFlags.None)
+        {
+            _handle = EngineNativeLib.CreateResizePlan(srcWidth, srcHeight, dstWidth, dstHeight, channels, flags);
+            if (_handle == 0)
+                throw new ArgumentException("Invalid resize size");
+
+            SrcWidth = srcWidth;
+            SrcHeight = srcHeight;
+            DstWidth = dstWidth;
+            DstHeight = dstHeight;
+            Channels = channels;
+            Flags = flags;
+        }
+
+        ~ImageResizePlan()
+        {
+            Dispose();
+        }
+
+        public unsafe void Execute(byte* src, byte* dst)
+        {
+            ObjectDisposedException.ThrowIf(_handle == 0, this);
+
+            EngineNativeLib.ExecuteResizePlan(_handle, src, dst);
+        }
+
+        public unsafe TextureData Execute(TextureData data)
+        {
+            if (data.Width != SrcWidth || data.Height != SrcHeight)
+                throw new ArgumentException("Source size doesn't match the plan");
+
+            var result = data.Clone();
+            result.Data = MemoryBuffer.Create<byte>(DstWidth * DstHeight * Channels);
+            result.Width = DstWidth;
+            result.Height = DstHeight;
+
+            using var pSrc = data.Data!.MemoryLock();
+            using var pDst = result.Data.MemoryLock();
+
+            Execute(pSrc, pDst);
+
+            return result;
+        }
+
+        public void Dispose()
+        {
+            if (_handle != 0)
+            {
+                EngineNativeLib.DestroyResizePlan(_handle);
+                _handle = 0;
+            }
+            GC.SuppressFinalize(this);
+        }
+
+        public uint SrcWidth { get; }
+
+        public uint SrcHeight { get; }
+
+        public uint DstWidth { get; }
+
+        public uint DstHeight { get; }
+
+        public uint Channels { get; }
+
+        public ResizeFlags Flags { get; }
+    }
+}
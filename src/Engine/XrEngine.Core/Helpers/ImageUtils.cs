@@ -88,6 +88,12 @@ namespace XrEngine
                     format == TextureFormat.SRgb24;
         }
 
+        public static bool IsInt16(this TextureFormat format)
+        {
+            return format == TextureFormat.GrayInt16 ||
+                   format == TextureFormat.Depth16;
+        }
+
         public static bool IsFloat16(this TextureFormat format)
         {
             return format == TextureFormat.RgFloat16 ||
@@ -104,7 +110,32 @@ namespace XrEngine
                    format == TextureFormat.GrayFloat32;
         }
 
-        public static SKBitmap ApplyGaussianBlur(SKBitmap bitmap, float radius)
+        public static unsafe SKBitmap ApplyGaussianBlur(SKBitmap bitmap, float radius)
+        {
+            var flags = bitmap.ColorType switch
+            {
+                SKColorType.Gray8 or SKColorType.Alpha8 or SKColorType.Rg88 or
+                SKColorType.Rgba8888 or SKColorType.Bgra8888 or SKColorType.Rgb888x => BlurFlags.None,
+                SKColorType.RgbaF32 => BlurFlags.Float,
+                _ => (BlurFlags?)null
+            };
+
+            if (flags != null)
+            {
+                var result = new SKBitmap(bitmap.Info);
+                var channels = flags == BlurFlags.Float ? 4 : bitmap.BytesPerPixel;
+
+                EngineNativeLib.ImageBlur((byte*)bitmap.GetPixels(), (byte*)result.GetPixels(),
+                    (uint)bitmap.Width, (uint)bitmap.Height, (uint)channels,
+                    (uint)bitmap.RowBytes, (uint)result.RowBytes, radius, flags.Value);
+
+                return result;
+            }
+
+            return ApplyGaussianBlurSkia(bitmap, radius);
+        }
+
+        internal static SKBitmap ApplyGaussianBlurSkia(SKBitmap bitmap, float radius)
         {
             using var surface = SKSurface.Create(new SKImageInfo(bitmap.Width, bitmap.Height));
 
@@ -125,16 +156,37 @@ namespace XrEngine
             return MergeMetalRaugh(metal.Data![0], roughness.Data![0]);
         }
 
-        public static Texture2D MergeMetalRaugh(TextureData metal, TextureData roughness)
+        public static unsafe Texture2D MergeMetalRaugh(TextureData metal, TextureData roughness)
         {
-            var mrImage = MemoryBuffer.Create<byte>(metal.Width * metal.Height * 4);
-
             using var pMetal = metal.Data!.MemoryLock();
             using var pRough = roughness.Data!.MemoryLock();
-            using var pDst = mrImage.MemoryLock();
-            EngineNativeLib.ImageCopyChannel(pMetal, pDst, metal.Width, metal.Height, metal.Width * GetPixelSizeByte(metal.Format), metal.Width * 4, 0, 2, 1);
-            EngineNativeLib.ImageCopyChannel(pRough, pDst, roughness.Width, roughness.Height, roughness.Width * GetPixelSizeByte(roughness.Format), metal.Width * 4, 0, 1, 1);
 
+            var mrImage = PackChannels(metal.Width, metal.Height,
+                PackConstant(0),
+                PackSource(roughness, pRough, 0),
+                PackSource(metal, pMetal, 0),
+                PackConstant(0));
+
+            return CreateMetalRaugh(mrImage, metal.Width, metal.Height);
+        }
+
+        public static unsafe Texture2D MergeMetalRaugh(Texture2D roughness)
+        {
+            var data = roughness.Data![0];
+
+            using var pRough = data.Data!.MemoryLock();
+
+            var mrImage = PackChannels(data.Width, data.Height,
+                PackConstant(0),
+                PackSource(data, pRough, 0),
+                PackConstant(1),
+                PackConstant(0));
+
+            return CreateMetalRaugh(mrImage, data.Width, data.Height);
+        }
+
+        static Texture2D CreateMetalRaugh(IMemoryBuffer<byte> mrImage, uint width, uint height)
+        {
             var tex = new Texture2D
             {
                 MipLevelCount = 20,
@@ -144,28 +196,51 @@ namespace XrEngine
             tex.LoadData(new TextureData
             {
                 Data = mrImage,
-                Width = metal.Width,
-                Height = metal.Height,
+                Width = width,
+                Height = height,
                 Format = TextureFormat.Rgba32
             });
             return tex;
         }
 
-        public static Texture2D MergeMetalRaugh(Texture2D roughness)
+        public static unsafe PackChannelSource PackSource(TextureData data, byte* pData, uint channel)
         {
-            var metalData = MemoryBuffer.Create<byte>(roughness.Width * roughness.Height * 1);
-            metalData.AsSpan().Fill(255);
+            var pixelSize = GetPixelSizeByte(data.Format);
+
+            var type = data.Format.IsFloat32() ? PackSourceType.F32 :
+                       data.Format.IsInt16() ? PackSourceType.U16 :
+                       data.Format.IsInt8() ? PackSourceType.U8 :
+                       throw new NotSupportedException();
 
-            var texData = new TextureData
+            return new PackChannelSource
             {
-                Data = metalData,
-                Width = roughness.Width,
-                Height = roughness.Height,
-                Format = TextureFormat.GrayInt8
+                Data = pData,
+                Stride = data.Width * pixelSize,
+                PixelSize = pixelSize,
+                Offset = type == PackSourceType.F32 ? channel * 4 : type == PackSourceType.U16 ? channel * 2 : channel,
+                Type = type
             };
+        }
 
+        public static PackChannelSource PackConstant(float value)
+        {
+            return new PackChannelSource { Constant = value };
+        }
+
+        /// <summary>
+        /// Builds an RGBA32 image taking each channel from a source plane or a constant, in a single native pass
+        /// </summary>
+        public static unsafe IMemoryBuffer<byte> PackChannels(uint width, uint height, PackChannelSource r, PackChannelSource g, PackChannelSource b, PackChannelSource a)
+        {
+            var result = MemoryBuffer.Create<byte>(width * height * 4);
 
-            return MergeMetalRaugh(texData, roughness.Data![0]);
+            var sources = stackalloc PackChannelSource[4] { r, g, b, a };
+
+            using var pDst = result.MemoryLock();
+
+            EngineNativeLib.ImagePackChannels(sources, 4, pDst, width, height, 0);
+
+            return result;
         }
 
 
@@ -222,12 +297,9 @@ namespace XrEngine
 
             if (flipY)
             {
-                var dst = MemoryBuffer.Create<byte>(data.Height * data.Width * pixelSize);
-
+                // Flip straight into the bitmap pixels, no intermediate copy
                 using var pData = data.Data.MemoryLock();
-                using var pDst = dst.MemoryLock();
-                EngineNativeLib.ImageFlipY(pData, pDst, data.Width, data.Height, data.Width * pixelSize);
-                image.SetPixels(pDst);
+                EngineNativeLib.ImageFlipY(pData, image.GetPixels(), data.Width, data.Height, data.Width * pixelSize);
             }
             else
             {
@@ -238,6 +310,47 @@ namespace XrEngine
             return image;
         }
 
+        /// <summary>
+        /// Flips, swaps BGRA to RGBA and unpremultiplies a 32 bit image in place, in a single pass
+        /// </summary>
+        public static unsafe void FlipConvert(this TextureData data, FlipConvertFlags flags)
+        {
+            if (data.Format.GetPixelSizeBit() != 32 || !data.Format.IsInt8())
+                throw new NotSupportedException();
+
+            using var pData = data.Data!.MemoryLock();
+
+            EngineNativeLib.ImageFlipConvert(pData, pData, data.Width, data.Height, 0, 0, flags);
+
+            if ((flags & FlipConvertFlags.SwapRB) != 0)
+            {
+                data.Format = data.Format switch
+                {
+                    TextureFormat.Bgra32 => TextureFormat.Rgba32,
+                    TextureFormat.SBgra32 => TextureFormat.SRgba32,
+                    TextureFormat.Rgba32 => TextureFormat.Bgra32,
+                    TextureFormat.SRgba32 => TextureFormat.SBgra32,
+                    _ => data.Format
+                };
+            }
+        }
+
+        public static unsafe void Blur(this TextureData data, float sigma, BlurFlags flags = BlurFlags.None)
+        {
+            if (data.Format.IsInt8())
+                flags &= ~BlurFlags.Float;
+            else if (data.Format.IsFloat32())
+                flags |= BlurFlags.Float;
+            else
+                throw new NotSupportedException();
+
+            var channels = data.Format.GetPixelSizeBit() / (data.Format.IsFloat32() ? 32u : 8u);
+
+            using var pData = data.Data!.MemoryLock();
+
+            EngineNativeLib.ImageBlur(pData, pData, data.Width, data.Height, channels, 0, 0, sigma, flags);
+        }
+
         public static unsafe TextureData ToTextureData(this SKBitmap image)
         {
             var buffer = MemoryBuffer.Create<byte>((uint)(image.BytesPerPixel * image.Width * image.Height));
@@ -289,11 +402,64 @@ namespace XrEngine
             using var pSrc = data.Data!.MemoryLock();
             using var pDst = result.Data.MemoryLock();
 
-            EngineNativeLib.ImageResizeBilinearU8(data.Width, data.Height, pSrc, (uint)width, (uint)height, pDst, channels);
+            ResizeBilinear(data, pSrc, (uint)width, (uint)height, pDst);
 
             return result;
         }
 
+        static unsafe void ResizeBilinear(TextureData data, byte* src, uint width, uint height, byte* dst)
+        {
+            var channels = data.Format.GetPixelSizeBit() / 8;
+
+            // sRGB data is filtered in linear light, blending the encoded bytes darkens the result
+            if (data.Format.IsSrgb())
+                EngineNativeLib.ImageResizeBilinearSrgbU8(data.Width, data.Height, src, width, height, dst, channels);
+            else
+                EngineNativeLib.ImageResizeBilinearU8(data.Width, data.Height, src, width, height, dst, channels);
+        }
+
+
+        public static unsafe IList<TextureData> BuildMipChain(TextureData data, uint maxLevels = uint.MaxValue, MipChainFlags flags = MipChainFlags.None, float alphaCutoff = 0.5f)
+        {
+            if (!data.Format.IsInt8())
+                throw new NotSupportedException();
+
+            var channels = data.Format.GetPixelSizeBit() / 8;
+
+            if (data.Format.IsSrgb())
+                flags |= MipChainFlags.Srgb;
+
+            var levelCount = EngineNativeLib.ImageBuildMipChain(null, data.Width, data.Height, channels, flags, null, null, alphaCutoff);
+
+            var offsets = new uint[levelCount + 1];
+
+            var result = new List<TextureData>();
+
+            fixed (uint* pOffsets = offsets)
+            {
+                EngineNativeLib.ImageBuildMipChain(null, data.Width, data.Height, channels, flags, null, pOffsets, alphaCutoff);
+
+                var chain = MemoryBuffer.Create<byte>(offsets[levelCount]);
+
+                using (var pSrc = data.Data!.MemoryLock())
+                using (var pDst = chain.MemoryLock())
+                    EngineNativeLib.ImageBuildMipChain(pSrc, data.Width, data.Height, channels, flags, pDst, pOffsets, alphaCutoff);
+
+                var span = chain.AsSpan();
+
+                for (var i = 0; i < Math.Min(levelCount, maxLevels); i++)
+                {
+                    var level = data.Clone();
+                    level.Width = Math.Max(1, data.Width >> i);
+                    level.Height = Math.Max(1, data.Height >> i);
+                    level.MipLevel = (uint)i;
+                    level.Data = i == 0 ? data.Data : MemoryBuffer.Create(span.Slice((int)offsets[i], (int)(offsets[i + 1] - offsets[i])));
+                    result.Add(level);
+                }
+            }
+
+            return result;
+        }
 
         public static unsafe TextureData Pack(TextureData data, int align)
         {
@@ -313,7 +479,7 @@ namespace XrEngine
 
             using var pDst = newData.MemoryLock();
 
-            EngineNativeLib.ImageResizeBilinearU8(data.Width, data.Height, pSrc, (uint)pWidth, (uint)pHeight, pDst, pixelSize);
+            ResizeBilinear(data, pSrc, (uint)pWidth, (uint)pHeight, pDst);
 
             result.Data = newData;
             result.Width = (uint)pWidth;
@@ -0,0 +1,69 @@
+﻿namespace XrEngine
+{
+    /// <summary>
+    /// Native fixed period timer: sleeps to an absolute deadline and spins the last part, deadlines stay on a fixed grid so the rate doesn't drift
+    /// </summary>
+    public class PrecisionTimer : IDisposable
+    {
+        nint _handle;
+
+        public PrecisionTimer(TimeSpan period)
+            : this((ulong)period.Ticks * 100)
+        {
+        }
+
+        public PrecisionTimer(ulong periodNs)
+        {
+            _handle = EngineNativeLib.TimerCreate(periodNs);
+            if (_handle == 0)
+                throw new ArgumentException("Invalid timer period");
+
+            PeriodNs = periodNs;
+        }
+
+        ~PrecisionTimer()
+        {
+            Dispose();
+        }
+
+        /// <summary>
+        /// Waits for the next deadline, returns the periods elapsed since the previous one (more than 1 when late)
+        /// </summary>
+        public uint WaitNext()
+        {
+            ObjectDisposedException.ThrowIf(_handle == 0, this);
+
+            return EngineNativeLib.TimerWaitNext(_handle);
+        }
+
+        /// <summary>
+        /// Restarts the grid one period from now, to use after a pause
+        /// </summary>
+        public void Reset()
+        {
+            ObjectDisposedException.ThrowIf(_handle == 0, this);
+
+            EngineNativeLib.TimerReset(_handle);
+        }
+
+        public TimerStats GetStats(bool reset = false)
+        {
+            ObjectDisposedException.ThrowIf(_handle == 0, this);
+
+            EngineNativeLib.TimerGetStats(_handle, out var stats, reset);
+            return stats;
+        }
+
+        public void Dispose()
+        {
+            if (_handle != 0)
+            {
+                EngineNativeLib.TimerDestroy(_handle);
+                _handle = 0;
+            }
+            GC.SuppressFinalize(this);
+        }
+
+        public ulong PeriodNs { get; }
+    }
+}
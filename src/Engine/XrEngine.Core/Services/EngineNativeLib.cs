@@ -2,17 +2,123 @@
 
 namespace XrEngine
 {
+    [Flags]
+    public enum MipChainFlags : uint
+    {
+        None = 0,
+        Srgb = 1,
+        Kaiser = 2,
+        PreserveCoverage = 4
+    }
+
+    [Flags]
+    public enum ResizeFlags : uint
+    {
+        None = 0,
+        Srgb = 1
+    }
+
+    public enum SwizzleFormat : uint
+    {
+        R8 = 1,
+        Rg8 = 2,
+        Rgb8 = 3,
+        Rgba8 = 4
+    }
+
+    public static class SwizzleMask
+    {
+        public const uint Zero = 4;
+
+        public const uint One = 5;
+
+        public const uint Identity = 0x3210;
+
+        public const uint SwapRB = 0x3012;
+
+        public static uint Create(uint r, uint g, uint b, uint a)
+        {
+            return r | (g << 4) | (b << 8) | (a << 12);
+        }
+    }
+
+    [Flags]
+    public enum FlipConvertFlags : uint
+    {
+        None = 0,
+        FlipY = 1,
+        SwapRB = 2,
+        Unpremultiply = 4
+    }
+
+    public unsafe struct CopyRect2DDesc
+    {
+        public byte* Src;
+        public byte* Dst;
+        public int SrcStride;
+        public int DstStride;
+        public uint RowBytes;
+        public uint Rows;
+    }
+
+    public enum PackSourceType : uint
+    {
+        U8 = 0,
+        U16 = 1,
+        F32 = 2
+    }
+
+    public unsafe struct PackChannelSource
+    {
+        public void* Data;
+        public uint Stride;
+        public uint PixelSize;
+        public uint Offset;
+        public PackSourceType Type;
+        public float Constant;
+    }
+
+    [Flags]
+    public enum BlurFlags : uint
+    {
+        None = 0,
+        Float = 1,
+        Box = 2
+    }
+
+    public struct TimerStats
+    {
+        public ulong Ticks;
+        public ulong Missed;
+        public long MinLatenessNs;
+        public long MaxLatenessNs;
+        public long P99LatenessNs;
+        public long TotalLatenessNs;
+        public long SpinNs;
+
+        public readonly long AvgLatenessNs => Ticks == 0 ? 0 : TotalLatenessNs / (long)Ticks;
+    }
+
     public static class EngineNativeLib
     {
         [DllImport("xrengine-native", CallingConvention = CallingConvention.Cdecl)]
         public static extern void ImageFlipY(nint src, nint dst, uint width, uint height, uint rowSize);
 
+        [DllImport("xrengine-native")]
+        public static unsafe extern void ImageFlipConvert(byte* src, byte* dst, uint width, uint height, uint srcStride, uint dstStride, FlipConvertFlags flags);
+
         [DllImport("xrengine-native")]
         public static extern void ImageCopyChannel(nint src, nint dst, uint width, uint height, uint srcRowSize, uint dstRowSize, uint srcOfs, uint dstOfs, uint cSize);
 
         [DllImport("xrengine-native", EntryPoint = "CopyMemory2")]
         public static extern void CopyMemory(nint src, nint dst, uint size);
 
+        [DllImport("xrengine-native")]
+        public static unsafe extern void CopyRect2D(byte* src, int srcStride, byte* dst, int dstStride, uint rowBytes, uint rows);
+
+        [DllImport("xrengine-native")]
+        public static unsafe extern void CopyRects2D(CopyRect2DDesc* rects, uint count);
+
         [DllImport("xrengine-native")]
         public static extern int CompareMemory(nint src, nint dst, uint size);
 
@@ -26,6 +132,56 @@ namespace XrEngine
         [DllImport("xrengine-native")]
         public static extern void SleepFor(ulong time);
 
+        [DllImport("xrengine-native")]
+        public static extern nint TimerCreate(ulong periodNs);
+
+        [DllImport("xrengine-native")]
+        public static extern uint TimerWaitNext(nint timer);
+
+        [DllImport("xrengine-native")]
+        public static extern void TimerGetStats(nint timer, out TimerStats stats, [MarshalAs(UnmanagedType.U1)] bool reset);
+
+        [DllImport("xrengine-native")]
+        public static extern void TimerReset(nint timer);
+
+        [DllImport("xrengine-native")]
+        public static extern void TimerDestroy(nint timer);
+
+        [DllImport("xrengine-native")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool JobsInit(uint threads, ulong affinityMask);
+
+        [DllImport("xrengine-native")]
+        public static extern void JobsShutdown();
+
+        [DllImport("xrengine-native")]
+        public static extern uint JobsGetThreadCount();
+
+        [DllImport("xrengine-native")]
+        public static extern ulong JobsGetBigCoreMask();
+
+        [DllImport("xrengine-native")]
+        public static unsafe extern void JobsParallelFor(uint count, uint minBatch, delegate* unmanaged[Cdecl]<nint, uint, uint, void> func, nint data);
+
+        [DllImport("xrengine-native")]
+        public static extern nint JobGroupCreate();
+
+        [DllImport("xrengine-native")]
+        public static unsafe extern void JobGroupRun(nint group, delegate* unmanaged[Cdecl]<nint, void> func, nint data);
+
+        [DllImport("xrengine-native")]
+        public static unsafe extern void JobGroupParallelFor(nint group, uint count, uint minBatch, delegate* unmanaged[Cdecl]<nint, uint, uint, void> func, nint data);
+
+        [DllImport("xrengine-native")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool JobGroupWait(nint group);
+
+        [DllImport("xrengine-native")]
+        public static extern void JobGroupCancel(nint group);
+
+        [DllImport("xrengine-native")]
+        public static extern void JobGroupDestroy(nint group);
+
 
         [DllImport("xrengine-native")]
         public static unsafe extern void ImagePack(uint srcWidth, uint srcHeight, byte* srcData, uint dstWidth, uint dstHeight, byte* dstData, uint pixelSize);
@@ -40,5 +196,32 @@ namespace XrEngine
                 uint srcW, uint srcH, byte* src,
                 uint dstW, uint dstH, byte* dst,
                 uint channels);
+
+        [DllImport("xrengine-native")]
+        public static unsafe extern void ImageResizeBilinearSrgbU8(
+                uint srcW, uint srcH, byte* src,
+                uint dstW, uint dstH, byte* dst,
+                uint channels);
+
+        [DllImport("xrengine-native")]
+        public static extern nint CreateResizePlan(uint srcW, uint srcH, uint dstW, uint dstH, uint channels, ResizeFlags flags);
+
+        [DllImport("xrengine-native")]
+        public static unsafe extern void ExecuteResizePlan(nint plan, byte* src, byte* dst);
+
+        [DllImport("xrengine-native")]
+        public static extern void DestroyResizePlan(nint plan);
+
+        [DllImport("xrengine-native")]
+        public static unsafe extern void ImageSwizzle(byte* src, byte* dst, uint width, uint height, uint srcStride, uint dstStride, SwizzleFormat srcFormat, SwizzleFormat dstFormat, uint swizzleMask);
+
+        [DllImport("xrengine-native")]
+        public static unsafe extern void ImagePackChannels(PackChannelSource* sources, uint sourceCount, byte* dst, uint width, uint height, uint dstStride);
+
+        [DllImport("xrengine-native")]
+        public static unsafe extern uint ImageBuildMipChain(byte* src, uint width, uint height, uint channels, MipChainFlags flags, byte* dst, uint* levelOffsets, float alphaCutoff);
+
+        [DllImport("xrengine-native")]
+        public static unsafe extern void ImageBlur(byte* src, byte* dst, uint width, uint height, uint channels, uint srcStride, uint dstStride, float sigma, BlurFlags flags);
     }
 }
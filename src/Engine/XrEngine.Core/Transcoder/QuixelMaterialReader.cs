@@ -232,7 +232,8 @@ namespace XrEngine
                 result = MaterialFactory.CreatePbr(Color.White);
                 result.Roughness = 0.7f;
 
-                IMemoryBuffer<byte>? mrImage = null;
+                Texture2D? roughTex = null;
+                Texture2D? metalTex = null;
 
                 var mat = Parse(fileName);
 
@@ -278,28 +279,56 @@ namespace XrEngine
                     }
 
 
-                    else if (texture.Type == TextureType.Roughness ||
-                             texture.Type == TextureType.Metallic)
+                    else if (texture.Type == TextureType.Roughness)
                     {
-                        mrImage ??= MemoryBuffer.Create<byte>(tex2D.Width * tex2D.Height * 4);
-
-                        var ofs = texture.Type == TextureType.Roughness ? 1u : 2u;
-
-                        using var pSrc = tex2D.Data![0].Data!.MemoryLock();
-                        using var pDst = mrImage.MemoryLock();
-
-                        EngineNativeLib.ImageCopyChannel(pSrc, pDst, tex2D.Width, tex2D.Height, tex2D.Width * 4, tex2D.Width * 4, 0, ofs, 1);
+                        roughTex = tex2D;
+                        result.MetallicRoughnessMap = tex2D;
+                    }
 
-                        tex2D.Data[0].Data = mrImage;
-                        //tex2D.Format = TextureFormat.Rgb24;
+                    else if (texture.Type == TextureType.Metallic)
+                    {
+                        metalTex = tex2D;
                         result.MetallicRoughnessMap = tex2D;
                     }
                 }
 
+                if (result.MetallicRoughnessMap != null)
+                    PackMetalRoughness(roughTex, metalTex);
+
                 _materialCache[fileName] = result;
             }
 
             return (Material)result;
         }
+
+        static unsafe void PackMetalRoughness(Texture2D? roughTex, Texture2D? metalTex)
+        {
+            var roughData = roughTex?.Data![0];
+            var metalData = metalTex?.Data![0];
+            var size = (roughData ?? metalData)!;
+
+            using var pRough = roughData?.Data!.MemoryLock();
+            using var pMetal = metalData?.Data!.MemoryLock();
+
+            // Roughness in G, metalness in B, both read from the red channel of their map in one pass
+            var mrImage = ImageUtils.PackChannels(size.Width, size.Height,
+                ImageUtils.PackConstant(0),
+                roughData != null ? ImageUtils.PackSource(roughData, pRough.Value, 0) : ImageUtils.PackConstant(0),
+                metalData != null ? ImageUtils.PackSource(metalData, pMetal.Value, 0) : ImageUtils.PackConstant(0),
+                ImageUtils.PackConstant(0));
+
+            // The packed level replaces the source chain: RGBA32 whatever the maps were loaded as
+            var packed = new TextureData
+            {
+                Data = mrImage,
+                Width = size.Width,
+                Height = size.Height,
+                Format = TextureFormat.Rgba32
+            };
+
+            roughTex?.LoadData(packed, false);
+
+            metalTex?.LoadData(packed, false);
+        }
     }
 }
@@ -0,0 +1,127 @@
+﻿using System.Numerics;
+using System.Runtime.InteropServices;
+using static XrEngine.Filament.FilamentLib;
+
+namespace XrEngine.Filament
+{
+    /// <summary>
+    /// Writer side of the native command ring: scene changes are packed in shared memory and executed
+    /// natively in one call per frame (Render / ExecuteCommands), instead of one P/Invoke each.
+    /// Must be used from the render thread, a full ring is drained inline.
+    /// </summary>
+    public unsafe class FilamentCommandRing
+    {
+        const uint HeaderSize = 16;
+
+        static readonly uint LightInfoSize = (uint)Marshal.SizeOf<LightInfo>();
+        static readonly uint MaterialInfoSize = (uint)Marshal.SizeOf<MaterialInfo>();
+
+        readonly FilamentApp _app;
+        readonly CommandRing* _ring;
+        ulong _writePos;
+        uint _pendingSize;
+
+        public FilamentCommandRing(FilamentApp app, uint capacity)
+        {
+            _app = app;
+            _ring = CreateCommandRing(app, capacity);
+            _writePos = Volatile.Read(ref _ring->WritePos);
+        }
+
+        public void SetTransform(uint handle, in Matrix4x4 matrix)
+        {
+            var payload = Begin(CommandType.SetTransform, handle, 0, (uint)sizeof(Matrix4x4));
+            *(Matrix4x4*)payload = matrix;
+            Commit();
+        }
+
+        public void SetVisible(uint handle, bool visible)
+        {
+            Begin(CommandType.SetVisible, handle, visible ? 1u : 0u, 0);
+            Commit();
+        }
+
+        public void SetParent(uint handle, uint parentHandle)
+        {
+            Begin(CommandType.SetParent, handle, parentHandle, 0);
+            Commit();
+        }
+
+        public void SetMeshMaterial(uint handle, uint matHandle)
+        {
+            Begin(CommandType.SetMeshMaterial, handle, matHandle, 0);
+            Commit();
+        }
+
+        public void UpdateLight(uint handle, in LightInfo info)
+        {
+            var payload = Begin(CommandType.UpdateLight, handle, 0, LightInfoSize);
+            Marshal.StructureToPtr(info, (nint)payload, false);
+            Commit();
+        }
+
+        public void UpdateMaterial(uint handle, in MaterialInfo info)
+        {
+            var payload = Begin(CommandType.UpdateMaterial, handle, 0, MaterialInfoSize);
+            Marshal.StructureToPtr(info, (nint)payload, false);
+            Commit();
+        }
+
+        public uint Execute()
+        {
+            return ExecuteCommands(_app);
+        }
+
+        public CommandStats GetStats(bool reset = false)
+        {
+            GetCommandStats(_app, out var stats, reset);
+            return stats;
+        }
+
+        protected byte* Begin(CommandType type, uint handle, uint param, uint payloadSize)
+        {
+            // Padded to the header size: any tail left before the end of the ring can hold a Skip header
+            var size = (HeaderSize + payloadSize + HeaderSize - 1) & ~(HeaderSize - 1);
+            var capacity = _ring->Capacity;
+
+            if (size > capacity)
+                throw new ArgumentException($"Command of {size} bytes exceeds the ring capacity");
+
+            var offset = _writePos % capacity;
+
+            // Commands never wrap: pad the tail with a skip and restart from the beginning
+            var pad = offset + size > capacity ? capacity - offset : 0;
+
+            if (capacity - (_writePos - Volatile.Read(ref _ring->ReadPos)) < pad + size)
+                Execute();
+
+            if (pad > 0)
+            {
+                var skip = (CommandHeader*)(_ring->Data + offset);
+                skip->Type = CommandType.Skip;
+                skip->Size = (uint)pad;
+                skip->Handle = 0;
+                skip->Param = 0;
+                _writePos += pad;
+                offset = 0;
+            }
+
+            var header = (CommandHeader*)(_ring->Data + offset);
+            header->Type = type;
+            header->Size = size;
+            header->Handle = handle;
+            header->Param = param;
+
+            _pendingSize = size;
+
+            return (byte*)(header + 1);
+        }
+
+        protected void Commit()
+        {
+            _writePos += _pendingSize;
+            _pendingSize = 0;
+            Volatile.Write(ref _ring->WritePos, _writePos);
+        }
+    }
+}
@@ -178,6 +178,35 @@ namespace XrEngine.Filament
             UV1
         }
 
+        public enum VertexFormat : uint
+        {
+            Default = 0,
+            Float2,
+            Float3,
+            Float4,
+            Half2,
+            Half4,
+            UByte4Norm,
+            Short2Norm,
+            Short4Norm,
+            UShort2Norm
+        }
+
+        public enum IndexFormat : byte
+        {
+            UInt = 0,
+            UShort = 1
+        }
+
+        [Flags]
+        public enum GeometryQuantize : uint
+        {
+            None = 0,
+            Indices = 1,
+            Uv = 2,
+            Color = 4
+        }
+
         public enum FlBlendingMode : byte
         {
             OPAQUE,
@@ -362,6 +391,7 @@ namespace XrEngine.Filament
             public VertexAttributeType Type;
             public uint Offset;
             public uint Size;
+            public VertexFormat Format;
         }
 
         public struct VertexLayout
@@ -371,6 +401,13 @@ namespace XrEngine.Filament
             public uint AttributeCount;
         }
 
+        public enum GeometryUpload : uint
+        {
+            Copy = 0,
+            Borrowed = 1,
+            Owned = 2
+        }
+
         public struct GeometryInfo
         {
             public uint* Indices;
@@ -380,6 +417,32 @@ namespace XrEngine.Filament
             public VertexLayout layout;
             public Bounds3 Bounds;
             public PrimitiveType Primitive;
+            public GeometryUpload Upload;
+            public delegate* unmanaged[Cdecl]<void*, void*, void> Release;
+            public nint VerticesUser;
+            public nint IndicesUser;
+            public GeometryQuantize Quantize;
+            public IndexFormat IndexFormat;
+        }
+
+        public struct DynamicGeometryOptions
+        {
+            public uint VertexCapacity;
+            public uint IndexCapacity;
+            public uint BufferCount;
+        }
+
+        public struct GeometryUpdate
+        {
+            public byte* Vertices;
+            public uint VertexOffset;
+            public uint VertexCount;
+            public uint* Indices;
+            public uint IndexOffset;
+            public uint IndexCount;
+            public uint TotalVertices;
+            public uint TotalIndices;
+            public Bounds3 Bounds;
         }
 
         public struct ImageData
@@ -392,6 +455,7 @@ namespace XrEngine.Filament
             public bool AutoFree;
             [MarshalAs(UnmanagedType.U1)]
             public bool IsBgr;
+            public ulong Version;
 
         };
 
@@ -487,6 +551,166 @@ namespace XrEngine.Filament
             public nint Handle;
         }
 
+        public enum CommandType : uint
+        {
+            Skip = 0,
+            SetTransform = 1,
+            SetVisible = 2,
+            SetParent = 3,
+            SetMeshMaterial = 4,
+            UpdateLight = 5,
+            UpdateMaterial = 6
+        }
+
+        public struct CommandHeader
+        {
+            public CommandType Type;
+            public uint Size;
+            public uint Handle;
+            public uint Param;
+        }
+
+        [StructLayout(LayoutKind.Explicit)]
+        public struct CommandRing
+        {
+            [FieldOffset(0)]
+            public byte* Data;
+            [FieldOffset(8)]
+            public ulong Capacity;
+            [FieldOffset(64)]
+            public ulong WritePos;
+            [FieldOffset(128)]
+            public ulong ReadPos;
+        }
+
+        public struct CommandStats
+        {
+            public ulong Frames;
+            public ulong TotalCommands;
+            public ulong TotalBytes;
+            public uint LastCommands;
+            public uint LastBytes;
+            public uint MaxCommands;
+            public uint MaxBytes;
+        }
+
+        public enum UploadTag : uint
+        {
+            Other = 0,
+            VB = 1,
+            IB = 2,
+            TEX = 3,
+            QUAD = 4,
+            Count = 5
+        }
+
+        public struct UploadTagStats
+        {
+            public ulong Allocations;
+            public ulong LiveBytes;
+            public ulong PeakBytes;
+            public ulong TotalBytes;
+        }
+
+        public struct UploadPoolStats
+        {
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = (int)UploadTag.Count)]
+            public UploadTagStats[] Tags;
+            public ulong RetainedBytes;
+            public ulong RetainedLimit;
+            public ulong PoolHits;
+            public ulong HeapAllocations;
+        }
+
+        public enum MaterialState : uint
+        {
+            Pending = 0,
+            Built = 1,
+            Ready = 2,
+            Failed = 3
+        }
+
+        public enum MaterialSource : uint
+        {
+            Compiled = 0,
+            Cache = 1
+        }
+
+        [Flags]
+        public enum FrameFlags : uint
+        {
+            None = 0,
+            Dropped = 1,
+            NoMainView = 2,
+            Waited = 4,
+            Throttled = 8
+        }
+
+        public struct FrameStats
+        {
+            public ulong FrameIndex;
+            public FrameFlags Flags;
+            public uint ViewsRendered;
+            public float TotalTime;
+            public float PrepareTime;
+            public float BeginFrameTime;
+            public float RenderTime;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = 4)]
+            public float[] ViewTimes;
+            public float EndFrameTime;
+            public float FlushTime;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = (int)UploadTag.Count)]
+            public ulong[] UploadBytes;
+            public ulong StreamingBytes;
+            public uint Commands;
+            public uint CommandBytes;
+            public uint Renderables;
+            public uint Lights;
+            public uint Entities;
+            public uint GpuFrameId;
+            public float GpuTime;
+            public float GpuTimeDenoised;
+            public float ThrottleTime;
+        }
+
+        public struct TextureStreamingOptions
+        {
+            [MarshalAs(UnmanagedType.U1)]
+            public bool Enabled;
+            public uint FrameBudget;
+            public ulong MemoryBudget;
+            public uint InitialSize;
+            public uint EvictFrames;
+            public uint UsageInterval;
+        }
+
+        public struct TextureStreamingStats
+        {
+            public uint Textures;
+            public uint Building;
+            public ulong ResidentBytes;
+            public ulong CpuBytes;
+            public ulong UploadedBytes;
+            public ulong LastFrameBytes;
+            public uint Refinements;
+            public uint Evictions;
+        }
+
+        public struct MaterialUpdateStats
+        {
+            public ulong BytesUploaded;
+            public uint ParametersChanged;
+            public uint TexturesUploaded;
+        }
+
+        public struct MaterialTiming
+        {
+            public ulong Key;
+            public float Milliseconds;
+            public MaterialSource Source;
+            public MaterialState State;
+        }
+
 
         [DllImport("filament-native")]
         public static extern FilamentApp Initialize(ref InitializeOptions options);
@@ -504,19 +728,40 @@ namespace XrEngine.Filament
         public static extern void Render(FilamentApp app, RenderTarget* targets, uint count, bool wait);
 
         [DllImport("filament-native")]
-        public static extern void AddLight(FilamentApp app, Guid id, ref LightInfo info);
+        public static extern uint AddLight(FilamentApp app, Guid id, ref LightInfo info);
 
         [DllImport("filament-native")]
         public static extern void UpdateLight(FilamentApp app, Guid id, ref LightInfo info);
 
         [DllImport("filament-native")]
-        public static extern void AddGeometry(FilamentApp app, Guid id, ref GeometryInfo info);
+        public static extern void UpdateLightByHandle(FilamentApp app, uint handle, ref LightInfo info);
 
         [DllImport("filament-native")]
-        public static extern void AddMesh(FilamentApp app, Guid id, ref MeshInfo info);
+        public static extern uint AddGeometry(FilamentApp app, Guid id, ref GeometryInfo info);
 
         [DllImport("filament-native")]
-        public static extern void AddGroup(FilamentApp app, Guid id);
+        public static extern uint AddMesh(FilamentApp app, Guid id, ref MeshInfo info);
+
+        [DllImport("filament-native")]
+        public static extern uint AddInstancedMesh(FilamentApp app, Guid id, ref MeshInfo info, uint instanceCount);
+
+        [DllImport("filament-native")]
+        public static extern void SetInstanceTransforms(FilamentApp app, Guid id, Matrix4x4* matrices, uint first, uint count);
+
+        [DllImport("filament-native")]
+        public static extern void SetInstanceTransformsByHandle(FilamentApp app, uint handle, Matrix4x4* matrices, uint first, uint count);
+
+        [DllImport("filament-native")]
+        public static extern void SetInstanceVisibility(FilamentApp app, Guid id, byte* visible, uint first, uint count);
+
+        [DllImport("filament-native")]
+        public static extern void SetInstanceVisibilityByHandle(FilamentApp app, uint handle, byte* visible, uint first, uint count);
+
+        [DllImport("filament-native")]
+        public static extern uint GetVisibleInstanceCount(FilamentApp app, Guid id);
+
+        [DllImport("filament-native")]
+        public static extern uint AddGroup(FilamentApp app, Guid id);
 
         [DllImport("filament-native")]
         public static extern void SetWorldMatrix(FilamentApp app, Guid meshId, ref Matrix4x4 matrix);
@@ -524,13 +769,43 @@ namespace XrEngine.Filament
         [DllImport("filament-native")]
         public static extern void SetObjTransform(FilamentApp app, Guid id, Matrix4x4 matrix);
 
+        [DllImport("filament-native")]
+        public static extern void SetObjTransforms(FilamentApp app, Guid* ids, Matrix4x4* matrices, uint count);
+
+        [DllImport("filament-native")]
+        public static extern uint GetObjHandle(FilamentApp app, Guid id);
+
+        [DllImport("filament-native")]
+        public static extern void SetObjTransformsByHandle(FilamentApp app, uint* handles, Matrix4x4* matrices, uint count);
+
         [DllImport("filament-native")]
         public static extern void SetObjParent(FilamentApp app, Guid id, Guid parentId);
 
         [DllImport("filament-native")]
-        public static extern void AddMaterial(FilamentApp app, Guid id, ref MaterialInfo material);
+        public static extern void SetObjParentByHandle(FilamentApp app, uint handle, uint parentHandle);
+
+        [DllImport("filament-native")]
+        public static extern uint AddMaterial(FilamentApp app, Guid id, ref MaterialInfo material);
+        [DllImport("filament-native")]
+        public static extern MaterialUpdateStats UpdateMaterial(FilamentApp app, Guid id, ref MaterialInfo material);
+
+        [DllImport("filament-native")]
+        public static extern void GetMaterialUpdateStats(FilamentApp app, out MaterialUpdateStats stats, [MarshalAs(UnmanagedType.U1)] bool reset);
+
+        [DllImport("filament-native")]
+        public static extern void SetTextureStreaming(FilamentApp app, ref TextureStreamingOptions options);
+
+        [DllImport("filament-native")]
+        public static extern void GetTextureStreamingStats(FilamentApp app, out TextureStreamingStats stats);
+
+        [DllImport("filament-native")]
+        public static extern uint AddMaterialAsync(FilamentApp app, Guid id, ref MaterialInfo material);
+
+        [DllImport("filament-native")]
+        public static extern uint PrewarmMaterials(FilamentApp app, [In] MaterialInfo[] infos, uint count);
+
         [DllImport("filament-native")]
-        public static extern void UpdateMaterial(FilamentApp app, Guid id, ref MaterialInfo material);
+        public static extern uint GetMaterialTimings(FilamentApp app, [Out] MaterialTiming[] timings, uint capacity);
 
         [DllImport("filament-native")]
         public static extern bool GetGraphicContext(FilamentApp app, out GraphicContextInfo info);
@@ -541,6 +816,9 @@ namespace XrEngine.Filament
         [DllImport("filament-native")]
         public static extern void SetObjVisible(FilamentApp app, Guid id, bool visible);
 
+        [DllImport("filament-native")]
+        public static extern void SetObjVisibleByHandle(FilamentApp app, uint handle, bool visible);
+
         [DllImport("filament-native")]
         public static extern void AddImageLight(FilamentApp app, ref ImageLightInfo info);
 
@@ -554,13 +832,60 @@ namespace XrEngine.Filament
         [DllImport("filament-native")]
         public static extern void SetMeshMaterial(FilamentApp app, Guid id, Guid matId);
 
+        [DllImport("filament-native")]
+        public static extern void SetMeshMaterialByHandle(FilamentApp app, uint handle, uint matHandle);
+
 
         [DllImport("filament-native")]
         public static extern void UpdateMeshGeometry(FilamentApp app, Guid meshId, Guid geometryId, ref GeometryInfo info);
 
+        [DllImport("filament-native")]
+        public static extern uint AddDynamicGeometry(FilamentApp app, Guid id, ref GeometryInfo info, ref DynamicGeometryOptions options);
+
+        [DllImport("filament-native")]
+        public static extern void UpdateGeometryRange(FilamentApp app, Guid geometryId, ref GeometryUpdate update);
+
+        [DllImport("filament-native")]
+        public static extern void WaitGeometryJobs(FilamentApp app);
+
 
         [DllImport("filament-native")]
         public static extern nint Allocate(uint size);
 
+        [DllImport("filament-native")]
+        public static extern ulong TrimUploadPool(ulong targetBytes);
+
+        [DllImport("filament-native")]
+        public static extern void SetUploadPoolLimit(ulong bytes);
+
+        [DllImport("filament-native")]
+        public static extern void GetUploadPoolStats(out UploadPoolStats stats);
+
+        [DllImport("filament-native")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool GetFrameStats(FilamentApp app, out FrameStats stats);
+
+        [DllImport("filament-native")]
+        public static extern void SetFramesInFlight(FilamentApp app, uint count);
+
+        [DllImport("filament-native")]
+        public static extern ulong GetCompletedFrame(FilamentApp app);
+
+        [DllImport("filament-native")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool WaitFrame(FilamentApp app, ulong frameIndex);
+
+        [DllImport("filament-native")]
+        public static extern uint GetFrameStatsHistory(FilamentApp app, [Out] FrameStats[] stats, uint capacity);
+
+        [DllImport("filament-native")]
+        public static extern CommandRing* CreateCommandRing(FilamentApp app, uint capacity);
+
+        [DllImport("filament-native")]
+        public static extern uint ExecuteCommands(FilamentApp app);
+
+        [DllImport("filament-native")]
+        public static extern void GetCommandStats(FilamentApp app, out CommandStats stats, [MarshalAs(UnmanagedType.U1)] bool reset);
+
     }
 }
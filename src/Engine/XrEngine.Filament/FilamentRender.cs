@@ -1,5 +1,7 @@
 ﻿using Common.Interop;
 using System.Diagnostics;
+using System.Numerics;
+using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
 using XrEngine.Objects;
 using XrMath;
@@ -18,6 +20,15 @@ namespace XrEngine.Filament
             HdrColorBuffer = FlQualityLevel.MEDIUM;
             SampleCount = 1;
             UseSrgb = false;
+            TextureStreaming = new TextureStreamingOptions
+            {
+                Enabled = false,
+                FrameBudget = 4 * 1024 * 1024,
+                MemoryBudget = 256 * 1024 * 1024,
+                InitialSize = 64,
+                EvictFrames = 300,
+                UsageInterval = 8
+            };
         }
 
         public IntPtr Context;
@@ -33,6 +44,14 @@ namespace XrEngine.Filament
         public bool ShadowingEnabled;
         public FlShadowType ShadowType;
         public FlQualityLevel HdrColorBuffer;
+        public GeometryQuantize QuantizeGeometry;
+        public bool AsyncMaterials;
+        public TextureStreamingOptions TextureStreaming;
+        /// <summary>
+        /// Frames submitted ahead of the GPU (2-3), Render(flush) then only submits; 0 waits for each frame.
+        /// Consumers of a frame's output (readback, swapchains released outside the driver) use WaitFrame
+        /// </summary>
+        public uint FramesInFlight;
     }
 
     public class FilamentRender : IRenderEngine
@@ -71,6 +90,12 @@ namespace XrEngine.Filament
         protected FlBackend _driver;
         protected uint _renderTargetDepth;
         protected QueueDispatcher _dispatcher = new();
+        protected List<Guid> _pendingTransformIds = [];
+        protected List<Matrix4x4> _pendingTransforms = [];
+        protected Dictionary<Guid, int> _pendingTransformIndex = [];
+        protected Dictionary<Guid, uint> _handles = [];
+        protected Dictionary<Guid, ulong> _textureVersions = [];
+        protected FilamentCommandRing _commands;
 
         protected FilamentOptions _options;
 
@@ -102,6 +127,14 @@ namespace XrEngine.Filament
 
             _app = Initialize(ref initInfo);
 
+            _commands = new FilamentCommandRing(_app, 256 * 1024);
+
+            if (options.TextureStreaming.Enabled)
+                SetTextureStreaming(_app, ref options.TextureStreaming);
+
+            if (options.FramesInFlight > 0)
+                SetFramesInFlight(_app, options.FramesInFlight);
+
             if (options.WindowHandle != IntPtr.Zero)
             {
                 var mainViewId = CreateView(0, 0, -1);
@@ -120,8 +153,19 @@ namespace XrEngine.Filament
             return info;
         }
 
+        /// <summary>
+        /// Native costs of the last rendered frame, safe to call from any thread
+        /// </summary>
+        public FrameStats? GetFrameStats()
+        {
+            return FilamentLib.GetFrameStats(_app, out var stats) ? stats : null;
+        }
+
         public void Dispose()
         {
+            // Waits and destroys the fences of the frames still in flight
+            if (_options.FramesInFlight > 0)
+                SetFramesInFlight(_app, 0);
         }
 
         public Texture2D? GetDepth()
@@ -222,7 +266,7 @@ namespace XrEngine.Filament
             return obj.Id;
         }
 
-        internal unsafe TextureInfo AllocateTexture(Texture2D? texture)
+        internal unsafe TextureInfo AllocateTexture(Texture2D? texture, bool skipUploaded = false)
         {
             var result = new TextureInfo();
 
@@ -287,6 +331,15 @@ namespace XrEngine.Filament
 
                 if (texture.Data != null)
                 {
+                    var version = (ulong)texture.Version + 1;
+
+                    // Already in the native texture: referenced by id, nothing copied
+                    if (skipUploaded && _textureVersions.TryGetValue(texture.Id, out var uploaded) && uploaded == version)
+                        return result;
+
+                    result.Data.Version = version;
+                    _textureVersions[texture.Id] = version;
+
                     var mainData = texture.Data[0];
 
                     if (mainData.Compression != TextureCompressionFormat.Uncompressed)
@@ -339,10 +392,14 @@ namespace XrEngine.Filament
                     result.Data.DataSize = mainData.Data!.Size;
                     result.Data.Data = Allocate(result.Data.DataSize);
                     result.Data.AutoFree = true;
-                    result.Data.IsBgr = mainData.Format == TextureFormat.Bgra32 || mainData.Format == TextureFormat.SBgra32;
 
                     using var pSrc = mainData.Data.MemoryLock();
-                    EngineNativeLib.CopyMemory(pSrc, result.Data.Data, mainData.Data.Size);
+
+                    // Swap to RGBA while copying, instead of a second pass over the data on the native side
+                    if (mainData.Format.IsBgr() && mainData.Compression == TextureCompressionFormat.Uncompressed)
+                        EngineNativeLib.ImageSwizzle(pSrc, (byte*)result.Data.Data, mainData.Width, mainData.Height, 0, 0, SwizzleFormat.Rgba8, SwizzleFormat.Rgba8, SwizzleMask.SwapRB);
+                    else
+                        EngineNativeLib.CopyMemory(pSrc, result.Data.Data, mainData.Data.Size);
                 }
             }
 
@@ -371,12 +428,12 @@ namespace XrEngine.Filament
 
             var info = GetInfo();
 
-            AddLight(_app, id, ref info);
+            _handles[id] = AddLight(_app, id, ref info);
 
             sun.Changed += (s, e) =>
             {
                 info = GetInfo();
-                UpdateLight(_app, id, ref info);
+                _commands.UpdateLight(_handles[id], info);
             };
         }
 
@@ -390,7 +447,7 @@ namespace XrEngine.Filament
                 Color = dir.Color,
                 CastShadows = dir.CastShadows,
             };
-            AddLight(_app, id, ref info);
+            _handles[id] = AddLight(_app, id, ref info);
         }
 
         protected void Create(Guid id, ImageLight img)
@@ -422,7 +479,7 @@ namespace XrEngine.Filament
 
         protected void Create(Guid id, Group3D group)
         {
-            AddGroup(_app, id);
+            _handles[id] = AddGroup(_app, id);
 
             UpdateHierarchy(group);
 
@@ -494,13 +551,24 @@ namespace XrEngine.Filament
                         VerticesCount = geo.Vertices!.Length,
                         Indices = pIndex,
                         IndicesCount = pIndex == null ? 0 : geo.Indices!.Length,
-                        Primitive = PrimitiveType.TRIANGLES
+                        Primitive = PrimitiveType.TRIANGLES,
+                        Quantize = _options.QuantizeGeometry
                     };
 
                     if (updateMode)
                         UpdateMeshGeometry(_app, meshId, geoId, ref geoInfo);
                     else
+                    {
+                        // The first upload reads the arrays in place, pinned until the driver releases them.
+                        // Updates keep copying, the arrays may be edited again before the upload happens
+                        geoInfo.Upload = GeometryUpload.Borrowed;
+                        geoInfo.Release = &ReleasePinned;
+                        geoInfo.VerticesUser = GCHandle.ToIntPtr(GCHandle.Alloc(geo.Vertices, GCHandleType.Pinned));
+                        if (pIndex != null)
+                            geoInfo.IndicesUser = GCHandle.ToIntPtr(GCHandle.Alloc(geo.Indices, GCHandleType.Pinned));
+
                         AddGeometry(_app, geoId, ref geoInfo);
+                    }
                 }
             }
 
@@ -513,6 +581,12 @@ namespace XrEngine.Filament
             };
         }
 
+        [UnmanagedCallersOnly(CallConvs = [typeof(CallConvCdecl)])]
+        static unsafe void ReleasePinned(void* buffer, void* user)
+        {
+            GCHandle.FromIntPtr((nint)user).Free();
+        }
+
         protected void Create(Guid id, Material mat)
         {
 
@@ -522,11 +596,11 @@ namespace XrEngine.Filament
                 {
                     return new MaterialInfo
                     {
-                        NormalMap = AllocateTexture(pbr.NormalMap),
+                        NormalMap = AllocateTexture(pbr.NormalMap, true),
                         Color = pbr.Color,
-                        BaseColorMap = AllocateTexture(pbr.ColorMap),
-                        MetallicRoughnessMap = AllocateTexture(pbr.MetallicRoughnessMap),
-                        AoMap = AllocateTexture(pbr.OcclusionMap),
+                        BaseColorMap = AllocateTexture(pbr.ColorMap, true),
+                        MetallicRoughnessMap = AllocateTexture(pbr.MetallicRoughnessMap, true),
+                        AoMap = AllocateTexture(pbr.OcclusionMap, true),
                         MetallicFactor = pbr.Metalness,
                         RoughnessFactor = pbr.Roughness,
                         NormalScale = pbr.NormalScale,
@@ -598,7 +672,7 @@ namespace XrEngine.Filament
                             AlphaMode.Mask => FlBlendingMode.MASKED,
                             _ => throw new NotSupportedException()
                         },
-                        BaseColorMap = AllocateTexture(tex.Texture),
+                        BaseColorMap = AllocateTexture(tex.Texture, true),
                         Color = Color.White,
                         DoubleSided = tex.DoubleSided,
                         IsLit = false,
@@ -634,19 +708,21 @@ namespace XrEngine.Filament
             }
 
             var matInfo = UpdateMatInfo();
-            AddMaterial(_app, mat.Id, ref matInfo);
+            _handles[mat.Id] = _options.AsyncMaterials ?
+                AddMaterialAsync(_app, mat.Id, ref matInfo) :
+                AddMaterial(_app, mat.Id, ref matInfo);
 
             mat.Changed += (s, c) =>
             {
                 if (c.IsAny(ObjectChangeType.MaterialEnabled))
                 {
                     foreach (var host in mat.Hosts.OfType<Object3D>())
-                        SetObjVisible(_app, host.Id, host.IsVisible && mat.IsEnabled);
+                        SetVisible(host, host.IsVisible && mat.IsEnabled);
                 }
                 else
                 {
                     matInfo = UpdateMatInfo();
-                    UpdateMaterial(_app, mat.Id, ref matInfo);
+                    _commands.UpdateMaterial(_handles[mat.Id], matInfo);
                 }
             };
 
@@ -657,8 +733,9 @@ namespace XrEngine.Filament
                     var texInfo = AllocateTexture(tex.Texture);
                     if (!UpdateTexture(_app, tex.Texture.Id, ref texInfo.Data))
                     {
+                        _textureVersions.Remove(tex.Texture.Id);
                         matInfo = UpdateMatInfo();
-                        UpdateMaterial(_app, mat.Id, ref matInfo);
+                        _commands.UpdateMaterial(_handles[mat.Id], matInfo);
                     }
                 };
             }
@@ -710,7 +787,8 @@ namespace XrEngine.Filament
                         VerticesCount = mesh.Vertices.Length,
                         Indices = null,
                         IndicesCount = 0,
-                        Primitive = PrimitiveType.LINES
+                        Primitive = PrimitiveType.LINES,
+                        Quantize = _options.QuantizeGeometry
                     };
 
                     if (isUpdate)
@@ -732,7 +810,7 @@ namespace XrEngine.Filament
                 CastShadows = false,
             };
 
-            AddMesh(_app, id, ref meshInfo);
+            _handles[id] = AddMesh(_app, id, ref meshInfo);
 
             UpdateHierarchy(mesh);
 
@@ -761,7 +839,7 @@ namespace XrEngine.Filament
             if (mesh.Materials[0] is IShadowMaterial pbr)
                 meshInfo.CastShadows = pbr.CastShadows;
 
-            AddMesh(_app, id, ref meshInfo);
+            _handles[id] = AddMesh(_app, id, ref meshInfo);
 
             UpdateHierarchy(mesh);
 
@@ -770,22 +848,50 @@ namespace XrEngine.Filament
                 if (c.IsAny(ObjectChangeType.Render) && mesh.Materials.Count > 0)
                 {
                     var matId = GetOrCreate(mesh.Materials[0], matId => Create(matId, mesh.Materials[0]));
-                    SetMeshMaterial(_app, id, matId);
+                    _commands.SetMeshMaterial(GetHandle(id), GetHandle(matId));
                 }
 
                 OnObjectChanged((Object3D)s, c);
             };
         }
 
+        protected void QueueTransform(Object3D obj)
+        {
+            // Last write wins, the whole batch is sent in one call before rendering
+            if (_pendingTransformIndex.TryGetValue(obj.Id, out var index))
+            {
+                _pendingTransforms[index] = obj.Transform.Matrix;
+                return;
+            }
+
+            _pendingTransformIndex[obj.Id] = _pendingTransformIds.Count;
+            _pendingTransformIds.Add(obj.Id);
+            _pendingTransforms.Add(obj.Transform.Matrix);
+        }
+
+        protected unsafe void FlushTransforms()
+        {
+            if (_pendingTransformIds.Count == 0)
+                return;
+
+            fixed (Guid* pIds = CollectionsMarshal.AsSpan(_pendingTransformIds))
+            fixed (Matrix4x4* pMatrices = CollectionsMarshal.AsSpan(_pendingTransforms))
+                SetObjTransforms(_app, pIds, pMatrices, (uint)_pendingTransformIds.Count);
+
+            _pendingTransformIds.Clear();
+            _pendingTransforms.Clear();
+            _pendingTransformIndex.Clear();
+        }
+
         protected void OnObjectChanged(Object3D obj, ObjectChange change)
         {
             if (change.IsAny(ObjectChangeType.Transform))
-                SetObjTransform(_app, obj.Id, obj.Transform.Matrix);
+                QueueTransform(obj);
 
             if (change.IsAny(ObjectChangeType.Visibility))
             {
                 foreach (var item in obj.DescendantsOrSelf())
-                    SetObjVisible(_app, item.Id, item.IsVisible);
+                    SetVisible(item, item.IsVisible);
             }
 
         }
@@ -793,10 +899,22 @@ namespace XrEngine.Filament
         protected void UpdateHierarchy(Object3D obj)
         {
             if (obj.Parent != null && obj.Parent is not Scene3D)
-                SetObjParent(_app, obj.Id, obj.Parent.Id);
+                _commands.SetParent(GetHandle(obj.Id), GetHandle(obj.Parent.Id));
+
+            QueueTransform(obj);
+            SetVisible(obj, obj.IsVisible);
+        }
+
+        protected uint GetHandle(Guid id)
+        {
+            return _handles.TryGetValue(id, out var handle) ? handle : 0;
+        }
 
-            SetObjTransform(_app, obj.Id, obj.Transform.Matrix);
-            SetObjVisible(_app, obj.Id, obj.IsVisible);
+        protected void SetVisible(Object3D obj, bool visible)
+        {
+            var handle = GetHandle(obj.Id);
+            if (handle != 0)
+                _commands.SetVisible(handle, visible);
         }
 
         protected void Create(Guid id, Object3D obj)
@@ -907,6 +1025,8 @@ namespace XrEngine.Filament
             render[0].ViewId = _activeRenderTarget.ViewId;
             render[0].Viewport = viewport;
 
+            FlushTransforms();
+
             FilamentLib.Render(_app, render, 1, flush);
 
             _viewport = viewport;
@@ -937,6 +1057,8 @@ namespace XrEngine.Filament
 
         public FlBackend Driver => _driver;
 
+        public FilamentCommandRing Commands => _commands;
+
         public Rect2I View => _viewport;
 
         public IDispatcher Dispatcher => _dispatcher;
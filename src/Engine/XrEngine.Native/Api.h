@@ -1,15 +1,104 @@
 #pragma once
 
+struct ResizePlan;
 
+enum ResizeFlags {
+	RESIZE_SRGB = 1
+};
+
+// Pixel layouts for ImageSwizzle, the value is the channel count
+enum SwizzleFormat {
+	SWIZZLE_R8 = 1,
+	SWIZZLE_RG8 = 2,
+	SWIZZLE_RGB8 = 3,
+	SWIZZLE_RGBA8 = 4
+};
+
+// Swizzle mask: 4 bits per dst channel, source channel index or one of these constants
+enum SwizzleSource {
+	SWIZZLE_ZERO = 4,
+	SWIZZLE_ONE = 5
+};
+
+#define SWIZZLE_MASK(r, g, b, a) ((r) | ((g) << 4) | ((b) << 8) | ((a) << 12))
+#define SWIZZLE_IDENTITY SWIZZLE_MASK(0, 1, 2, 3)
+#define SWIZZLE_SWAP_RB SWIZZLE_MASK(2, 1, 0, 3)
+
+enum FlipConvertFlags {
+	FLIP_CONVERT_FLIP_Y = 1,
+	FLIP_CONVERT_SWAP_RB = 2,
+	FLIP_CONVERT_UNPREMULTIPLY = 4
+};
+
+// One rectangle of CopyRects2D, a negative stride walks the rows bottom up
+struct CopyRect2DDesc {
+	const uint8_t* src;
+	uint8_t* dst;
+	int32_t srcStride;
+	int32_t dstStride;
+	uint32_t rowBytes;
+	uint32_t rows;
+};
+
+enum PackSourceType {
+	PACK_U8 = 0,
+	PACK_U16 = 1,
+	PACK_F32 = 2
+};
+
+// One channel of ImagePackChannels, data null uses constant [0..1]
+struct PackChannelSource {
+	const void* data;
+	uint32_t stride;
+	uint32_t pixelSize;
+	uint32_t offset;
+	uint32_t type;
+	float constant;
+};
+
+enum MipChainFlags {
+	MIP_SRGB = 1,
+	MIP_KAISER = 2,
+	MIP_PRESERVE_COVERAGE = 4
+};
+
+enum BlurFlags {
+	BLUR_FLOAT = 1,
+	BLUR_BOX = 2
+};
+
+struct JobGroup;
+
+typedef void (APIENTRY* JobFunc)(void* data);
+
+typedef void (APIENTRY* JobRangeFunc)(void* data, uint32_t begin, uint32_t end);
+
+struct PeriodicTimer;
+
+struct TimerStats {
+	uint64_t ticks;
+	uint64_t missed;
+	int64_t minLatenessNs;
+	int64_t maxLatenessNs;
+	int64_t p99LatenessNs;
+	int64_t totalLatenessNs;
+	int64_t spinNs;
+};
 
 extern "C" {
 
 	EXPORT void APIENTRY ImageFlipY(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, uint32_t rowSize);
 
+	EXPORT void APIENTRY ImageFlipConvert(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, uint32_t srcStride, uint32_t dstStride, uint32_t flags);
+
 	EXPORT void APIENTRY ImageCopyChannel(uint8_t* src, uint8_t* dst, const uint32_t width, uint32_t height, const uint32_t srcRowSize, const uint32_t dstRowSize, const  uint32_t srcOfs, const uint32_t dstOfs, const uint32_t cSize);
 
 	EXPORT void APIENTRY CopyMemory2(uint8_t* src, uint8_t* dst, uint32_t size);
 
+	EXPORT void APIENTRY CopyRect2D(const uint8_t* src, int32_t srcStride, uint8_t* dst, int32_t dstStride, uint32_t rowBytes, uint32_t rows);
+
+	EXPORT void APIENTRY CopyRects2D(const CopyRect2DDesc* rects, uint32_t count);
+
 	EXPORT int APIENTRY CompareMemory(uint8_t* src, uint8_t* dst, uint32_t size);
 
 	EXPORT void APIENTRY ImagePack(uint32_t srcWidth, uint32_t srcHeight, char* srcData, uint32_t dstWidth, uint32_t dstHeight, char* dstData, uint32_t pixelSize);
@@ -21,9 +110,60 @@ extern "C" {
 		uint32_t dstW, uint32_t dstH, uint8_t* dst,
 		uint32_t channels);
 
+	EXPORT void APIENTRY ImageResizeBilinearSrgbU8(
+		uint32_t srcW, uint32_t srcH, const uint8_t* src,
+		uint32_t dstW, uint32_t dstH, uint8_t* dst,
+		uint32_t channels);
+
+	EXPORT ResizePlan* APIENTRY CreateResizePlan(uint32_t srcW, uint32_t srcH, uint32_t dstW, uint32_t dstH, uint32_t channels, uint32_t flags);
+
+	EXPORT void APIENTRY ExecuteResizePlan(ResizePlan* plan, const uint8_t* src, uint8_t* dst);
+
+	EXPORT void APIENTRY DestroyResizePlan(ResizePlan* plan);
+
+	EXPORT void APIENTRY ImageSwizzle(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, uint32_t srcStride, uint32_t dstStride, uint32_t srcFormat, uint32_t dstFormat, uint32_t swizzleMask);
+
+	EXPORT void APIENTRY ImagePackChannels(const PackChannelSource* sources, uint32_t sourceCount, uint8_t* dst, uint32_t width, uint32_t height, uint32_t dstStride);
+
+	EXPORT uint32_t APIENTRY ImageBuildMipChain(const uint8_t* src, uint32_t width, uint32_t height, uint32_t channels, uint32_t flags, uint8_t* dst, uint32_t* levelOffsets, float alphaCutoff);
+
+	EXPORT void APIENTRY ImageBlur(const void* src, void* dst, uint32_t width, uint32_t height, uint32_t channels, uint32_t srcStride, uint32_t dstStride, float sigma, uint32_t flags);
+
 	EXPORT void SleepUntil(uint64_t timeNs);
 
 	EXPORT void SleepFor(uint64_t timeNs);
 
 	EXPORT uint64_t Now();
+
+	EXPORT PeriodicTimer* APIENTRY TimerCreate(uint64_t periodNs);
+
+	EXPORT uint32_t APIENTRY TimerWaitNext(PeriodicTimer* timer);
+
+	EXPORT void APIENTRY TimerGetStats(PeriodicTimer* timer, TimerStats* stats, bool reset);
+
+	EXPORT void APIENTRY TimerReset(PeriodicTimer* timer);
+
+	EXPORT void APIENTRY TimerDestroy(PeriodicTimer* timer);
+
+	EXPORT bool APIENTRY JobsInit(uint32_t threads, uint64_t affinityMask);
+
+	EXPORT void APIENTRY JobsShutdown();
+
+	EXPORT uint32_t APIENTRY JobsGetThreadCount();
+
+	EXPORT uint64_t APIENTRY JobsGetBigCoreMask();
+
+	EXPORT void APIENTRY JobsParallelFor(uint32_t count, uint32_t minBatch, JobRangeFunc func, void* data);
+
+	EXPORT JobGroup* APIENTRY JobGroupCreate();
+
+	EXPORT void APIENTRY JobGroupRun(JobGroup* group, JobFunc func, void* data);
+
+	EXPORT void APIENTRY JobGroupParallelFor(JobGroup* group, uint32_t count, uint32_t minBatch, JobRangeFunc func, void* data);
+
+	EXPORT bool APIENTRY JobGroupWait(JobGroup* group);
+
+	EXPORT void APIENTRY JobGroupCancel(JobGroup* group);
+
+	EXPORT void APIENTRY JobGroupDestroy(JobGroup* group);
 }
\ No newline at end of file
@@ -0,0 +1,376 @@
+#include "pch.h"
+#include "Simd.h"
+#include "Parallel.h"
+
+// Minimum columns of the strips transposed for the vertical pass
+#define BLUR_TILE 16
+
+// Above this sigma the Gaussian is approximated by three box passes (constant cost per pixel)
+#define BLUR_BOX_MIN_SIGMA 4.0f
+
+#define BLUR_BOX_PASSES 3
+
+// Images smaller than this are blurred on the calling thread only
+#define BLUR_MIN_BAND_BYTES (256 * 1024)
+
+struct BlurKernel {
+	// Exact Gaussian: weights[0] is the center, weights[k] is used for both -k and +k
+	std::vector<float> weights;
+	// Box approximation: radius of each pass, empty when the exact taps are used
+	std::vector<uint32_t> boxRadius;
+	// Pixels read past each side of the row
+	uint32_t pad;
+};
+
+static void BuildBlurKernel(BlurKernel& kernel, float sigma, bool box)
+{
+	if (box || sigma >= BLUR_BOX_MIN_SIGMA) {
+
+		// Box widths whose sequence has the variance of the Gaussian (Kovesi, "Fast almost-Gaussian filtering")
+		const float n = BLUR_BOX_PASSES;
+		int32_t wl = static_cast<int32_t>(std::floor(std::sqrt(12.0f * sigma * sigma / n + 1.0f)));
+		if (wl % 2 == 0)
+			wl--;
+		wl = std::max(1, wl);
+		const int32_t wu = wl + 2;
+		const float m = std::round((12.0f * sigma * sigma - n * wl * wl - 4.0f * n * wl - 3.0f * n) / (-4.0f * wl - 4.0f));
+
+		kernel.pad = 0;
+		for (int32_t i = 0; i < BLUR_BOX_PASSES; i++) {
+			const uint32_t radius = static_cast<uint32_t>(((i < m ? wl : wu) - 1) / 2);
+			kernel.boxRadius.push_back(radius);
+			kernel.pad = std::max(kernel.pad, radius + 1);
+		}
+		return;
+	}
+
+	const uint32_t radius = std::max(1u, static_cast<uint32_t>(std::ceil(sigma * 3.0f)));
+
+	kernel.weights.resize(radius + 1);
+
+	float sum = 0;
+	for (uint32_t k = 0; k <= radius; k++) {
+		kernel.weights[k] = std::exp(-0.5f * (k * k) / (sigma * sigma));
+		sum += k == 0 ? kernel.weights[k] : 2 * kernel.weights[k];
+	}
+
+	for (auto& w : kernel.weights)
+		w /= sum;
+
+	kernel.pad = radius;
+}
+
+// Replicates the first and last pixel over the pad area, row points to the first real pixel
+static void PadRow(float* row, uint32_t width, uint32_t channels, uint32_t pad)
+{
+	for (uint32_t i = 1; i <= pad; i++) {
+		memcpy(row - i * channels, row, channels * sizeof(float));
+		memcpy(row + (width - 1 + i) * channels, row + (width - 1) * channels, channels * sizeof(float));
+	}
+}
+
+static void GaussianRow(const float* src, float* dst, uint32_t width, uint32_t channels, const std::vector<float>& weights)
+{
+	const uint32_t count = width * channels;
+	const uint32_t radius = static_cast<uint32_t>(weights.size()) - 1;
+	const float* w = weights.data();
+
+	uint32_t j = 0;
+
+#if defined(XR_SSE)
+
+	for (; j + 4 <= count; j += 4) {
+		__m128 acc = _mm_mul_ps(_mm_set1_ps(w[0]), _mm_loadu_ps(src + j));
+		for (uint32_t k = 1; k <= radius; k++) {
+			const __m128 pair = _mm_add_ps(_mm_loadu_ps(src + j + k * channels), _mm_loadu_ps(src + j - k * channels));
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), pair));
+		}
+		_mm_storeu_ps(dst + j, acc);
+	}
+
+#elif defined(XR_NEON)
+
+	for (; j + 4 <= count; j += 4) {
+		float32x4_t acc = vmulq_n_f32(vld1q_f32(src + j), w[0]);
+		for (uint32_t k = 1; k <= radius; k++) {
+			const float32x4_t pair = vaddq_f32(vld1q_f32(src + j + k * channels), vld1q_f32(src + j - k * channels));
+			acc = vmlaq_n_f32(acc, pair, w[k]);
+		}
+		vst1q_f32(dst + j, acc);
+	}
+
+#endif
+
+	for (; j < count; j++) {
+		const float* s = src + j;
+		float acc = w[0] * s[0];
+		for (uint32_t k = 1; k <= radius; k++) {
+			const ptrdiff_t offset = static_cast<ptrdiff_t>(k * channels);
+			acc += w[k] * (s[offset] + s[-offset]);
+		}
+		dst[j] = acc;
+	}
+}
+
+// Sliding window sum, src needs radius + 1 pixels of pad on both sides
+static void BoxRow(const float* src, float* dst, uint32_t width, uint32_t channels, uint32_t radius)
+{
+	const float scale = 1.0f / (2 * radius + 1);
+	const int32_t r = static_cast<int32_t>(radius);
+
+#if defined(XR_SSE) || defined(XR_NEON)
+
+	// One 4 channel pixel per register, the running sums of all channels advance together
+	if (channels == 4) {
+
+#if defined(XR_SSE)
+		__m128 sum = _mm_setzero_ps();
+		for (int32_t k = -r; k <= r; k++)
+			sum = _mm_add_ps(sum, _mm_loadu_ps(src + k * 4));
+
+		const __m128 vscale = _mm_set1_ps(scale);
+		for (int32_t x = 0; x < static_cast<int32_t>(width); x++) {
+			_mm_storeu_ps(dst + x * 4, _mm_mul_ps(sum, vscale));
+			sum = _mm_add_ps(sum, _mm_sub_ps(_mm_loadu_ps(src + (x + r + 1) * 4), _mm_loadu_ps(src + (x - r) * 4)));
+		}
+#else
+		float32x4_t sum = vdupq_n_f32(0);
+		for (int32_t k = -r; k <= r; k++)
+			sum = vaddq_f32(sum, vld1q_f32(src + k * 4));
+
+		for (int32_t x = 0; x < static_cast<int32_t>(width); x++) {
+			vst1q_f32(dst + x * 4, vmulq_n_f32(sum, scale));
+			sum = vaddq_f32(sum, vsubq_f32(vld1q_f32(src + (x + r + 1) * 4), vld1q_f32(src + (x - r) * 4)));
+		}
+#endif
+		return;
+	}
+
+#endif
+
+	for (uint32_t c = 0; c < channels; c++) {
+
+		const float* s = src + c;
+		float* d = dst + c;
+
+		float sum = 0;
+		for (int32_t k = -r; k <= r; k++)
+			sum += s[k * static_cast<int32_t>(channels)];
+
+		for (uint32_t x = 0; x < width; x++) {
+			d[x * channels] = sum * scale;
+			sum += s[(static_cast<int32_t>(x) + r + 1) * static_cast<int32_t>(channels)] - s[(static_cast<int32_t>(x) - r) * static_cast<int32_t>(channels)];
+		}
+	}
+}
+
+// Blurs a padded row (pad pixels writable on both sides of in and scratch), returns in or scratch
+static const float* BlurRow(float* in, float* scratch, const BlurKernel& kernel, uint32_t width, uint32_t channels)
+{
+	PadRow(in, width, channels, kernel.pad);
+
+	if (kernel.boxRadius.empty()) {
+		GaussianRow(in, scratch, width, channels, kernel.weights);
+		return scratch;
+	}
+
+	for (size_t i = 0; i < kernel.boxRadius.size(); i++) {
+		if (i > 0)
+			PadRow(in, width, channels, kernel.pad);
+		BoxRow(in, scratch, width, channels, kernel.boxRadius[i]);
+		std::swap(in, scratch);
+	}
+
+	return in;
+}
+
+static void LoadRowU8(const uint8_t* src, float* dst, uint32_t count)
+{
+	uint32_t i = 0;
+
+#if defined(XR_SSE)
+
+	for (; i + 4 <= count; i += 4) {
+		int32_t bytes;
+		memcpy(&bytes, src + i, 4);
+		_mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes))));
+	}
+
+#elif defined(XR_NEON)
+
+	for (; i + 8 <= count; i += 8) {
+		const uint16x8_t v = vmovl_u8(vld1_u8(src + i));
+		vst1q_f32(dst + i, vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))));
+		vst1q_f32(dst + i + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))));
+	}
+
+#endif
+
+	for (; i < count; i++)
+		dst[i] = src[i];
+}
+
+static inline uint8_t StoreU8(float v)
+{
+	return static_cast<uint8_t>(std::clamp(v + 0.5f, 0.0f, 255.0f));
+}
+
+static void StoreRowU8(const float* src, uint8_t* dst, uint32_t count)
+{
+	uint32_t i = 0;
+
+#if defined(XR_SSE)
+
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (; i + 16 <= count; i += 16) {
+		const __m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(src + i), half));
+		const __m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(src + i + 4), half));
+		const __m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(src + i + 8), half));
+		const __m128i d = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(src + i + 12), half));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+	}
+
+#elif defined(XR_NEON)
+
+	for (; i + 8 <= count; i += 8) {
+		const uint32x4_t a = vcvtq_u32_f32(vaddq_f32(vmaxq_f32(vld1q_f32(src + i), vdupq_n_f32(0)), vdupq_n_f32(0.5f)));
+		const uint32x4_t b = vcvtq_u32_f32(vaddq_f32(vmaxq_f32(vld1q_f32(src + i + 4), vdupq_n_f32(0)), vdupq_n_f32(0.5f)));
+		vst1_u8(dst + i, vqmovn_u16(vcombine_u16(vqmovn_u32(a), vqmovn_u32(b))));
+	}
+
+#endif
+
+	for (; i < count; i++)
+		dst[i] = StoreU8(src[i]);
+}
+
+static void LoadRow(const uint8_t* src, float* dst, uint32_t count, bool isFloat)
+{
+	if (isFloat)
+		memcpy(dst, src, count * sizeof(float));
+	else
+		LoadRowU8(src, dst, count);
+}
+
+static void StoreRow(const float* src, uint8_t* dst, uint32_t count, bool isFloat)
+{
+	if (isFloat)
+		memcpy(dst, src, count * sizeof(float));
+	else
+		StoreRowU8(src, dst, count);
+}
+
+static void BlurImage(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, uint32_t channels, uint32_t srcStride, uint32_t dstStride, const BlurKernel& kernel, bool isFloat)
+{
+	const uint32_t pixelBytes = channels * (isFloat ? 4 : 1);
+	const uint32_t pad = kernel.pad * channels;
+
+	// Vertical: a strip of columns is gathered transposed (columns become contiguous rows), blurred with
+	// the same row kernel and scattered back to dst. Strips are at least a cache line wide.
+	const uint32_t stripCols = std::max<uint32_t>(BLUR_TILE, 64 / pixelBytes);
+	const uint32_t minStrips = std::max(1u, BLUR_MIN_BAND_BYTES / (height * pixelBytes * stripCols));
+
+	// Columns are padded for the kernel, plus a few floats so they don't all map to the same cache sets
+	const size_t columnStride = static_cast<size_t>(height) * channels + 2 * pad + 16;
+
+	ParallelFor((width + stripCols - 1) / stripCols, minStrips, [&](uint32_t begin, uint32_t end) {
+
+		std::vector<float> tile(static_cast<size_t>(BLUR_TILE) * stripCols * channels);
+		std::vector<float> strip(stripCols * columnStride);
+		std::vector<float> scratch(columnStride);
+
+		for (uint32_t s = begin; s < end; s++) {
+
+			const uint32_t x0 = s * stripCols;
+			const uint32_t cols = std::min(stripCols, width - x0);
+			const uint32_t count = cols * channels;
+
+			// Transposed a BLUR_TILE x cols tile at a time, each column receives a contiguous run
+			for (uint32_t y0 = 0; y0 < height; y0 += BLUR_TILE) {
+
+				const uint32_t rows = std::min<uint32_t>(BLUR_TILE, height - y0);
+
+				for (uint32_t j = 0; j < rows; j++)
+					LoadRow(src + static_cast<size_t>(y0 + j) * srcStride + static_cast<size_t>(x0) * pixelBytes, tile.data() + j * count, count, isFloat);
+
+				for (uint32_t i = 0; i < cols; i++) {
+					float* out = strip.data() + i * columnStride + pad + static_cast<size_t>(y0) * channels;
+					for (uint32_t j = 0; j < rows; j++) {
+						for (uint32_t c = 0; c < channels; c++)
+							out[j * channels + c] = tile[j * count + i * channels + c];
+					}
+				}
+			}
+
+			for (uint32_t i = 0; i < cols; i++) {
+				float* column = strip.data() + i * columnStride + pad;
+				const float* result = BlurRow(column, scratch.data() + pad, kernel, height, channels);
+				if (result != column)
+					memcpy(column, result, height * channels * sizeof(float));
+			}
+
+			for (uint32_t y0 = 0; y0 < height; y0 += BLUR_TILE) {
+
+				const uint32_t rows = std::min<uint32_t>(BLUR_TILE, height - y0);
+
+				for (uint32_t i = 0; i < cols; i++) {
+					const float* in = strip.data() + i * columnStride + pad + static_cast<size_t>(y0) * channels;
+					for (uint32_t j = 0; j < rows; j++) {
+						for (uint32_t c = 0; c < channels; c++)
+							tile[j * count + i * channels + c] = in[j * channels + c];
+					}
+				}
+
+				for (uint32_t j = 0; j < rows; j++)
+					StoreRow(tile.data() + j * count, dst + static_cast<size_t>(y0 + j) * dstStride + static_cast<size_t>(x0) * pixelBytes, count, isFloat);
+			}
+		}
+	});
+
+	// Horizontal: in place on dst rows. For u8 the vertical result is rounded in between (under 0.5 LSB).
+	const uint32_t minRows = std::max(1u, BLUR_MIN_BAND_BYTES / (width * pixelBytes));
+
+	ParallelFor(height, minRows, [&](uint32_t begin, uint32_t end) {
+
+		std::vector<float> row(static_cast<size_t>(width) * channels + 2 * pad);
+		std::vector<float> scratch(row.size());
+
+		for (uint32_t y = begin; y < end; y++) {
+			uint8_t* dstRow = dst + static_cast<size_t>(y) * dstStride;
+			LoadRow(dstRow, row.data() + pad, width * channels, isFloat);
+			StoreRow(BlurRow(row.data() + pad, scratch.data() + pad, kernel, width, channels), dstRow, width * channels, isFloat);
+		}
+	});
+}
+
+void ImageBlur(const void* src, void* dst, uint32_t width, uint32_t height, uint32_t channels, uint32_t srcStride, uint32_t dstStride, float sigma, uint32_t flags)
+{
+	if (!src || !dst || width == 0 || height == 0 || channels == 0)
+		return;
+
+	const bool isFloat = (flags & BLUR_FLOAT) != 0;
+	const uint32_t rowBytes = width * channels * (isFloat ? 4 : 1);
+
+	if (srcStride == 0)
+		srcStride = rowBytes;
+
+	if (dstStride == 0)
+		dstStride = rowBytes;
+
+	if (!(sigma > 0)) {
+		if (src != dst) {
+			for (uint32_t y = 0; y < height; y++)
+				memcpy(static_cast<uint8_t*>(dst) + static_cast<size_t>(y) * dstStride, static_cast<const uint8_t*>(src) + static_cast<size_t>(y) * srcStride, rowBytes);
+		}
+		return;
+	}
+
+	BlurKernel kernel;
+	BuildBlurKernel(kernel, sigma, (flags & BLUR_BOX) != 0);
+
+	// Each strip is read whole before being written back, so src and dst may be the same image
+	if (src == dst && srcStride != dstStride)
+		return;
+
+	BlurImage(static_cast<const uint8_t*>(src), static_cast<uint8_t*>(dst), width, height, channels, srcStride, dstStride, kernel, isFloat);
+}
@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "Simd.h"
+#include "Parallel.h"
+
+#ifndef _WINDOWS
+	#include <unistd.h>
+#endif
+
+// Jobs smaller than this are copied on the calling thread only
+#define COPY_MIN_BATCH_BYTES (512 * 1024)
+
+// Used when the cache size can't be queried
+#define COPY_DEFAULT_LLC_BYTES (4 * 1024 * 1024)
+
+static size_t QueryLastLevelCacheSize()
+{
+	size_t result = 0;
+
+#if defined(_WINDOWS)
+
+	DWORD size = 0;
+	GetLogicalProcessorInformation(nullptr, &size);
+
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+
+	if (!infos.empty() && GetLogicalProcessorInformation(infos.data(), &size)) {
+		BYTE level = 0;
+		for (auto& info : infos) {
+			if (info.Relationship == RelationCache && info.Cache.Level >= level) {
+				level = info.Cache.Level;
+				result = info.Cache.Size;
+			}
+		}
+	}
+
+#else
+
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+	const long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	if (l3 > 0)
+		result = static_cast<size_t>(l3);
+#endif
+
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+	if (result == 0) {
+		const long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+		if (l2 > 0)
+			result = static_cast<size_t>(l2);
+	}
+#endif
+
+#endif
+
+	return result > 0 ? result : COPY_DEFAULT_LLC_BYTES;
+}
+
+static size_t GetLastLevelCacheSize()
+{
+	static const size_t value = QueryLastLevelCacheSize();
+	return value;
+}
+
+// Streaming copy: the destination bypasses the cache, so copying a frame larger than the LLC
+// doesn't evict the data the caller is about to use
+static void CopyRowStream(const uint8_t* src, uint8_t* dst, uint32_t bytes)
+{
+#if defined(XR_SSE)
+
+	const uint32_t head = std::min<uint32_t>(bytes, (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15);
+	memcpy(dst, src, head);
+
+	uint32_t i = head;
+	for (; i + 64 <= bytes; i += 64) {
+		const __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 16));
+		const __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 32));
+		const __m128i d = _mm_loadu_si128((const __m128i*)(src + i + 48));
+		_mm_stream_si128((__m128i*)(dst + i), a);
+		_mm_stream_si128((__m128i*)(dst + i + 16), b);
+		_mm_stream_si128((__m128i*)(dst + i + 32), c);
+		_mm_stream_si128((__m128i*)(dst + i + 48), d);
+	}
+
+	for (; i + 16 <= bytes; i += 16)
+		_mm_stream_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+
+	memcpy(dst + i, src + i, bytes - i);
+
+#else
+
+	memcpy(dst, src, bytes);
+
+#endif
+}
+
+static void CopyRows(const CopyRect2DDesc& rect, uint32_t begin, uint32_t end, bool stream)
+{
+	const uint8_t* src = rect.src + static_cast<int64_t>(begin) * rect.srcStride;
+	uint8_t* dst = rect.dst + static_cast<int64_t>(begin) * rect.dstStride;
+
+	for (uint32_t y = begin; y < end; y++) {
+		if (stream)
+			CopyRowStream(src, dst, rect.rowBytes);
+		else
+			memcpy(dst, src, rect.rowBytes);
+		src += rect.srcStride;
+		dst += rect.dstStride;
+	}
+}
+
+static void StreamFence([[maybe_unused]] bool stream)
+{
+#if defined(XR_SSE)
+	// Streaming stores are weakly ordered, make them visible before returning to the caller
+	if (stream)
+		_mm_sfence();
+#endif
+}
+
+void CopyRect2D(const uint8_t* src, int32_t srcStride, uint8_t* dst, int32_t dstStride, uint32_t rowBytes, uint32_t rows)
+{
+	CopyRect2DDesc rect = { src, dst, srcStride, dstStride, rowBytes, rows };
+	CopyRects2D(&rect, 1);
+}
+
+void CopyRects2D(const CopyRect2DDesc* rects, uint32_t count)
+{
+	if (!rects || count == 0)
+		return;
+
+	uint64_t totalBytes = 0;
+	for (uint32_t i = 0; i < count; i++)
+		totalBytes += static_cast<uint64_t>(rects[i].rowBytes) * rects[i].rows;
+
+	if (totalBytes == 0)
+		return;
+
+	const bool stream = totalBytes > GetLastLevelCacheSize();
+
+	if (count == 1) {
+		// A single large rectangle is split by rows
+		const CopyRect2DDesc& rect = rects[0];
+		const uint32_t minRows = static_cast<uint32_t>(std::max<uint64_t>(1, COPY_MIN_BATCH_BYTES / std::max(1u, rect.rowBytes)));
+
+		ParallelFor(rect.rows, minRows, [&](uint32_t begin, uint32_t end) {
+			CopyRows(rect, begin, end, stream);
+			StreamFence(stream);
+		});
+		return;
+	}
+
+	// Many rectangles (tiles) are split by rectangle, using the average size to size the batches
+	const uint64_t avgBytes = std::max<uint64_t>(1, totalBytes / count);
+	const uint32_t minRects = static_cast<uint32_t>(std::max<uint64_t>(1, COPY_MIN_BATCH_BYTES / avgBytes));
+
+	ParallelFor(count, minRects, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++)
+			CopyRows(rects[i], 0, rects[i].rows, stream);
+		StreamFence(stream);
+	});
+}
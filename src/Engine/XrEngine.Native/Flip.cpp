@@ -0,0 +1,180 @@
+#include "pch.h"
+#include "Simd.h"
+#include "Parallel.h"
+
+// Row pairs are swapped through a stack buffer of this size
+#define FLIP_TILE_BYTES 4096
+
+// Images smaller than this are flipped on the calling thread only
+#define FLIP_MIN_BAND_BYTES (256 * 1024)
+
+// c * 255 / a in 16.16, for a = 0 the color is dropped
+static const uint32_t* GetUnpremultiplyTable()
+{
+	static const uint32_t* table = [] {
+		auto result = new uint32_t[256];
+		result[0] = 0;
+		for (uint32_t a = 1; a < 256; a++)
+			result[a] = (255u * 65536u + a / 2) / a;
+		return result;
+	}();
+	return table;
+}
+
+static inline void UnpremultiplyPixel(const uint32_t* table, uint8_t* p)
+{
+	const uint32_t scale = table[p[3]];
+	for (uint32_t c = 0; c < 3; c++)
+		p[c] = static_cast<uint8_t>(std::min<uint32_t>(255, (p[c] * scale + 32768) >> 16));
+}
+
+// RGBA8 row conversion, src and dst may be the same memory
+static void ConvertRow(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t flags)
+{
+	const bool swap = (flags & FLIP_CONVERT_SWAP_RB) != 0;
+	const bool unpremultiply = (flags & FLIP_CONVERT_UNPREMULTIPLY) != 0;
+	const uint32_t* table = unpremultiply ? GetUnpremultiplyTable() : nullptr;
+
+	uint32_t x = 0;
+
+#if defined(XR_SSE)
+
+	const __m128i shuffle = swap ?
+		_mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15) :
+		_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+
+	for (; x + 4 <= width; x += 4) {
+		const __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + x * 4)), shuffle);
+		_mm_storeu_si128((__m128i*)(dst + x * 4), v);
+
+		// Opaque blocks, the common case for readbacks, need no division
+		if (unpremultiply && !_mm_test_all_ones(_mm_or_si128(v, colorMask))) {
+			for (uint32_t i = 0; i < 4; i++)
+				UnpremultiplyPixel(table, dst + (x + i) * 4);
+		}
+	}
+
+#elif defined(XR_NEON)
+
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t v = vld4q_u8(src + x * 4);
+		if (swap) {
+			const uint8x16_t r = v.val[0];
+			v.val[0] = v.val[2];
+			v.val[2] = r;
+		}
+		vst4q_u8(dst + x * 4, v);
+
+		if (unpremultiply && vminvq_u8(v.val[3]) != 255) {
+			for (uint32_t i = 0; i < 16; i++)
+				UnpremultiplyPixel(table, dst + (x + i) * 4);
+		}
+	}
+
+#endif
+
+	for (; x < width; x++) {
+		const uint8_t* s = src + x * 4;
+		uint8_t* d = dst + x * 4;
+		const uint8_t r = s[0], g = s[1], b = s[2], a = s[3];
+		d[0] = swap ? b : r;
+		d[1] = g;
+		d[2] = swap ? r : b;
+		d[3] = a;
+		if (unpremultiply && a != 255)
+			UnpremultiplyPixel(table, d);
+	}
+}
+
+typedef void (*RowFunc)(const uint8_t* src, uint8_t* dst, uint32_t bytes, uint32_t flags);
+
+static void CopyRowBytes(const uint8_t* src, uint8_t* dst, uint32_t bytes, [[maybe_unused]] uint32_t flags)
+{
+	memmove(dst, src, bytes);
+}
+
+static void ConvertRowBytes(const uint8_t* src, uint8_t* dst, uint32_t bytes, uint32_t flags)
+{
+	ConvertRow(src, dst, bytes / 4, flags);
+}
+
+// In place: rows y and height - 1 - y are exchanged a tile at a time, so no full frame copy is needed
+static void FlipInPlace(uint8_t* data, uint32_t height, uint32_t rowBytes, uint32_t stride, uint32_t flags, RowFunc row)
+{
+	const uint32_t pairs = height / 2;
+	const uint32_t minPairs = std::max(1u, FLIP_MIN_BAND_BYTES / (rowBytes * 2));
+
+	ParallelFor(pairs, minPairs, [&](uint32_t begin, uint32_t end) {
+
+		alignas(16) uint8_t tile[FLIP_TILE_BYTES];
+
+		for (uint32_t y = begin; y < end; y++) {
+
+			uint8_t* top = data + static_cast<size_t>(y) * stride;
+			uint8_t* bottom = data + static_cast<size_t>(height - 1 - y) * stride;
+
+			for (uint32_t x = 0; x < rowBytes; x += FLIP_TILE_BYTES) {
+				const uint32_t bytes = std::min<uint32_t>(FLIP_TILE_BYTES, rowBytes - x);
+				memcpy(tile, top + x, bytes);
+				row(bottom + x, top + x, bytes, flags);
+				row(tile, bottom + x, bytes, flags);
+			}
+		}
+	});
+
+	// The middle row of an odd height only needs the conversion
+	if (height % 2 != 0 && row != CopyRowBytes) {
+		uint8_t* middle = data + static_cast<size_t>(pairs) * stride;
+		row(middle, middle, rowBytes, flags);
+	}
+}
+
+static void FlipRows(const uint8_t* src, uint8_t* dst, uint32_t height, uint32_t rowBytes, uint32_t srcStride, uint32_t dstStride, uint32_t flags, RowFunc row)
+{
+	const bool flip = (flags & FLIP_CONVERT_FLIP_Y) != 0;
+	const uint32_t minRows = std::max(1u, FLIP_MIN_BAND_BYTES / rowBytes);
+
+	ParallelFor(height, minRows, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t y = begin; y < end; y++) {
+			const uint32_t dstY = flip ? height - 1 - y : y;
+			row(src + static_cast<size_t>(y) * srcStride, dst + static_cast<size_t>(dstY) * dstStride, rowBytes, flags);
+		}
+	});
+}
+
+void ImageFlipY(uint8_t* src, uint8_t* dst, [[maybe_unused]] uint32_t width, uint32_t height, uint32_t rowSize)
+{
+	if (!src || !dst || height == 0 || rowSize == 0)
+		return;
+
+	if (src == dst)
+		FlipInPlace(dst, height, rowSize, rowSize, FLIP_CONVERT_FLIP_Y, CopyRowBytes);
+	else
+		FlipRows(src, dst, height, rowSize, rowSize, rowSize, FLIP_CONVERT_FLIP_Y, CopyRowBytes);
+}
+
+void ImageFlipConvert(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, uint32_t srcStride, uint32_t dstStride, uint32_t flags)
+{
+	if (!src || !dst || width == 0 || height == 0)
+		return;
+
+	const uint32_t rowBytes = width * 4;
+
+	if (srcStride == 0)
+		srcStride = rowBytes;
+
+	if (dstStride == 0)
+		dstStride = rowBytes;
+
+	// In place only works row for row
+	if (src == dst && srcStride != dstStride)
+		return;
+
+	const RowFunc row = (flags & (FLIP_CONVERT_SWAP_RB | FLIP_CONVERT_UNPREMULTIPLY)) ? ConvertRowBytes : CopyRowBytes;
+
+	if (src == dst && srcStride == dstStride && (flags & FLIP_CONVERT_FLIP_Y))
+		FlipInPlace(dst, height, rowBytes, dstStride, flags, row);
+	else
+		FlipRows(src, dst, height, rowBytes, srcStride, dstStride, flags, row);
+}
@@ -0,0 +1,462 @@
+#include "pch.h"
+#include "Simd.h"
+#include "Srgb.h"
+#include "Parallel.h"
+
+// Levels built inside one band of level 0 rows (2^MIP_BAND_LEVELS rows), smaller levels are built after the bands
+#define MIP_BAND_LEVELS 5u
+
+#define KAISER_TAPS 8
+#define KAISER_RADIUS 4.0f
+#define KAISER_BETA 4.0f
+
+struct MipLevel {
+	uint8_t* data;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+};
+
+struct MipChain {
+	std::vector<MipLevel> levels;
+	uint32_t channels;
+	bool srgb;
+};
+
+static uint32_t MipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t count = 1;
+	while (width > 1 || height > 1) {
+		width = std::max(1u, width >> 1);
+		height = std::max(1u, height >> 1);
+		count++;
+	}
+	return count;
+}
+
+// 2x2 box filter, dst x reads src columns 2x and min(2x + 1, srcW - 1)
+
+template <uint32_t C>
+static void BoxRowTail(const uint8_t* r0, const uint8_t* r1, uint32_t srcW, uint8_t* out, uint32_t dstW, uint32_t x)
+{
+	for (; x < dstW; ++x)
+	{
+		const uint32_t x0 = (2 * x) * C;
+		const uint32_t x1 = std::min(2 * x + 1, srcW - 1) * C;
+
+		for (uint32_t c = 0; c < C; ++c)
+			out[x * C + c] = static_cast<uint8_t>((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+	}
+}
+
+template <uint32_t C>
+static void BoxRow(const uint8_t* r0, const uint8_t* r1, uint32_t srcW, uint8_t* out, uint32_t dstW)
+{
+	BoxRowTail<C>(r0, r1, srcW, out, dstW, 0);
+}
+
+template <>
+void BoxRow<1>(const uint8_t* r0, const uint8_t* r1, uint32_t srcW, uint8_t* out, uint32_t dstW)
+{
+	uint32_t x = 0;
+
+#if defined(XR_SSE)
+
+	const __m128i ones = _mm_set1_epi8(1);
+	const __m128i two = _mm_set1_epi16(2);
+
+	for (; x + 8 <= dstW && 2 * (x + 8) <= srcW; x += 8)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(r0 + 2 * x));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(r1 + 2 * x));
+		__m128i sum = _mm_add_epi16(_mm_maddubs_epi16(a, ones), _mm_maddubs_epi16(b, ones));
+		sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+		_mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(sum, sum));
+	}
+
+#elif defined(XR_NEON)
+
+	for (; x + 8 <= dstW && 2 * (x + 8) <= srcW; x += 8)
+	{
+		uint16x8_t sum = vpaddlq_u8(vld1q_u8(r0 + 2 * x));
+		sum = vpadalq_u8(sum, vld1q_u8(r1 + 2 * x));
+		vst1_u8(out + x, vrshrn_n_u16(sum, 2));
+	}
+
+#endif
+
+	BoxRowTail<1>(r0, r1, srcW, out, dstW, x);
+}
+
+template <>
+void BoxRow<4>(const uint8_t* r0, const uint8_t* r1, uint32_t srcW, uint8_t* out, uint32_t dstW)
+{
+	uint32_t x = 0;
+
+#if defined(XR_SSE)
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+
+	for (; x + 2 <= dstW && 2 * (x + 2) <= srcW; x += 2)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(r0 + x * 8));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(r1 + x * 8));
+
+		// Vertical sums of src pixels (0, 1) and (2, 3), then the two pixel pairs
+		const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+		const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+		__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+		sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+		_mm_storel_epi64((__m128i*)(out + x * 4), _mm_packus_epi16(sum, sum));
+	}
+
+#elif defined(XR_NEON)
+
+	for (; x + 4 <= dstW && 2 * (x + 4) <= srcW; x += 4)
+	{
+		// val[0] holds the even pixels, val[1] the odd ones
+		const uint32x4x2_t a = vld2q_u32((const uint32_t*)(r0 + x * 8));
+		const uint32x4x2_t b = vld2q_u32((const uint32_t*)(r1 + x * 8));
+		const uint8x16_t ae = vreinterpretq_u8_u32(a.val[0]);
+		const uint8x16_t ao = vreinterpretq_u8_u32(a.val[1]);
+		const uint8x16_t be = vreinterpretq_u8_u32(b.val[0]);
+		const uint8x16_t bo = vreinterpretq_u8_u32(b.val[1]);
+
+		const uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(ae), vget_low_u8(ao)), vaddl_u8(vget_low_u8(be), vget_low_u8(bo)));
+		const uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(ae), vget_high_u8(ao)), vaddl_u8(vget_high_u8(be), vget_high_u8(bo)));
+
+		vst1q_u8(out + x * 4, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+	}
+
+#endif
+
+	BoxRowTail<4>(r0, r1, srcW, out, dstW, x);
+}
+
+static void BoxRowAny(const uint8_t* r0, const uint8_t* r1, uint32_t srcW, uint8_t* out, uint32_t dstW, uint32_t channels)
+{
+	for (uint32_t x = 0; x < dstW; ++x)
+	{
+		const uint32_t x0 = (2 * x) * channels;
+		const uint32_t x1 = std::min(2 * x + 1, srcW - 1) * channels;
+
+		for (uint32_t c = 0; c < channels; ++c)
+			out[x * channels + c] = static_cast<uint8_t>((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+	}
+}
+
+// Color channels averaged in linear light, alpha as is
+static void BoxRowSrgb(const uint8_t* r0, const uint8_t* r1, uint32_t srcW, uint8_t* out, uint32_t dstW, uint32_t channels)
+{
+	const SrgbTables& tables = GetSrgbTables();
+	const uint32_t colors = SrgbColorChannels(channels);
+
+	for (uint32_t x = 0; x < dstW; ++x)
+	{
+		const uint32_t x0 = (2 * x) * channels;
+		const uint32_t x1 = std::min(2 * x + 1, srcW - 1) * channels;
+
+		uint32_t c = 0;
+		for (; c < colors; ++c)
+		{
+			const uint32_t sum = tables.toLinear16[r0[x0 + c]] + tables.toLinear16[r0[x1 + c]] +
+				tables.toLinear16[r1[x0 + c]] + tables.toLinear16[r1[x1 + c]];
+			out[x * channels + c] = SrgbEncode16(tables, (sum + 2) >> 2);
+		}
+
+		for (; c < channels; ++c)
+			out[x * channels + c] = static_cast<uint8_t>((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+	}
+}
+
+static void BuildBoxRow(const MipChain& chain, uint32_t level, uint32_t y)
+{
+	const MipLevel& src = chain.levels[level - 1];
+	const MipLevel& dst = chain.levels[level];
+
+	const uint8_t* r0 = src.data + static_cast<size_t>(2 * y) * src.stride;
+	const uint8_t* r1 = src.data + static_cast<size_t>(std::min(2 * y + 1, src.height - 1)) * src.stride;
+	uint8_t* out = dst.data + static_cast<size_t>(y) * dst.stride;
+
+	if (chain.srgb) {
+		BoxRowSrgb(r0, r1, src.width, out, dst.width, chain.channels);
+		return;
+	}
+
+	switch (chain.channels)
+	{
+	case 1: BoxRow<1>(r0, r1, src.width, out, dst.width); break;
+	case 2: BoxRow<2>(r0, r1, src.width, out, dst.width); break;
+	case 3: BoxRow<3>(r0, r1, src.width, out, dst.width); break;
+	case 4: BoxRow<4>(r0, r1, src.width, out, dst.width); break;
+	default: BoxRowAny(r0, r1, src.width, out, dst.width, chain.channels); break;
+	}
+}
+
+// Builds the levels 1..maxLevel of one band as soon as their source rows are written,
+// so every row is consumed by the next level while still in cache
+struct BoxCascade {
+	const MipChain& chain;
+	uint32_t maxLevel;
+	uint32_t next[32];
+	uint32_t end[32];
+
+	void RowDone(uint32_t level, uint32_t row)
+	{
+		const uint32_t nextLevel = level + 1;
+		if (nextLevel > maxLevel)
+			return;
+
+		const uint32_t srcH = chain.levels[level].height;
+		uint32_t& y = next[nextLevel];
+
+		while (y < end[nextLevel] && std::min(2 * y + 1, srcH - 1) <= row) {
+			const uint32_t cur = y++;
+			BuildBoxRow(chain, nextLevel, cur);
+			RowDone(nextLevel, cur);
+		}
+	}
+};
+
+static void BuildBoxChain(const MipChain& chain, const uint8_t* src)
+{
+	const uint32_t levelCount = static_cast<uint32_t>(chain.levels.size());
+	const uint32_t bandLevels = std::min(MIP_BAND_LEVELS, levelCount - 1);
+	const uint32_t bandRows = 1u << bandLevels;
+	const MipLevel& base = chain.levels[0];
+	const uint32_t bandCount = (base.height + bandRows - 1) / bandRows;
+
+	ParallelFor(bandCount, 4, [&](uint32_t begin, uint32_t end) {
+
+		for (uint32_t band = begin; band < end; band++) {
+
+			BoxCascade cascade{ chain, bandLevels, {}, {} };
+
+			for (uint32_t l = 0; l <= bandLevels; l++) {
+				const uint32_t rows = bandRows >> l;
+				cascade.next[l] = band * rows;
+				cascade.end[l] = std::min(chain.levels[l].height, (band + 1) * rows);
+			}
+
+			for (uint32_t y = cascade.next[0]; y < cascade.end[0]; y++) {
+				if (src != base.data)
+					memcpy(base.data + static_cast<size_t>(y) * base.stride, src + static_cast<size_t>(y) * base.stride, base.stride);
+				cascade.RowDone(0, y);
+			}
+		}
+	});
+
+	// Remaining levels are at most 1 / 4^MIP_BAND_LEVELS of the base
+	for (uint32_t l = bandLevels + 1; l < levelCount; l++) {
+		for (uint32_t y = 0; y < chain.levels[l].height; y++)
+			BuildBoxRow(chain, l, y);
+	}
+}
+
+// Kaiser windowed sinc, each level filtered from the previous one
+
+static float BesselI0(float x)
+{
+	float sum = 1.0f;
+	float term = 1.0f;
+	const float q = x * x / 4.0f;
+	for (int k = 1; k < 20; k++) {
+		term *= q / static_cast<float>(k * k);
+		sum += term;
+	}
+	return sum;
+}
+
+static void KaiserWeights(float weights[KAISER_TAPS])
+{
+	const float pi = 3.14159265358979f;
+	float total = 0.0f;
+
+	for (int t = 0; t < KAISER_TAPS; t++) {
+		// Distance of the src pixel center from the dst pixel center, in src pixels
+		const float d = static_cast<float>(t - KAISER_TAPS / 2) + 0.5f;
+		const float x = d / 2.0f;
+		const float sinc = std::abs(x) < 1e-6f ? 1.0f : std::sin(pi * x) / (pi * x);
+		const float r = d / KAISER_RADIUS;
+		const float window = BesselI0(KAISER_BETA * std::sqrt(std::max(0.0f, 1.0f - r * r))) / BesselI0(KAISER_BETA);
+		weights[t] = sinc * window;
+		total += weights[t];
+	}
+
+	for (int t = 0; t < KAISER_TAPS; t++)
+		weights[t] /= total;
+}
+
+static void BuildKaiserLevel(const MipChain& chain, uint32_t level)
+{
+	const MipLevel& src = chain.levels[level - 1];
+	const MipLevel& dst = chain.levels[level];
+	const uint32_t channels = chain.channels;
+	const uint32_t colors = chain.srgb ? SrgbColorChannels(channels) : 0;
+	const SrgbTables& tables = GetSrgbTables();
+
+	float weights[KAISER_TAPS];
+	KaiserWeights(weights);
+
+	// Clamped src column offsets of the horizontal taps for each dst column
+	std::vector<uint32_t> taps(static_cast<size_t>(dst.width) * KAISER_TAPS);
+	for (uint32_t x = 0; x < dst.width; x++) {
+		for (int t = 0; t < KAISER_TAPS; t++)
+			taps[x * KAISER_TAPS + t] = std::clamp(static_cast<int>(2 * x) + t - KAISER_TAPS / 2 + 1, 0, static_cast<int>(src.width) - 1) * channels;
+	}
+
+	ParallelFor(dst.height, 4, [&](uint32_t begin, uint32_t end) {
+
+		thread_local std::vector<float> column;
+		column.resize(static_cast<size_t>(src.width) * channels);
+
+		for (uint32_t y = begin; y < end; y++) {
+
+			std::fill(column.begin(), column.end(), 0.0f);
+
+			for (int t = 0; t < KAISER_TAPS; t++) {
+				const int sy = std::clamp(static_cast<int>(2 * y) + t - KAISER_TAPS / 2 + 1, 0, static_cast<int>(src.height) - 1);
+				const uint8_t* row = src.data + static_cast<size_t>(sy) * src.stride;
+				const float w = weights[t];
+				float* col = column.data();
+
+				for (uint32_t x = 0; x < src.width; x++) {
+					uint32_t c = 0;
+					for (; c < colors; c++)
+						col[c] += w * tables.toLinearF[row[c]];
+					for (; c < channels; c++)
+						col[c] += w * (row[c] * (1.0f / 255.0f));
+					row += channels;
+					col += channels;
+				}
+			}
+
+			uint8_t* out = dst.data + static_cast<size_t>(y) * dst.stride;
+
+			for (uint32_t x = 0; x < dst.width; x++) {
+				const uint32_t* xTaps = &taps[x * KAISER_TAPS];
+				for (uint32_t c = 0; c < channels; c++) {
+					float v = 0.0f;
+					for (int t = 0; t < KAISER_TAPS; t++)
+						v += weights[t] * column[xTaps[t] + c];
+					out[x * channels + c] = c < colors ?
+						SrgbEncodeF(tables, v) :
+						static_cast<uint8_t>(std::clamp(v * 255.0f + 0.5f, 0.0f, 255.0f));
+				}
+			}
+		}
+	});
+}
+
+// Alpha test coverage: rescale the alpha of each level so the fraction of texels passing the cutoff matches level 0
+
+static void AlphaHistogram(const MipLevel& level, uint32_t channels, uint32_t histogram[256])
+{
+	memset(histogram, 0, sizeof(uint32_t) * 256);
+	for (uint32_t y = 0; y < level.height; y++) {
+		const uint8_t* row = level.data + static_cast<size_t>(y) * level.stride + channels - 1;
+		for (uint32_t x = 0; x < level.width; x++)
+			histogram[row[x * channels]]++;
+	}
+}
+
+static float AlphaCoverage(const uint32_t histogram[256], float scale, float cutoff)
+{
+	uint64_t passed = 0;
+	uint64_t total = 0;
+	for (uint32_t a = 0; a < 256; a++) {
+		if (std::min(255.0f, a * scale) > cutoff)
+			passed += histogram[a];
+		total += histogram[a];
+	}
+	return total == 0 ? 0.0f : static_cast<float>(passed) / static_cast<float>(total);
+}
+
+static void PreserveCoverage(const MipChain& chain, float alphaCutoff)
+{
+	const uint32_t channels = chain.channels;
+	const float cutoff = std::clamp(alphaCutoff, 0.0f, 1.0f) * 255.0f;
+
+	uint32_t histogram[256];
+	AlphaHistogram(chain.levels[0], channels, histogram);
+	const float target = AlphaCoverage(histogram, 1.0f, cutoff);
+
+	for (size_t l = 1; l < chain.levels.size(); l++) {
+
+		const MipLevel& level = chain.levels[l];
+		AlphaHistogram(level, channels, histogram);
+
+		float lo = 0.0f;
+		float hi = 4.0f;
+		for (int i = 0; i < 16; i++) {
+			const float mid = (lo + hi) * 0.5f;
+			if (AlphaCoverage(histogram, mid, cutoff) < target)
+				lo = mid;
+			else
+				hi = mid;
+		}
+
+		uint8_t lut[256];
+		for (uint32_t a = 0; a < 256; a++)
+			lut[a] = static_cast<uint8_t>(std::min(255.0f, a * hi + 0.5f));
+
+		for (uint32_t y = 0; y < level.height; y++) {
+			uint8_t* row = level.data + static_cast<size_t>(y) * level.stride + channels - 1;
+			for (uint32_t x = 0; x < level.width; x++)
+				row[x * channels] = lut[row[x * channels]];
+		}
+	}
+}
+
+uint32_t ImageBuildMipChain(const uint8_t* src, uint32_t width, uint32_t height, uint32_t channels, uint32_t flags, uint8_t* dst, uint32_t* levelOffsets, float alphaCutoff)
+{
+	if (width == 0 || height == 0 || channels == 0)
+		return 0;
+
+	const uint32_t levelCount = MipLevelCount(width, height);
+
+	MipChain chain;
+	chain.channels = channels;
+	chain.srgb = (flags & MIP_SRGB) != 0;
+	chain.levels.resize(levelCount);
+
+	uint32_t offset = 0;
+	uint32_t w = width;
+	uint32_t h = height;
+
+	for (uint32_t l = 0; l < levelCount; l++) {
+		auto& level = chain.levels[l];
+		level.width = w;
+		level.height = h;
+		level.stride = w * channels;
+		level.data = dst != nullptr ? dst + offset : nullptr;
+
+		if (levelOffsets != nullptr)
+			levelOffsets[l] = offset;
+
+		offset += level.stride * h;
+		w = std::max(1u, w >> 1);
+		h = std::max(1u, h >> 1);
+	}
+
+	if (levelOffsets != nullptr)
+		levelOffsets[levelCount] = offset;
+
+	if (dst == nullptr || src == nullptr)
+		return levelCount;
+
+	if ((flags & MIP_KAISER) != 0) {
+		if (src != dst)
+			memcpy(dst, src, static_cast<size_t>(width) * height * channels);
+		for (uint32_t l = 1; l < levelCount; l++)
+			BuildKaiserLevel(chain, l);
+	}
+	else
+		BuildBoxChain(chain, src);
+
+	if ((flags & MIP_PRESERVE_COVERAGE) != 0 && (channels == 4 || channels == 2))
+		PreserveCoverage(chain, alphaCutoff);
+
+	return levelCount;
+}
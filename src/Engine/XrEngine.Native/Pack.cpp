@@ -0,0 +1,262 @@
+#include "pch.h"
+#include "Simd.h"
+#include "Parallel.h"
+
+// Pixels converted per channel before interleaving, four planes of this size stay in L1
+#define PACK_CHUNK 256
+
+// Images smaller than this are packed on the calling thread only
+#define PACK_MIN_BAND_BYTES (256 * 1024)
+
+static inline uint8_t UnormFromU16(uint32_t v)
+{
+	// Rounded v / 257, exact for every 16 bit value
+	return static_cast<uint8_t>((((v * 0xFF01u) >> 16) + 128) >> 8);
+}
+
+static inline uint8_t UnormFromF32(float v)
+{
+	return static_cast<uint8_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// One channel of count pixels to an 8 bit plane
+
+static void ExtractU8(const PackChannelSource& source, const uint8_t* row, uint8_t* out, uint32_t count)
+{
+	const uint32_t pixelSize = source.pixelSize;
+	const uint8_t* src = row + source.offset;
+
+	if (pixelSize == 1) {
+		memcpy(out, src, count);
+		return;
+	}
+
+	uint32_t x = 0;
+
+#if defined(XR_SSE)
+
+	if (pixelSize == 4) {
+		// Byte 0 of each 4 byte pixel, the offset is already applied to src
+		const __m128i shuffle = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+		const uint32_t end = count > 4 ? count - 4 : 0;
+		for (; x < end; x += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+			const int32_t bytes = _mm_cvtsi128_si32(_mm_shuffle_epi8(v, shuffle));
+			memcpy(out + x, &bytes, 4);
+		}
+	}
+
+#elif defined(XR_NEON)
+
+	if (pixelSize == 4 && source.offset < 4) {
+		for (; x + 16 <= count; x += 16)
+			vst1q_u8(out + x, vld4q_u8(row + x * 4).val[source.offset]);
+	}
+
+#endif
+
+	for (; x < count; x++)
+		out[x] = src[x * pixelSize];
+}
+
+static void ExtractU16(const PackChannelSource& source, const uint8_t* row, uint8_t* out, uint32_t count)
+{
+	const uint32_t pixelSize = source.pixelSize;
+	const uint8_t* src = row + source.offset;
+
+	uint32_t x = 0;
+
+#if defined(XR_SSE)
+
+	if (pixelSize == 2) {
+		const __m128i scale = _mm_set1_epi16((short)0xFF01);
+		const __m128i round = _mm_set1_epi16(128);
+		for (; x + 16 <= count; x += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(src + x * 2));
+			__m128i b = _mm_loadu_si128((const __m128i*)(src + x * 2 + 16));
+			a = _mm_srli_epi16(_mm_add_epi16(_mm_mulhi_epu16(a, scale), round), 8);
+			b = _mm_srli_epi16(_mm_add_epi16(_mm_mulhi_epu16(b, scale), round), 8);
+			_mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(a, b));
+		}
+	}
+
+#elif defined(XR_NEON)
+
+	if (pixelSize == 2) {
+		for (; x + 8 <= count; x += 8) {
+			const uint16x8_t v = vld1q_u16((const uint16_t*)(src + x * 2));
+			const uint32x4_t lo = vmull_n_u16(vget_low_u16(v), 0xFF01);
+			const uint32x4_t hi = vmull_n_u16(vget_high_u16(v), 0xFF01);
+			vst1_u8(out + x, vrshrn_n_u16(vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16)), 8));
+		}
+	}
+
+#endif
+
+	for (; x < count; x++) {
+		uint16_t v;
+		memcpy(&v, src + x * pixelSize, 2);
+		out[x] = UnormFromU16(v);
+	}
+}
+
+static void ExtractF32(const PackChannelSource& source, const uint8_t* row, uint8_t* out, uint32_t count)
+{
+	const uint32_t pixelSize = source.pixelSize;
+	const uint8_t* src = row + source.offset;
+
+	uint32_t x = 0;
+
+#if defined(XR_SSE)
+
+	if (pixelSize == 4) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(255.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+
+		auto convert = [&](uint32_t i) {
+			const __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps((const float*)(src + i * 4)), zero), one);
+			return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+		};
+
+		for (; x + 16 <= count; x += 16) {
+			const __m128i lo = _mm_packs_epi32(convert(x), convert(x + 4));
+			const __m128i hi = _mm_packs_epi32(convert(x + 8), convert(x + 12));
+			_mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(lo, hi));
+		}
+	}
+
+#elif defined(XR_NEON)
+
+	if (pixelSize == 4) {
+		const float32x4_t zero = vdupq_n_f32(0.0f);
+		const float32x4_t one = vdupq_n_f32(1.0f);
+
+		auto convert = [&](uint32_t i) {
+			const float32x4_t v = vminq_f32(vmaxq_f32(vld1q_f32((const float*)(src + i * 4)), zero), one);
+			return vmovn_u32(vcvtq_u32_f32(vmlaq_n_f32(vdupq_n_f32(0.5f), v, 255.0f)));
+		};
+
+		for (; x + 8 <= count; x += 8)
+			vst1_u8(out + x, vmovn_u16(vcombine_u16(convert(x), convert(x + 4))));
+	}
+
+#endif
+
+	for (; x < count; x++) {
+		float v;
+		memcpy(&v, src + x * pixelSize, 4);
+		out[x] = UnormFromF32(v);
+	}
+}
+
+static void ExtractChannel(const PackChannelSource& source, const uint8_t* row, uint8_t* out, uint32_t count)
+{
+	switch (source.type)
+	{
+	case PACK_U16: ExtractU16(source, row, out, count); break;
+	case PACK_F32: ExtractF32(source, row, out, count); break;
+	default: ExtractU8(source, row, out, count); break;
+	}
+}
+
+static void Interleave(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a, uint8_t* out, uint32_t count)
+{
+	uint32_t x = 0;
+
+#if defined(XR_SSE)
+
+	for (; x + 16 <= count; x += 16) {
+		const __m128i vr = _mm_loadu_si128((const __m128i*)(r + x));
+		const __m128i vg = _mm_loadu_si128((const __m128i*)(g + x));
+		const __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+		const __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+
+		const __m128i rgLo = _mm_unpacklo_epi8(vr, vg);
+		const __m128i rgHi = _mm_unpackhi_epi8(vr, vg);
+		const __m128i baLo = _mm_unpacklo_epi8(vb, va);
+		const __m128i baHi = _mm_unpackhi_epi8(vb, va);
+
+		_mm_storeu_si128((__m128i*)(out + x * 4), _mm_unpacklo_epi16(rgLo, baLo));
+		_mm_storeu_si128((__m128i*)(out + x * 4 + 16), _mm_unpackhi_epi16(rgLo, baLo));
+		_mm_storeu_si128((__m128i*)(out + x * 4 + 32), _mm_unpacklo_epi16(rgHi, baHi));
+		_mm_storeu_si128((__m128i*)(out + x * 4 + 48), _mm_unpackhi_epi16(rgHi, baHi));
+	}
+
+#elif defined(XR_NEON)
+
+	for (; x + 16 <= count; x += 16) {
+		uint8x16x4_t v;
+		v.val[0] = vld1q_u8(r + x);
+		v.val[1] = vld1q_u8(g + x);
+		v.val[2] = vld1q_u8(b + x);
+		v.val[3] = vld1q_u8(a + x);
+		vst4q_u8(out + x * 4, v);
+	}
+
+#endif
+
+	for (; x < count; x++) {
+		out[x * 4 + 0] = r[x];
+		out[x * 4 + 1] = g[x];
+		out[x * 4 + 2] = b[x];
+		out[x * 4 + 3] = a[x];
+	}
+}
+
+void ImagePackChannels(const PackChannelSource* sources, uint32_t sourceCount, uint8_t* dst, uint32_t width, uint32_t height, uint32_t dstStride)
+{
+	if (!dst || width == 0 || height == 0)
+		return;
+
+	if (dstStride == 0)
+		dstStride = width * 4;
+
+	// Missing channels are black with opaque alpha
+	PackChannelSource channels[4] = {};
+	for (uint32_t c = 0; c < 4; c++) {
+		if (sources && c < sourceCount)
+			channels[c] = sources[c];
+		else
+			channels[c].constant = c == 3 ? 1.0f : 0.0f;
+	}
+
+	// Constant planes are filled once and shared by every chunk
+	alignas(16) uint8_t constants[4][PACK_CHUNK];
+	for (uint32_t c = 0; c < 4; c++) {
+		if (!channels[c].data)
+			memset(constants[c], UnormFromF32(channels[c].constant), PACK_CHUNK);
+	}
+
+	const uint32_t minRows = std::max(1u, PACK_MIN_BAND_BYTES / (width * 4));
+
+	ParallelFor(height, minRows, [&](uint32_t begin, uint32_t end) {
+
+		alignas(16) uint8_t planes[4][PACK_CHUNK];
+		const uint8_t* planePtr[4];
+
+		for (uint32_t y = begin; y < end; y++) {
+
+			uint8_t* dstRow = dst + static_cast<size_t>(y) * dstStride;
+
+			for (uint32_t x = 0; x < width; x += PACK_CHUNK) {
+
+				const uint32_t count = std::min<uint32_t>(PACK_CHUNK, width - x);
+
+				for (uint32_t c = 0; c < 4; c++) {
+					const PackChannelSource& source = channels[c];
+					if (!source.data) {
+						planePtr[c] = constants[c];
+						continue;
+					}
+					const uint8_t* row = static_cast<const uint8_t*>(source.data) + static_cast<size_t>(y) * source.stride + static_cast<size_t>(x) * source.pixelSize;
+					ExtractChannel(source, row, planes[c], count);
+					planePtr[c] = planes[c];
+				}
+
+				Interleave(planePtr[0], planePtr[1], planePtr[2], planePtr[3], dstRow + x * 4, count);
+			}
+		}
+	});
+}
@@ -0,0 +1,550 @@
+#include "pch.h"
+#include "Parallel.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#ifndef _WINDOWS
+	#include <sched.h>
+	#include <stdio.h>
+#endif
+
+// Chunks per thread in a parallel for, so threads that finish early pick up the slack of the slower ones
+#define JOBS_CHUNKS_PER_THREAD 4
+
+// Tries on the queues before a worker goes to sleep
+#define JOBS_SPIN_COUNT 64
+
+// How often a thread waiting on a group looks for jobs to help with
+#define JOBS_WAIT_POLL_US 200
+
+struct JobGroup {
+	std::atomic<uint32_t> pending{ 0 };
+	std::atomic<bool> cancelled{ false };
+	std::mutex lock;
+	std::condition_variable done;
+};
+
+struct Job {
+	JobBody body;
+	JobGroup* group;
+};
+
+struct WorkQueue {
+	std::mutex lock;
+	std::deque<Job*> jobs;
+};
+
+struct JobSystem {
+	std::vector<std::thread> threads;
+	// One queue per worker, the last one takes the jobs pushed from outside the pool
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::atomic<uint32_t> queued{ 0 };
+	std::atomic<uint32_t> sleeping{ 0 };
+	std::atomic<bool> stop{ false };
+	std::mutex sleepLock;
+	std::condition_variable wake;
+};
+
+static std::mutex g_jobsLock;
+static std::atomic<JobSystem*> g_jobs{ nullptr };
+// Calls currently using g_jobs, JobsInit / JobsShutdown wait for them before destroying it
+static std::atomic<uint32_t> g_jobsUsers{ 0 };
+// Set by JobsShutdown (under g_jobsLock): no system is created lazily anymore and the work runs inline,
+// until an explicit JobsInit
+static bool g_jobsShutdown = false;
+
+static thread_local JobSystem* t_system = nullptr;
+static thread_local uint32_t t_queueIndex = 0;
+static thread_local uint32_t t_stealSeed = 0;
+
+static void PinCurrentThread(uint64_t affinityMask, uint32_t index)
+{
+	if (affinityMask == 0)
+		return;
+
+	// The index-th set bit of the mask, wrapping around
+	uint32_t cores[64];
+	uint32_t coreCount = 0;
+	for (uint32_t i = 0; i < 64; i++) {
+		if (affinityMask & (1ull << i))
+			cores[coreCount++] = i;
+	}
+
+	const uint32_t core = cores[index % coreCount];
+
+#ifdef _WINDOWS
+	SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1ull << core));
+#else
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+
+static Job* TryPop(JobSystem& js)
+{
+	if (js.queued.load(std::memory_order_acquire) == 0)
+		return nullptr;
+
+	const uint32_t count = static_cast<uint32_t>(js.queues.size());
+	Job* job = nullptr;
+
+	// Own queue first, newest job (still warm in cache)
+	if (t_system == &js) {
+		WorkQueue& own = *js.queues[t_queueIndex];
+		std::lock_guard<std::mutex> lock(own.lock);
+		if (!own.jobs.empty()) {
+			job = own.jobs.back();
+			own.jobs.pop_back();
+		}
+	}
+
+	// Then steal the oldest job of another queue, starting from a different one each time
+	if (!job) {
+		const uint32_t start = t_stealSeed++;
+		for (uint32_t i = 0; i < count && !job; i++) {
+			WorkQueue& queue = *js.queues[(start + i) % count];
+			std::lock_guard<std::mutex> lock(queue.lock);
+			if (!queue.jobs.empty()) {
+				job = queue.jobs.front();
+				queue.jobs.pop_front();
+			}
+		}
+	}
+
+	if (job)
+		js.queued.fetch_sub(1, std::memory_order_relaxed);
+
+	return job;
+}
+
+static void Execute(Job* job)
+{
+	JobGroup* group = job->group;
+
+	if (!group || !group->cancelled.load(std::memory_order_relaxed))
+		job->body();
+
+	delete job;
+
+	if (group) {
+		// Decremented under the lock, so a waiter can't free the group while it's being notified
+		std::lock_guard<std::mutex> lock(group->lock);
+		if (group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			group->done.notify_all();
+	}
+}
+
+static void WorkerLoop(JobSystem* js, uint32_t index, uint64_t affinityMask)
+{
+	t_system = js;
+	t_queueIndex = index;
+	t_stealSeed = index + 1;
+
+	PinCurrentThread(affinityMask, index);
+
+	while (true) {
+
+		Job* job = nullptr;
+
+		for (uint32_t i = 0; i < JOBS_SPIN_COUNT && !job; i++) {
+			job = TryPop(*js);
+			if (!job && js->stop.load(std::memory_order_relaxed))
+				return;
+			if (!job)
+				std::this_thread::yield();
+		}
+
+		if (job) {
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(js->sleepLock);
+		js->sleeping.fetch_add(1);
+		js->wake.wait(lock, [js] { return js->queued.load() > 0 || js->stop.load(); });
+		js->sleeping.fetch_sub(1);
+	}
+}
+
+static JobSystem* CreateJobSystem(uint32_t threads, uint64_t affinityMask)
+{
+	if (threads == 0) {
+		uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+#if defined(_MSC_VER)
+		if (affinityMask != 0)
+			cores = static_cast<uint32_t>(__popcnt64(affinityMask));
+#else
+		if (affinityMask != 0)
+			cores = static_cast<uint32_t>(__builtin_popcountll(affinityMask));
+#endif
+		// The calling thread works too while it waits
+		threads = cores - 1;
+	}
+
+	auto js = new JobSystem();
+
+	for (uint32_t i = 0; i < threads + 1; i++)
+		js->queues.push_back(std::make_unique<WorkQueue>());
+
+	js->threads.reserve(threads);
+	for (uint32_t i = 0; i < threads; i++)
+		js->threads.emplace_back(WorkerLoop, js, i, affinityMask);
+
+	return js;
+}
+
+static void DestroyJobSystem(JobSystem* js)
+{
+	{
+		std::lock_guard<std::mutex> lock(js->sleepLock);
+		js->stop.store(true);
+	}
+	js->wake.notify_all();
+
+	for (auto& thread : js->threads)
+		thread.join();
+
+	// Whatever is still queued runs here, so no group waits forever
+	while (Job* job = TryPop(*js))
+		Execute(job);
+
+	delete js;
+}
+
+// Keeps the job system alive while in scope, a shutdown waits for it instead of freeing it under the caller
+// Nested calls (from a job, or run inline while waiting) reuse the outer pin: re-pinning during a shutdown
+// would block on g_jobsLock while the outer call keeps the shutdown waiting
+static thread_local JobSystem* t_pinned = nullptr;
+
+struct JobSystemRef {
+
+	JobSystem* js;
+	bool counted = false;
+
+	// js stays null after JobsShutdown, the caller then runs the work itself
+	JobSystemRef()
+	{
+		// Workers are joined only after every user is gone, their own system outlives the job they run
+		js = t_system ? t_system : t_pinned;
+		if (js)
+			return;
+
+		for (;;) {
+			g_jobsUsers.fetch_add(1, std::memory_order_seq_cst);
+			js = g_jobs.load(std::memory_order_seq_cst);
+			if (js) {
+				counted = true;
+				t_pinned = js;
+				return;
+			}
+
+			// Not counted while creating it, a shutdown holding the lock would wait for us forever
+			g_jobsUsers.fetch_sub(1, std::memory_order_release);
+
+			std::lock_guard<std::mutex> lock(g_jobsLock);
+			if (g_jobsShutdown)
+				return;
+			if (!g_jobs.load())
+				g_jobs.store(CreateJobSystem(0, 0), std::memory_order_release);
+		}
+	}
+
+	~JobSystemRef()
+	{
+		if (counted) {
+			t_pinned = nullptr;
+			g_jobsUsers.fetch_sub(1, std::memory_order_release);
+		}
+	}
+
+	JobSystemRef(const JobSystemRef&) = delete;
+	JobSystemRef& operator=(const JobSystemRef&) = delete;
+
+	JobSystem& operator*() const { return *js; }
+};
+
+// Called with g_jobsLock held: new users see no system and block on the lock, the ones already in finish first
+static void ReleaseJobSystem()
+{
+	JobSystem* old = g_jobs.exchange(nullptr, std::memory_order_seq_cst);
+	if (!old)
+		return;
+
+	while (g_jobsUsers.load(std::memory_order_acquire) > 0)
+		std::this_thread::yield();
+
+	DestroyJobSystem(old);
+}
+
+static void Push(JobSystem& js, Job* job)
+{
+	WorkQueue& queue = t_system == &js ? *js.queues[t_queueIndex] : *js.queues.back();
+
+	{
+		std::lock_guard<std::mutex> lock(queue.lock);
+		queue.jobs.push_back(job);
+	}
+
+	js.queued.fetch_add(1);
+
+	if (js.sleeping.load() > 0) {
+		std::lock_guard<std::mutex> lock(js.sleepLock);
+		js.wake.notify_one();
+	}
+}
+
+void JobsSubmit(JobGroup* group, JobBody&& body)
+{
+	JobSystemRef ref;
+
+	if (!ref.js) {
+		if (!group || !group->cancelled.load(std::memory_order_relaxed))
+			body();
+		return;
+	}
+
+	// Without workers the job runs when the group is waited
+	if (group)
+		group->pending.fetch_add(1);
+
+	Push(*ref, new Job{ std::move(body), group });
+}
+
+static bool WaitGroup(JobGroup& group)
+{
+	JobSystemRef ref;
+	JobSystem* js = ref.js;
+
+	while (group.pending.load(std::memory_order_acquire) > 0) {
+
+		// Help with any queued job instead of blocking, this also makes nested waits safe
+		Job* job = js ? TryPop(*js) : nullptr;
+		if (job) {
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(group.lock);
+		group.done.wait_for(lock, std::chrono::microseconds(JOBS_WAIT_POLL_US), [&group] { return group.pending.load() == 0; });
+	}
+
+	// The last job may still hold the lock while notifying
+	std::lock_guard<std::mutex> lock(group.lock);
+
+	return !group.cancelled.load();
+}
+
+// Chunked range shared by the jobs of one parallel for, each job takes the next chunk until none are left
+struct ParallelRange {
+	std::atomic<uint32_t> next{ 0 };
+	uint32_t count;
+	uint32_t step;
+	uint32_t chunks;
+	JobGroup* group;
+
+	template<typename TBody>
+	void Run(const TBody& body)
+	{
+		while (!group || !group->cancelled.load(std::memory_order_relaxed)) {
+			const uint32_t i = next.fetch_add(1, std::memory_order_relaxed);
+			if (i >= chunks)
+				break;
+			const uint32_t begin = i * step;
+			body(begin, std::min(count, begin + step));
+		}
+	}
+};
+
+static uint32_t SplitRange(ParallelRange& range, uint32_t count, uint32_t minBatch, uint32_t threads)
+{
+	minBatch = std::max(1u, minBatch);
+
+	const uint32_t maxChunks = (count + minBatch - 1) / minBatch;
+	const uint32_t chunks = std::min(maxChunks, threads * JOBS_CHUNKS_PER_THREAD);
+
+	range.count = count;
+	range.step = (count + chunks - 1) / chunks;
+	range.chunks = (count + range.step - 1) / range.step;
+
+	return std::min(threads, range.chunks);
+}
+
+void ParallelFor(uint32_t count, uint32_t minBatch, const ParallelBody& body)
+{
+	if (count == 0)
+		return;
+
+	// Pinned until the whole range is done, nested calls from the jobs pin it again
+	JobSystemRef ref;
+
+	const uint32_t threads = ref.js ? static_cast<uint32_t>(ref.js->threads.size()) + 1 : 1;
+
+	if (threads <= 1 || count <= std::max(1u, minBatch)) {
+		body(0, count);
+		return;
+	}
+
+	JobGroup group;
+	ParallelRange range;
+	range.group = nullptr;
+
+	const uint32_t jobs = SplitRange(range, count, minBatch, threads);
+
+	for (uint32_t i = 1; i < jobs; i++)
+		JobsSubmit(&group, [&range, &body] { range.Run(body); });
+
+	range.Run(body);
+
+	WaitGroup(group);
+}
+
+bool JobsInit(uint32_t threads, uint64_t affinityMask)
+{
+	std::lock_guard<std::mutex> lock(g_jobsLock);
+
+	ReleaseJobSystem();
+
+	g_jobs.store(CreateJobSystem(threads, affinityMask), std::memory_order_release);
+	g_jobsShutdown = false;
+
+	return true;
+}
+
+// Final: later calls run their work inline on the calling thread instead of starting the workers again,
+// only JobsInit brings them back
+void JobsShutdown()
+{
+	std::lock_guard<std::mutex> lock(g_jobsLock);
+
+	g_jobsShutdown = true;
+
+	ReleaseJobSystem();
+}
+
+uint32_t JobsGetThreadCount()
+{
+	JobSystemRef ref;
+	return ref.js ? static_cast<uint32_t>(ref.js->threads.size()) : 0;
+}
+
+uint64_t JobsGetBigCoreMask()
+{
+#ifdef _WINDOWS
+
+	DWORD_PTR processMask = 0, systemMask = 0;
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+		return 0;
+	return static_cast<uint64_t>(processMask);
+
+#else
+
+	// Cores with the highest max frequency class: on big.LITTLE (Quest) the little cluster is left out
+	const uint32_t cores = std::min(64u, std::max(1u, std::thread::hardware_concurrency()));
+
+	uint32_t freqs[64] = {};
+	uint32_t minFreq = UINT32_MAX;
+	uint64_t all = 0;
+
+	for (uint32_t i = 0; i < cores; i++) {
+		char path[128];
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cpufreq/cpuinfo_max_freq", i);
+		FILE* file = fopen(path, "r");
+		if (!file)
+			continue;
+		if (fscanf(file, "%u", &freqs[i]) == 1 && freqs[i] > 0) {
+			minFreq = std::min(minFreq, freqs[i]);
+			all |= 1ull << i;
+		}
+		fclose(file);
+	}
+
+	uint64_t mask = 0;
+	for (uint32_t i = 0; i < cores; i++) {
+		if (freqs[i] > minFreq)
+			mask |= 1ull << i;
+	}
+
+	if (all == 0)
+		all = cores == 64 ? ~0ull : (1ull << cores) - 1;
+
+	// Symmetric cores (or no cpufreq): all of them
+	return mask != 0 ? mask : all;
+
+#endif
+}
+
+void JobsParallelFor(uint32_t count, uint32_t minBatch, JobRangeFunc func, void* data)
+{
+	if (!func)
+		return;
+
+	ParallelFor(count, minBatch, [func, data](uint32_t begin, uint32_t end) {
+		func(data, begin, end);
+	});
+}
+
+JobGroup* JobGroupCreate()
+{
+	return new JobGroup();
+}
+
+void JobGroupRun(JobGroup* group, JobFunc func, void* data)
+{
+	if (!group || !func)
+		return;
+
+	JobsSubmit(group, [func, data] { func(data); });
+}
+
+void JobGroupParallelFor(JobGroup* group, uint32_t count, uint32_t minBatch, JobRangeFunc func, void* data)
+{
+	if (!group || !func || count == 0)
+		return;
+
+	JobSystemRef ref;
+
+	// The range outlives this call, the jobs share it until the last one ends
+	auto range = std::make_shared<ParallelRange>();
+	range->group = group;
+
+	const uint32_t threads = ref.js ? static_cast<uint32_t>(ref.js->threads.size()) + 1 : 1;
+	const uint32_t jobs = SplitRange(*range, count, minBatch, threads);
+
+	for (uint32_t i = 0; i < jobs; i++) {
+		JobsSubmit(group, [range, func, data] {
+			range->Run([func, data](uint32_t begin, uint32_t end) {
+				func(data, begin, end);
+			});
+		});
+	}
+}
+
+bool JobGroupWait(JobGroup* group)
+{
+	if (!group)
+		return false;
+
+	return WaitGroup(*group);
+}
+
+void JobGroupCancel(JobGroup* group)
+{
+	if (group)
+		group->cancelled.store(true);
+}
+
+void JobGroupDestroy(JobGroup* group)
+{
+	if (!group)
+		return;
+
+	// Jobs still queued reference the group
+	WaitGroup(*group);
+
+	delete group;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+typedef std::function<void(uint32_t begin, uint32_t end)> ParallelBody;
+
+typedef std::function<void()> JobBody;
+
+// Splits [0, count) in contiguous ranges of at least minBatch items and runs them on the shared job system.
+// Runs inline when the work is too small to be worth a fan out; the caller takes part in the work.
+void ParallelFor(uint32_t count, uint32_t minBatch, const ParallelBody& body);
+
+// Queues a job on the shared job system, tracked by group (JobGroupWait / JobGroupCancel)
+void JobsSubmit(JobGroup* group, JobBody&& body);
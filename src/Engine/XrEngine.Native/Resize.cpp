@@ -0,0 +1,957 @@
+#include "pch.h"
+#include "Simd.h"
+#include "Parallel.h"
+#include "Srgb.h"
+
+// Rows smaller than this are resized on the calling thread only
+#define RESIZE_MIN_BAND_BYTES (256 * 1024)
+
+struct ResizePlan {
+	uint32_t srcW;
+	uint32_t srcH;
+	uint32_t dstW;
+	uint32_t dstH;
+	uint32_t channels;
+	uint32_t flags;
+	// Byte offset of the two source pixels and 8.8 weights (wx0 | wx << 16) for each dst column
+	std::vector<uint32_t> xOfs0;
+	std::vector<uint32_t> xOfs1;
+	std::vector<uint32_t> xWeights;
+	// Source rows and weight for each dst row
+	std::vector<uint32_t> y0;
+	std::vector<uint32_t> y1;
+	std::vector<uint16_t> yWeights;
+	// RESIZE_SRGB: per channel decode (byte -> 15 bit linear) and encode (12 bit index -> byte) tables
+	std::vector<const uint16_t*> decode;
+	std::vector<const uint8_t*> encode;
+};
+
+
+static inline void MapAxis(uint32_t i, float scale, uint32_t srcSize, uint32_t& i0, uint32_t& i1, uint16_t& w)
+{
+	float s = (static_cast<float>(i) + 0.5f) * scale - 0.5f; // pixel-center mapping
+	int s0 = static_cast<int>(std::floor(s));
+	float f = s - static_cast<float>(s0);
+
+	if (s0 < 0) { s0 = 0; f = 0.0f; }
+	int s1 = s0 + 1;
+	if (s1 >= static_cast<int>(srcSize)) { s1 = s0; f = 0.0f; }
+
+	w = static_cast<uint16_t>(std::clamp<int>(static_cast<int>(f * 256.0f + 0.5f), 0, 256));
+	i0 = static_cast<uint32_t>(s0);
+	i1 = static_cast<uint32_t>(s1);
+}
+
+static void BuildResizePlan(ResizePlan& plan, uint32_t srcW, uint32_t srcH, uint32_t dstW, uint32_t dstH, uint32_t channels, uint32_t flags)
+{
+	plan.srcW = srcW;
+	plan.srcH = srcH;
+	plan.dstW = dstW;
+	plan.dstH = dstH;
+	plan.channels = channels;
+	plan.flags = flags;
+
+	plan.decode.clear();
+	plan.encode.clear();
+
+	if (flags & RESIZE_SRGB) {
+		const SrgbTables& tables = GetSrgbTables();
+		const uint32_t colorChannels = SrgbColorChannels(channels);
+		for (uint32_t c = 0; c < channels; c++) {
+			plan.decode.push_back(c < colorChannels ? tables.toLinear15 : tables.alphaToLinear15);
+			plan.encode.push_back(c < colorChannels ? tables.fromLinear12 : tables.alphaFromLinear12);
+		}
+	}
+
+	plan.xOfs0.resize(dstW);
+	plan.xOfs1.resize(dstW);
+	plan.xWeights.resize(dstW);
+	plan.y0.resize(dstH);
+	plan.y1.resize(dstH);
+	plan.yWeights.resize(dstH);
+
+	const float scaleX = static_cast<float>(srcW) / static_cast<float>(dstW);
+	const float scaleY = static_cast<float>(srcH) / static_cast<float>(dstH);
+
+	for (uint32_t x = 0; x < dstW; ++x)
+	{
+		uint32_t x0, x1;
+		uint16_t wx;
+		MapAxis(x, scaleX, srcW, x0, x1, wx);
+		plan.xOfs0[x] = x0 * channels;
+		plan.xOfs1[x] = x1 * channels;
+		plan.xWeights[x] = (256u - wx) | (static_cast<uint32_t>(wx) << 16);
+	}
+
+	for (uint32_t y = 0; y < dstH; ++y)
+		MapAxis(y, scaleY, srcH, plan.y0[y], plan.y1[y], plan.yWeights[y]);
+}
+
+// Horizontal pass: one source row to dstW * C 8.8 fixed point values (top = p0 * wx0 + p1 * wx)
+
+template <uint32_t C>
+static void ResizeRowXScalar(const ResizePlan& plan, const uint8_t* row, uint16_t* out, uint32_t x)
+{
+	const uint32_t* ofs0 = plan.xOfs0.data();
+	const uint32_t* ofs1 = plan.xOfs1.data();
+	const uint32_t* weights = plan.xWeights.data();
+
+	for (; x < plan.dstW; ++x)
+	{
+		const uint8_t* p0 = row + ofs0[x];
+		const uint8_t* p1 = row + ofs1[x];
+		const uint32_t wx0 = weights[x] & 0xFFFF;
+		const uint32_t wx = weights[x] >> 16;
+
+		for (uint32_t c = 0; c < C; ++c)
+			out[x * C + c] = static_cast<uint16_t>(p0[c] * wx0 + p1[c] * wx);
+	}
+}
+
+// MapAxis only clamps p1 onto p0 when its weight is 0, so the 1-3 channel kernels read p1 as p0 + C
+// with a single load at p0. Columns from the returned one on would load past the end of the row.
+static uint32_t ResizeRowXSimdEnd(const ResizePlan& plan, uint32_t loadBytes)
+{
+	const uint32_t rowBytes = plan.srcW * plan.channels;
+	uint32_t end = plan.dstW;
+	while (end > 0 && plan.xOfs0[end - 1] + loadBytes > rowBytes)
+		end--;
+	return end;
+}
+
+template <uint32_t C>
+static void ResizeRowX(const ResizePlan& plan, const uint8_t* row, uint16_t* out);
+
+template <>
+void ResizeRowX<1>(const ResizePlan& plan, const uint8_t* row, uint16_t* out)
+{
+	uint32_t x = 0;
+
+#if defined(XR_SSE) || defined(XR_NEON)
+
+	const uint32_t* ofs0 = plan.xOfs0.data();
+	const uint32_t* weights = plan.xWeights.data();
+	const uint32_t end = ResizeRowXSimdEnd(plan, 2);
+
+	auto pair = [&](uint32_t i) {
+		uint16_t v;
+		memcpy(&v, row + ofs0[i], 2);
+		return v;
+	};
+
+#endif
+
+#if defined(XR_SSE)
+
+	// The 16 bit load at p0 already is the (p0, p1) byte pair madd expects
+	for (; x + 8 <= end; x += 8)
+	{
+		const __m128i pairs = _mm_setr_epi16(
+			(short)pair(x), (short)pair(x + 1), (short)pair(x + 2), (short)pair(x + 3),
+			(short)pair(x + 4), (short)pair(x + 5), (short)pair(x + 6), (short)pair(x + 7));
+		const __m128i lo = _mm_madd_epi16(_mm_cvtepu8_epi16(pairs), _mm_loadu_si128((const __m128i*)(weights + x)));
+		const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pairs, _mm_setzero_si128()), _mm_loadu_si128((const __m128i*)(weights + x + 4)));
+		_mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi32(lo, hi));
+	}
+
+#elif defined(XR_NEON)
+
+	for (; x + 8 <= end; x += 8)
+	{
+		const uint16_t pairs[8] = { pair(x), pair(x + 1), pair(x + 2), pair(x + 3), pair(x + 4), pair(x + 5), pair(x + 6), pair(x + 7) };
+		const uint8x16_t bytes = vreinterpretq_u8_u16(vld1q_u16(pairs));
+		const uint8x8x2_t p = vuzp_u8(vget_low_u8(bytes), vget_high_u8(bytes));
+		const uint16x8x2_t w = vld2q_u16(reinterpret_cast<const uint16_t*>(weights + x));
+		vst1q_u16(out + x, vmlaq_u16(vmulq_u16(vmovl_u8(p.val[0]), w.val[0]), vmovl_u8(p.val[1]), w.val[1]));
+	}
+
+#endif
+
+	ResizeRowXScalar<1>(plan, row, out, x);
+}
+
+template <>
+void ResizeRowX<2>(const ResizePlan& plan, const uint8_t* row, uint16_t* out)
+{
+	uint32_t x = 0;
+
+#if defined(XR_SSE) || defined(XR_NEON)
+
+	const uint32_t* ofs0 = plan.xOfs0.data();
+	const uint32_t* weights = plan.xWeights.data();
+	const uint32_t end = ResizeRowXSimdEnd(plan, 4);
+
+	auto quad = [&](uint32_t i) {
+		uint32_t v;
+		memcpy(&v, row + ofs0[i], 4);
+		return v;
+	};
+
+#endif
+
+#if defined(XR_SSE)
+
+	// [p0c0 p0c1 p1c0 p1c1] to the (p0, p1) pair of each channel, the weight repeated for both channels
+	const __m128i interleave = _mm_setr_epi8(0, 2, 1, 3, 4, 6, 5, 7, 8, 10, 9, 11, 12, 14, 13, 15);
+
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i pairs = _mm_shuffle_epi8(_mm_setr_epi32((int)quad(x), (int)quad(x + 1), (int)quad(x + 2), (int)quad(x + 3)), interleave);
+		const __m128i w = _mm_loadu_si128((const __m128i*)(weights + x));
+		const __m128i lo = _mm_madd_epi16(_mm_cvtepu8_epi16(pairs), _mm_unpacklo_epi32(w, w));
+		const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pairs, _mm_setzero_si128()), _mm_unpackhi_epi32(w, w));
+		_mm_storeu_si128((__m128i*)(out + x * 2), _mm_packus_epi32(lo, hi));
+	}
+
+#elif defined(XR_NEON)
+
+	for (; x + 4 <= end; x += 4)
+	{
+		const uint32_t quads[4] = { quad(x), quad(x + 1), quad(x + 2), quad(x + 3) };
+		const uint16x8_t pixels = vld1q_u16(reinterpret_cast<const uint16_t*>(quads));
+		const uint16x4x2_t p = vuzp_u16(vget_low_u16(pixels), vget_high_u16(pixels));
+		const uint16x4x2_t w = vld2_u16(reinterpret_cast<const uint16_t*>(weights + x));
+		const uint16x4x2_t w0 = vzip_u16(w.val[0], w.val[0]);
+		const uint16x4x2_t w1 = vzip_u16(w.val[1], w.val[1]);
+		const uint16x8_t prod = vmulq_u16(vmovl_u8(vreinterpret_u8_u16(p.val[0])), vcombine_u16(w0.val[0], w0.val[1]));
+		vst1q_u16(out + x * 2, vmlaq_u16(prod, vmovl_u8(vreinterpret_u8_u16(p.val[1])), vcombine_u16(w1.val[0], w1.val[1])));
+	}
+
+#endif
+
+	ResizeRowXScalar<2>(plan, row, out, x);
+}
+
+template <>
+void ResizeRowX<3>(const ResizePlan& plan, const uint8_t* row, uint16_t* out)
+{
+	uint32_t x = 0;
+
+#if defined(XR_SSE) || defined(XR_NEON)
+
+	const uint32_t* ofs0 = plan.xOfs0.data();
+	const uint32_t* weights = plan.xWeights.data();
+	const uint32_t end = ResizeRowXSimdEnd(plan, 8);
+
+#endif
+
+#if defined(XR_SSE)
+
+	// 8 bytes at p0 hold p0 and p1, spread to the (p0, p1) pair of c0..c2 and a zero 4th channel
+	const __m128i spread = _mm_setr_epi8(0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1);
+	// Two pixels of 4 lanes to 6 packed values
+	const __m128i pack = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+
+	auto pixel = [&](uint32_t i) {
+		const __m128i pairs = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)(row + ofs0[i])), spread);
+		return _mm_madd_epi16(pairs, _mm_set1_epi32((int)weights[i]));
+	};
+
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i a = _mm_shuffle_epi8(_mm_packus_epi32(pixel(x), pixel(x + 1)), pack);
+		const __m128i b = _mm_shuffle_epi8(_mm_packus_epi32(pixel(x + 2), pixel(x + 3)), pack);
+		_mm_storeu_si128((__m128i*)(out + x * 3), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+		_mm_storel_epi64((__m128i*)(out + x * 3 + 8), _mm_srli_si128(b, 4));
+	}
+
+#elif defined(XR_NEON)
+
+	// p0 in lanes 0-2 and p1 shifted down from 3-5, the 4th store lane is overwritten by the next pixel
+	for (; x + 1 < end; ++x)
+	{
+		const uint16x8_t pixels = vmovl_u8(vld1_u8(row + ofs0[x]));
+		const uint16x4_t p0 = vget_low_u16(pixels);
+		const uint16x4_t p1 = vget_low_u16(vextq_u16(pixels, pixels, 3));
+		vst1_u16(out + x * 3, vmla_n_u16(vmul_n_u16(p0, weights[x] & 0xFFFF), p1, weights[x] >> 16));
+	}
+
+#endif
+
+	ResizeRowXScalar<3>(plan, row, out, x);
+}
+
+template <>
+void ResizeRowX<4>(const ResizePlan& plan, const uint8_t* row, uint16_t* out)
+{
+	uint32_t x = 0;
+
+#if defined(XR_SSE) || defined(XR_NEON)
+
+	const uint32_t* ofs0 = plan.xOfs0.data();
+	const uint32_t* ofs1 = plan.xOfs1.data();
+	const uint32_t* weights = plan.xWeights.data();
+
+#endif
+
+#if defined(XR_SSE)
+
+	// (p0, p1) byte pairs widened to 16 bit, madd with (wx0, wx) gives the 4 channels of one pixel
+	auto pixel = [&](uint32_t i) {
+		uint32_t a, b;
+		memcpy(&a, row + ofs0[i], 4);
+		memcpy(&b, row + ofs1[i], 4);
+		const __m128i pairs = _mm_cvtepu8_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)a), _mm_cvtsi32_si128((int)b)));
+		return _mm_madd_epi16(pairs, _mm_set1_epi32((int)weights[i]));
+	};
+
+	for (; x + 2 <= plan.dstW; x += 2)
+		_mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi32(pixel(x), pixel(x + 1)));
+
+#elif defined(XR_NEON)
+
+	auto pixel = [&](uint32_t i) {
+		uint32_t a, b;
+		memcpy(&a, row + ofs0[i], 4);
+		memcpy(&b, row + ofs1[i], 4);
+		const uint16x8_t pixels = vmovl_u8(vcreate_u8(a | (static_cast<uint64_t>(b) << 32)));
+		const uint16x8_t w = vcombine_u16(vdup_n_u16(weights[i] & 0xFFFF), vdup_n_u16(weights[i] >> 16));
+		const uint16x8_t prod = vmulq_u16(pixels, w);
+		return vadd_u16(vget_low_u16(prod), vget_high_u16(prod));
+	};
+
+	for (; x + 2 <= plan.dstW; x += 2)
+		vst1q_u16(out + x * 4, vcombine_u16(pixel(x), pixel(x + 1)));
+
+#endif
+
+	ResizeRowXScalar<4>(plan, row, out, x);
+}
+
+static void ResizeRowXAny(const ResizePlan& plan, const uint8_t* row, uint16_t* out)
+{
+	const uint32_t channels = plan.channels;
+
+	for (uint32_t x = 0; x < plan.dstW; ++x)
+	{
+		const uint8_t* p0 = row + plan.xOfs0[x];
+		const uint8_t* p1 = row + plan.xOfs1[x];
+		const uint32_t wx0 = plan.xWeights[x] & 0xFFFF;
+		const uint32_t wx = plan.xWeights[x] >> 16;
+
+		for (uint32_t c = 0; c < channels; ++c)
+			out[c] = static_cast<uint16_t>(p0[c] * wx0 + p1[c] * wx);
+
+		out += channels;
+	}
+}
+
+typedef void (*ResizeRowXFunc)(const ResizePlan& plan, const uint8_t* row, uint16_t* out);
+
+static ResizeRowXFunc GetResizeRowX(uint32_t channels)
+{
+	switch (channels)
+	{
+	case 1: return ResizeRowX<1>;
+	case 2: return ResizeRowX<2>;
+	case 3: return ResizeRowX<3>;
+	case 4: return ResizeRowX<4>;
+	default: return ResizeRowXAny;
+	}
+}
+
+// Vertical pass: out = (top * wy0 + bottom * wy + 0x8000) >> 16, identical for every channel count
+
+#ifdef XR_AVX2
+
+#ifndef _WINDOWS
+__attribute__((target("avx2")))
+#endif
+static uint32_t ResizeRowYAvx2(const uint16_t* top, const uint16_t* bottom, uint32_t wy, uint8_t* out, uint32_t count)
+{
+	const __m256i w0 = _mm256_set1_epi32((int)(256u - wy));
+	const __m256i w1 = _mm256_set1_epi32((int)wy);
+	const __m256i round = _mm256_set1_epi32(0x8000);
+
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i a = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(top + i)));
+		const __m256i b = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(bottom + i)));
+		__m256i v = _mm256_add_epi32(_mm256_mullo_epi32(a, w0), _mm256_mullo_epi32(b, w1));
+		v = _mm256_srli_epi32(_mm256_add_epi32(v, round), 16);
+		const __m128i v16 = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		_mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(v16, v16));
+	}
+	return i;
+}
+
+#endif
+
+static void ResizeRowY(const uint16_t* top, const uint16_t* bottom, uint32_t wy, uint8_t* out, uint32_t count)
+{
+	uint32_t i = 0;
+
+#if defined(XR_AVX2)
+
+	if (HasAvx2())
+		i = ResizeRowYAvx2(top, bottom, wy, out, count);
+
+#endif
+
+#if defined(XR_SSE)
+
+	const __m128i w0 = _mm_set1_epi32((int)(256u - wy));
+	const __m128i w1 = _mm_set1_epi32((int)wy);
+	const __m128i round = _mm_set1_epi32(0x8000);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(top + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(bottom + i));
+
+		__m128i lo = _mm_add_epi32(_mm_mullo_epi32(_mm_unpacklo_epi16(a, zero), w0), _mm_mullo_epi32(_mm_unpacklo_epi16(b, zero), w1));
+		__m128i hi = _mm_add_epi32(_mm_mullo_epi32(_mm_unpackhi_epi16(a, zero), w0), _mm_mullo_epi32(_mm_unpackhi_epi16(b, zero), w1));
+		lo = _mm_srli_epi32(_mm_add_epi32(lo, round), 16);
+		hi = _mm_srli_epi32(_mm_add_epi32(hi, round), 16);
+
+		const __m128i v16 = _mm_packus_epi32(lo, hi);
+		_mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(v16, v16));
+	}
+
+#elif defined(XR_NEON)
+
+	const uint16_t w0 = static_cast<uint16_t>(256u - wy);
+	const uint16_t w1 = static_cast<uint16_t>(wy);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const uint16x8_t a = vld1q_u16(top + i);
+		const uint16x8_t b = vld1q_u16(bottom + i);
+
+		uint32x4_t lo = vmull_n_u16(vget_low_u16(a), w0);
+		uint32x4_t hi = vmull_n_u16(vget_high_u16(a), w0);
+		lo = vmlal_n_u16(lo, vget_low_u16(b), w1);
+		hi = vmlal_n_u16(hi, vget_high_u16(b), w1);
+
+		// vrshrn adds 0x8000 before the shift, same rounding as the scalar path
+		const uint16x8_t v16 = vcombine_u16(vrshrn_n_u32(lo, 16), vrshrn_n_u32(hi, 16));
+		vst1_u8(out + i, vmovn_u16(v16));
+	}
+
+#endif
+
+	const uint32_t wy0 = 256u - wy;
+	for (; i < count; ++i)
+	{
+		const uint32_t v = top[i] * wy0 + bottom[i] * wy;
+		out[i] = static_cast<uint8_t>((v + 0x8000u) >> 16);
+	}
+}
+
+// sRGB path: rows are decoded to 15 bit linear, filtered with the same weights, then encoded back through the 4K table.
+// 15 bit values keep the products in signed 16 bit multiply-add range, so the kernels cost about the same as the byte path.
+// The table lookups are AVX2 gathers. On aarch64 the decode goes through tbl/tbx chains over byte tables; the encode
+// table (2 x 4K entries) is out of tbl reach and stays scalar there, about a fifth of the lookups on a 2x downscale.
+
+#ifdef XR_AVX2
+
+// Offset added to the table index of each of 8 consecutive elements, alpha lanes read the second half of the tables.
+// The pattern repeats every 8 elements: only 2 and 4 channels have alpha.
+#ifndef _WINDOWS
+__attribute__((target("avx2")))
+#endif
+static __m256i AlphaLanesAvx2(uint32_t channels, int offset)
+{
+	const uint32_t colors = SrgbColorChannels(channels);
+	alignas(32) int lanes[8];
+	for (uint32_t i = 0; i < 8; i++)
+		lanes[i] = i % channels >= colors ? offset : 0;
+	return _mm256_load_si256((const __m256i*)lanes);
+}
+
+#ifndef _WINDOWS
+__attribute__((target("avx2")))
+#endif
+static uint32_t DecodeRowAvx2(const uint8_t* row, uint16_t* out, uint32_t count, uint32_t channels)
+{
+	const int* table = (const int*)GetSrgbTables().decode32;
+	const __m256i alpha = AlphaLanesAvx2(channels, 256);
+
+	uint32_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i bytes = _mm_loadu_si128((const __m128i*)(row + i));
+		const __m256i a = _mm256_i32gather_epi32(table, _mm256_add_epi32(_mm256_cvtepu8_epi32(bytes), alpha), 4);
+		const __m256i b = _mm256_i32gather_epi32(table, _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)), alpha), 4);
+		// packus interleaves the 128 bit lanes of a and b, the permute restores the element order
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8));
+	}
+	return i;
+}
+
+#endif
+
+#if defined(XR_NEON) && defined(__aarch64__)
+
+// 256 entry byte table as 4 quarters of 64 bytes
+struct NeonTable256 {
+	uint8x16x4_t quarter[4];
+};
+
+static inline NeonTable256 LoadNeonTable256(const uint8_t* table)
+{
+	NeonTable256 result;
+	for (int q = 0; q < 4; q++) {
+		for (int r = 0; r < 4; r++)
+			result.quarter[q].val[r] = vld1q_u8(table + q * 64 + r * 16);
+	}
+	return result;
+}
+
+// tbl zeroes the lanes past the first quarter, each tbx then fills the lanes falling in its own (the others wrap past 64)
+static inline uint8x16_t LookupNeonTable256(const NeonTable256& table, uint8x16_t index)
+{
+	const uint8x16_t step = vdupq_n_u8(64);
+	uint8x16_t result = vqtbl4q_u8(table.quarter[0], index);
+	index = vsubq_u8(index, step);
+	result = vqtbx4q_u8(result, table.quarter[1], index);
+	index = vsubq_u8(index, step);
+	result = vqtbx4q_u8(result, table.quarter[2], index);
+	index = vsubq_u8(index, step);
+	return vqtbx4q_u8(result, table.quarter[3], index);
+}
+
+// Low and high bytes looked up apart, vst2 interleaves them back to 16 bit
+static uint32_t DecodeRowNeon(const uint8_t* row, uint16_t* out, uint32_t count, uint32_t channels)
+{
+	const SrgbTables& tables = GetSrgbTables();
+	const NeonTable256 colorLo = LoadNeonTable256(tables.decodeLo);
+	const NeonTable256 colorHi = LoadNeonTable256(tables.decodeHi);
+	const uint32_t colors = SrgbColorChannels(channels);
+
+	uint32_t i = 0;
+
+	if (colors == channels) {
+		for (; i + 16 <= count; i += 16) {
+			const uint8x16_t v = vld1q_u8(row + i);
+			uint8x16x2_t result;
+			result.val[0] = LookupNeonTable256(colorLo, v);
+			result.val[1] = LookupNeonTable256(colorHi, v);
+			vst2q_u8((uint8_t*)(out + i), result);
+		}
+		return i;
+	}
+
+	// Only 2 and 4 channels have alpha, the lane pattern repeats every 16 bytes
+	const NeonTable256 alphaLo = LoadNeonTable256(tables.decodeLo + 256);
+	const NeonTable256 alphaHi = LoadNeonTable256(tables.decodeHi + 256);
+
+	uint8_t lanes[16];
+	for (uint32_t l = 0; l < 16; l++)
+		lanes[l] = l % channels >= colors ? 0xFF : 0;
+	const uint8x16_t alpha = vld1q_u8(lanes);
+
+	for (; i + 16 <= count; i += 16) {
+		const uint8x16_t v = vld1q_u8(row + i);
+		uint8x16x2_t result;
+		result.val[0] = vbslq_u8(alpha, LookupNeonTable256(alphaLo, v), LookupNeonTable256(colorLo, v));
+		result.val[1] = vbslq_u8(alpha, LookupNeonTable256(alphaHi, v), LookupNeonTable256(colorHi, v));
+		vst2q_u8((uint8_t*)(out + i), result);
+	}
+	return i;
+}
+
+#endif
+
+static void DecodeRow(const ResizePlan& plan, const uint8_t* row, uint16_t* out)
+{
+	const uint32_t channels = plan.channels;
+	const uint32_t count = plan.srcW * channels;
+
+	uint32_t i = 0;
+
+#if defined(XR_AVX2)
+
+	if (HasAvx2())
+		i = DecodeRowAvx2(row, out, count, channels);
+
+#elif defined(XR_NEON) && defined(__aarch64__)
+
+	i = DecodeRowNeon(row, out, count, channels);
+
+#endif
+
+	if (channels == 4) {
+		const uint16_t* color = plan.decode[0];
+		const uint16_t* alpha = plan.decode[3];
+		for (; i < count; i += 4) {
+			out[i + 0] = color[row[i + 0]];
+			out[i + 1] = color[row[i + 1]];
+			out[i + 2] = color[row[i + 2]];
+			out[i + 3] = alpha[row[i + 3]];
+		}
+		return;
+	}
+
+	for (uint32_t c = i % channels; i < count; i++) {
+		out[i] = plan.decode[c][row[i]];
+		if (++c == channels)
+			c = 0;
+	}
+}
+
+// Horizontal pass on the linear row: (l0 * wx0 + l1 * wx + 128) >> 8
+
+template <uint32_t C>
+static void ResizeRowXLinear(const ResizePlan& plan, const uint16_t* row, uint16_t* out)
+{
+	const uint32_t channels = C == 0 ? plan.channels : C;
+
+	for (uint32_t x = 0; x < plan.dstW; ++x)
+	{
+		const uint16_t* p0 = row + plan.xOfs0[x];
+		const uint16_t* p1 = row + plan.xOfs1[x];
+		const uint32_t wx0 = plan.xWeights[x] & 0xFFFF;
+		const uint32_t wx = plan.xWeights[x] >> 16;
+
+		for (uint32_t c = 0; c < channels; ++c)
+			out[c] = static_cast<uint16_t>((p0[c] * wx0 + p1[c] * wx + 128) >> 8);
+
+		out += channels;
+	}
+}
+
+template <>
+void ResizeRowXLinear<4>(const ResizePlan& plan, const uint16_t* row, uint16_t* out)
+{
+	const uint32_t* ofs0 = plan.xOfs0.data();
+	const uint32_t* ofs1 = plan.xOfs1.data();
+	const uint32_t* weights = plan.xWeights.data();
+
+	uint32_t x = 0;
+
+#if defined(XR_SSE)
+
+	const __m128i round = _mm_set1_epi32(128);
+
+	auto pixel = [&](uint32_t i) {
+		const __m128i a = _mm_loadl_epi64((const __m128i*)(row + ofs0[i]));
+		const __m128i b = _mm_loadl_epi64((const __m128i*)(row + ofs1[i]));
+		const __m128i v = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), _mm_set1_epi32((int)weights[i]));
+		return _mm_srli_epi32(_mm_add_epi32(v, round), 8);
+	};
+
+	for (; x + 2 <= plan.dstW; x += 2)
+		_mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi32(pixel(x), pixel(x + 1)));
+
+#elif defined(XR_NEON)
+
+	auto pixel = [&](uint32_t i) {
+		uint32x4_t v = vmull_n_u16(vld1_u16(row + ofs0[i]), static_cast<uint16_t>(weights[i] & 0xFFFF));
+		v = vmlal_n_u16(v, vld1_u16(row + ofs1[i]), static_cast<uint16_t>(weights[i] >> 16));
+		return vrshrn_n_u32(v, 8);
+	};
+
+	for (; x + 2 <= plan.dstW; x += 2)
+		vst1q_u16(out + x * 4, vcombine_u16(pixel(x), pixel(x + 1)));
+
+#endif
+
+	for (; x < plan.dstW; ++x)
+	{
+		const uint16_t* p0 = row + ofs0[x];
+		const uint16_t* p1 = row + ofs1[x];
+		const uint32_t wx0 = weights[x] & 0xFFFF;
+		const uint32_t wx = weights[x] >> 16;
+
+		for (uint32_t c = 0; c < 4; ++c)
+			out[x * 4 + c] = static_cast<uint16_t>((p0[c] * wx0 + p1[c] * wx + 128) >> 8);
+	}
+}
+
+template <uint32_t C>
+static void ResizeRowXSrgb(const ResizePlan& plan, const uint8_t* row, uint16_t* out)
+{
+	thread_local std::vector<uint16_t> linear;
+	if (linear.size() < plan.srcW * plan.channels)
+		linear.resize(plan.srcW * plan.channels);
+
+	DecodeRow(plan, row, linear.data());
+	ResizeRowXLinear<C>(plan, linear.data(), out);
+}
+
+static ResizeRowXFunc GetResizeRowXSrgb(uint32_t channels)
+{
+	switch (channels)
+	{
+	case 1: return ResizeRowXSrgb<1>;
+	case 3: return ResizeRowXSrgb<3>;
+	case 4: return ResizeRowXSrgb<4>;
+	default: return ResizeRowXSrgb<0>;
+	}
+}
+
+// Vertical pass straight to the encode table index: (top * wy0 + bottom * wy) >> 8 >> 3, rounded once
+
+#ifdef XR_AVX2
+
+#ifndef _WINDOWS
+__attribute__((target("avx2")))
+#endif
+static uint32_t ResizeRowYSrgbAvx2(const uint16_t* top, const uint16_t* bottom, uint32_t wy, uint8_t* out, uint32_t count, uint32_t channels)
+{
+	const int* table = (const int*)GetSrgbTables().encode8;
+	const __m256i alpha = AlphaLanesAvx2(channels, SRGB_ENCODE_SIZE);
+	const __m256i w = _mm256_set1_epi32((int)((256u - wy) | (wy << 16)));
+	const __m256i round = _mm256_set1_epi32(1 << 10);
+	const __m256i maxIndex = _mm256_set1_epi32(SRGB_ENCODE_SIZE - 1);
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(top + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(bottom + i));
+		const __m256i pairs = _mm256_set_m128i(_mm_unpackhi_epi16(a, b), _mm_unpacklo_epi16(a, b));
+		__m256i index = _mm256_srli_epi32(_mm256_add_epi32(_mm256_madd_epi16(pairs, w), round), 11);
+		index = _mm256_add_epi32(_mm256_min_epu32(index, maxIndex), alpha);
+		// Byte table read 32 bits at a time, the low byte is the entry
+		const __m256i v = _mm256_and_si256(_mm256_i32gather_epi32(table, index, 1), byteMask);
+		const __m128i v16 = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		_mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(v16, v16));
+	}
+	return i;
+}
+
+#endif
+
+static void ResizeRowYSrgb(const ResizePlan& plan, const uint16_t* top, const uint16_t* bottom, uint32_t wy, uint8_t* out, uint32_t count)
+{
+	const uint32_t channels = plan.channels;
+	uint32_t start = 0;
+
+#if defined(XR_AVX2)
+
+	if (HasAvx2())
+		start = ResizeRowYSrgbAvx2(top, bottom, wy, out, count, channels);
+
+	if (start == count)
+		return;
+
+#endif
+
+	thread_local std::vector<uint16_t> index;
+	if (index.size() < count)
+		index.resize(count);
+
+	uint16_t* idx = index.data();
+	uint32_t i = start;
+
+#if defined(XR_SSE)
+
+	const __m128i w = _mm_set1_epi32((int)((256u - wy) | (wy << 16)));
+	const __m128i round = _mm_set1_epi32(1 << 10);
+	const __m128i maxIndex = _mm_set1_epi16(SRGB_ENCODE_SIZE - 1);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(top + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(bottom + i));
+		const __m128i lo = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), w), round), 11);
+		const __m128i hi = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), w), round), 11);
+		_mm_storeu_si128((__m128i*)(idx + i), _mm_min_epu16(_mm_packus_epi32(lo, hi), maxIndex));
+	}
+
+#elif defined(XR_NEON)
+
+	const uint16_t w0 = static_cast<uint16_t>(256u - wy);
+	const uint16_t w1 = static_cast<uint16_t>(wy);
+	const uint16x8_t maxIndex = vdupq_n_u16(SRGB_ENCODE_SIZE - 1);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const uint16x8_t a = vld1q_u16(top + i);
+		const uint16x8_t b = vld1q_u16(bottom + i);
+
+		uint32x4_t lo = vmull_n_u16(vget_low_u16(a), w0);
+		uint32x4_t hi = vmull_n_u16(vget_high_u16(a), w0);
+		lo = vmlal_n_u16(lo, vget_low_u16(b), w1);
+		hi = vmlal_n_u16(hi, vget_high_u16(b), w1);
+
+		vst1q_u16(idx + i, vminq_u16(vcombine_u16(vrshrn_n_u32(lo, 11), vrshrn_n_u32(hi, 11)), maxIndex));
+	}
+
+#endif
+
+	const uint32_t wy0 = 256u - wy;
+	for (; i < count; ++i)
+		idx[i] = static_cast<uint16_t>(std::min<uint32_t>((top[i] * wy0 + bottom[i] * wy + (1 << 10)) >> 11, SRGB_ENCODE_SIZE - 1));
+
+	if (channels == 4) {
+		const uint8_t* color = plan.encode[0];
+		const uint8_t* alpha = plan.encode[3];
+		for (i = start; i < count; i += 4) {
+			out[i + 0] = color[idx[i + 0]];
+			out[i + 1] = color[idx[i + 1]];
+			out[i + 2] = color[idx[i + 2]];
+			out[i + 3] = alpha[idx[i + 3]];
+		}
+		return;
+	}
+
+	i = start;
+	for (uint32_t c = start % channels; i < count; i++) {
+		out[i] = plan.encode[c][idx[i]];
+		if (++c == channels)
+			c = 0;
+	}
+}
+
+#if !defined(XR_SSE) && !defined(XR_NEON)
+
+// Without SIMD the scratch rows of the two pass split only pay off when upscaling reuses them for several dst rows,
+// vertical downscales keep the fused per pixel loop
+static void ResizeBandFused(const ResizePlan& plan, const uint8_t* src, uint8_t* dst, uint32_t yBegin, uint32_t yEnd)
+{
+	const uint32_t channels = plan.channels;
+	const uint32_t srcStride = plan.srcW * channels;
+	const uint32_t dstStride = plan.dstW * channels;
+
+	for (uint32_t y = yBegin; y < yEnd; ++y)
+	{
+		const uint32_t wy = plan.yWeights[y];
+		const uint32_t wy0 = 256u - wy;
+
+		const uint8_t* row0 = src + static_cast<size_t>(plan.y0[y]) * srcStride;
+		const uint8_t* row1 = src + static_cast<size_t>(plan.y1[y]) * srcStride;
+		uint8_t* out = dst + static_cast<size_t>(y) * dstStride;
+
+		for (uint32_t x = 0; x < plan.dstW; ++x)
+		{
+			const uint32_t ofs0 = plan.xOfs0[x];
+			const uint32_t ofs1 = plan.xOfs1[x];
+			const uint32_t wx0 = plan.xWeights[x] & 0xFFFF;
+			const uint32_t wx = plan.xWeights[x] >> 16;
+
+			for (uint32_t c = 0; c < channels; ++c)
+			{
+				const uint32_t top = row0[ofs0 + c] * wx0 + row0[ofs1 + c] * wx;
+				const uint32_t bottom = row1[ofs0 + c] * wx0 + row1[ofs1 + c] * wx;
+				out[x * channels + c] = static_cast<uint8_t>((top * wy0 + bottom * wy + 0x8000u) >> 16);
+			}
+		}
+	}
+}
+
+#endif
+
+static void ResizeBand(const ResizePlan& plan, const uint8_t* src, uint8_t* dst, uint32_t yBegin, uint32_t yEnd)
+{
+#if !defined(XR_SSE) && !defined(XR_NEON)
+	if (!(plan.flags & RESIZE_SRGB) && plan.dstH <= plan.srcH) {
+		ResizeBandFused(plan, src, dst, yBegin, yEnd);
+		return;
+	}
+#endif
+
+	const uint32_t srcStride = plan.srcW * plan.channels;
+	const uint32_t dstStride = plan.dstW * plan.channels;
+
+	thread_local std::vector<uint16_t> scratch;
+	if (scratch.size() < dstStride * 2)
+		scratch.resize(dstStride * 2);
+
+	// Two horizontally resized source rows, reused while consecutive dst rows map on them
+	uint16_t* rows[2] = { scratch.data(), scratch.data() + dstStride };
+	int64_t rowY[2] = { -1, -1 };
+
+	const bool srgb = (plan.flags & RESIZE_SRGB) != 0;
+	const ResizeRowXFunc rowX = srgb ? GetResizeRowXSrgb(plan.channels) : GetResizeRowX(plan.channels);
+
+	auto fetch = [&](uint32_t sy, int64_t keep) -> uint16_t* {
+		for (int i = 0; i < 2; i++) {
+			if (rowY[i] == sy)
+				return rows[i];
+		}
+		const int slot = rowY[0] == keep ? 1 : 0;
+		rowX(plan, src + static_cast<size_t>(sy) * srcStride, rows[slot]);
+		rowY[slot] = sy;
+		return rows[slot];
+	};
+
+	for (uint32_t y = yBegin; y < yEnd; ++y)
+	{
+		const uint32_t wy = plan.yWeights[y];
+		const uint32_t y0 = plan.y0[y];
+		const uint32_t y1 = plan.y1[y];
+
+		const uint16_t* top = fetch(y0, wy != 0 ? y1 : -1);
+		const uint16_t* bottom = wy != 0 ? fetch(y1, y0) : top;
+
+		uint8_t* out = dst + static_cast<size_t>(y) * dstStride;
+
+		if (srgb)
+			ResizeRowYSrgb(plan, top, bottom, wy, out, dstStride);
+		else
+			ResizeRowY(top, bottom, wy, out, dstStride);
+	}
+}
+
+static void ExecuteResize(const ResizePlan& plan, const uint8_t* src, uint8_t* dst)
+{
+	const uint32_t dstStride = plan.dstW * plan.channels;
+	const uint32_t minRows = std::max(8u, RESIZE_MIN_BAND_BYTES / std::max(1u, dstStride));
+
+	ParallelFor(plan.dstH, minRows, [&](uint32_t begin, uint32_t end) {
+		ResizeBand(plan, src, dst, begin, end);
+	});
+}
+
+
+ResizePlan* CreateResizePlan(uint32_t srcW, uint32_t srcH, uint32_t dstW, uint32_t dstH, uint32_t channels, uint32_t flags)
+{
+	if (srcW == 0 || srcH == 0 || dstW == 0 || dstH == 0 || channels == 0)
+		return nullptr;
+
+	auto plan = new ResizePlan();
+	BuildResizePlan(*plan, srcW, srcH, dstW, dstH, channels, flags);
+	return plan;
+}
+
+void ExecuteResizePlan(ResizePlan* plan, const uint8_t* src, uint8_t* dst)
+{
+	if (!plan || !src || !dst)
+		return;
+
+	ExecuteResize(*plan, src, dst);
+}
+
+void DestroyResizePlan(ResizePlan* plan)
+{
+	delete plan;
+}
+
+static void ResizeWithLastPlan(
+	uint32_t srcW, uint32_t srcH, const uint8_t* src,
+	uint32_t dstW, uint32_t dstH, uint8_t* dst,
+	uint32_t channels, uint32_t flags)
+{
+	if (!src || !dst || srcW == 0 || srcH == 0 || dstW == 0 || dstH == 0 || channels == 0)
+		return;
+
+	// Mip chains and video frames resize with the same sizes over and over, keep the last plan per thread
+	thread_local ResizePlan lastPlan;
+
+	if (lastPlan.srcW != srcW || lastPlan.srcH != srcH || lastPlan.dstW != dstW || lastPlan.dstH != dstH || lastPlan.channels != channels || lastPlan.flags != flags)
+		BuildResizePlan(lastPlan, srcW, srcH, dstW, dstH, channels, flags);
+
+	ExecuteResize(lastPlan, src, dst);
+}
+
+void ImageResizeBilinearU8(
+	uint32_t srcW, uint32_t srcH, const uint8_t* src,
+	uint32_t dstW, uint32_t dstH, uint8_t* dst,
+	uint32_t channels)
+{
+	ResizeWithLastPlan(srcW, srcH, src, dstW, dstH, dst, channels, 0);
+}
+
+void ImageResizeBilinearSrgbU8(
+	uint32_t srcW, uint32_t srcH, const uint8_t* src,
+	uint32_t dstW, uint32_t dstH, uint8_t* dst,
+	uint32_t channels)
+{
+	ResizeWithLastPlan(srcW, srcH, src, dstW, dstH, dst, channels, RESIZE_SRGB);
+}
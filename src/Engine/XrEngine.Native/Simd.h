@@ -0,0 +1,45 @@
+#pragma once
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+
+	#define XR_NEON
+
+	#include <arm_neon.h>
+
+#elif defined(_M_X64) || defined(__SSE4_1__)
+
+	#define XR_SSE
+
+	#include <immintrin.h>
+
+	#if defined(_M_X64) || defined(__AVX2__)
+		#define XR_AVX2
+	#endif
+
+	#ifdef _WINDOWS
+		#include <intrin.h>
+	#endif
+
+#endif
+
+// AVX2 is only guaranteed when the compiler targets it, on MSVC x64 we check the cpu once at runtime
+inline bool HasAvx2()
+{
+#if defined(__AVX2__)
+	return true;
+#elif defined(XR_AVX2) && defined(_WINDOWS)
+	static const bool value = [] {
+		int info[4];
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}();
+	return value;
+#else
+	return false;
+#endif
+}
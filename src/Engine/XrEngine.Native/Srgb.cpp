@@ -0,0 +1,51 @@
+#include "pch.h"
+#include "Srgb.h"
+
+static float SrgbToLinear(float v)
+{
+	return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+static void BuildSrgbTables(SrgbTables& tables)
+{
+	for (uint32_t i = 0; i < 256; i++) {
+		const float linear = SrgbToLinear(i / 255.0f);
+		tables.toLinearF[i] = linear;
+		tables.toLinear16[i] = static_cast<uint16_t>(linear * 65535.0f + 0.5f);
+		tables.toLinear15[i] = static_cast<uint16_t>(linear * SRGB_LINEAR15_MAX + 0.5f);
+		tables.alphaToLinear15[i] = static_cast<uint16_t>(i * SRGB_LINEAR15_MAX / 255.0f + 0.5f);
+	}
+
+	// Pick the byte whose decoded value is the closest to each bucket, so encode(decode(x)) == x for every byte
+	uint32_t cur = 0;
+	for (uint32_t i = 0; i < SRGB_ENCODE_SIZE; i++) {
+		const float linear = i / static_cast<float>(SRGB_ENCODE_SIZE - 1);
+		while (cur < 255 && std::abs(tables.toLinearF[cur + 1] - linear) <= std::abs(tables.toLinearF[cur] - linear))
+			cur++;
+		tables.fromLinear12[i] = static_cast<uint8_t>(cur);
+		tables.alphaFromLinear12[i] = static_cast<uint8_t>(i * 255.0f / (SRGB_ENCODE_SIZE - 1) + 0.5f);
+	}
+
+	for (uint32_t i = 0; i < 256; i++) {
+		tables.decode32[i] = tables.toLinear15[i];
+		tables.decode32[256 + i] = tables.alphaToLinear15[i];
+	}
+
+	for (uint32_t i = 0; i < 512; i++) {
+		tables.decodeLo[i] = static_cast<uint8_t>(tables.decode32[i] & 0xFF);
+		tables.decodeHi[i] = static_cast<uint8_t>(tables.decode32[i] >> 8);
+	}
+
+	memcpy(tables.encode8, tables.fromLinear12, SRGB_ENCODE_SIZE);
+	memcpy(tables.encode8 + SRGB_ENCODE_SIZE, tables.alphaFromLinear12, SRGB_ENCODE_SIZE);
+}
+
+const SrgbTables& GetSrgbTables()
+{
+	static const SrgbTables* tables = [] {
+		auto result = new SrgbTables();
+		BuildSrgbTables(*result);
+		return result;
+	}();
+	return *tables;
+}
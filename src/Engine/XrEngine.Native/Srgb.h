@@ -0,0 +1,48 @@
+#pragma once
+
+#define SRGB_ENCODE_BITS 12
+#define SRGB_ENCODE_SIZE (1 << SRGB_ENCODE_BITS)
+// 15 bit linear scale, multiple of the encode table size so index = (v + 4) >> 3
+#define SRGB_LINEAR15_MAX ((SRGB_ENCODE_SIZE - 1) * 8)
+
+struct SrgbTables {
+	// sRGB byte -> linear [0..65535]
+	uint16_t toLinear16[256];
+	// sRGB byte -> linear [0..1]
+	float toLinearF[256];
+	// linear [0..4095] -> sRGB byte
+	uint8_t fromLinear12[SRGB_ENCODE_SIZE];
+	// sRGB byte -> linear [0..SRGB_LINEAR15_MAX], fits signed 16 bit so it can go through 16 bit multiply-add
+	uint16_t toLinear15[256];
+	// Same fixed point for channels that are already linear (alpha)
+	uint16_t alphaToLinear15[256];
+	uint8_t alphaFromLinear12[SRGB_ENCODE_SIZE];
+	// toLinear15 then alphaToLinear15 widened to 32 bit, the resize gathers alpha lanes at +256
+	uint32_t decode32[512];
+	// decode32 split in low and high bytes, for the NEON table lookups
+	uint8_t decodeLo[512];
+	uint8_t decodeHi[512];
+	// fromLinear12 then alphaFromLinear12, alpha lanes at +SRGB_ENCODE_SIZE; padded so a 32 bit gather of the last entry stays inside
+	uint8_t encode8[2 * SRGB_ENCODE_SIZE + 4];
+};
+
+const SrgbTables& GetSrgbTables();
+
+// Linear [0..65535] -> sRGB byte, the low 4 bits are rounded away by the 4K table
+inline uint8_t SrgbEncode16(const SrgbTables& tables, uint32_t linear)
+{
+	const uint32_t index = std::min<uint32_t>((linear + (1 << (15 - SRGB_ENCODE_BITS))) >> (16 - SRGB_ENCODE_BITS), SRGB_ENCODE_SIZE - 1);
+	return tables.fromLinear12[index];
+}
+
+inline uint8_t SrgbEncodeF(const SrgbTables& tables, float linear)
+{
+	const float v = std::clamp(linear, 0.0f, 1.0f) * (SRGB_ENCODE_SIZE - 1) + 0.5f;
+	return tables.fromLinear12[static_cast<uint32_t>(v)];
+}
+
+// Number of leading channels holding color, the others (alpha) are always filtered as linear
+inline uint32_t SrgbColorChannels(uint32_t channels)
+{
+	return channels == 4 || channels == 2 ? channels - 1 : channels;
+}
@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "Simd.h"
+#include "Parallel.h"
+
+// Images smaller than this are converted on the calling thread only
+#define SWIZZLE_MIN_BAND_BYTES (256 * 1024)
+
+struct SwizzleKernel {
+	uint32_t srcChannels;
+	uint32_t dstChannels;
+	// Pixels converted by one 16 byte shuffle
+	uint32_t blockPixels;
+	// Shuffle control (0x80 = zero) and constant OR-ed after the shuffle, for one block
+	alignas(16) uint8_t shuffle[16];
+	alignas(16) uint8_t fill[16];
+};
+
+static void BuildSwizzleKernel(SwizzleKernel& kernel, uint32_t srcChannels, uint32_t dstChannels, uint32_t swizzleMask)
+{
+	kernel.srcChannels = srcChannels;
+	kernel.dstChannels = dstChannels;
+	kernel.blockPixels = std::min(16 / srcChannels, 16 / dstChannels);
+
+	for (uint32_t i = 0; i < 16; i++) {
+
+		const uint32_t pixel = i / dstChannels;
+		const uint32_t sel = (swizzleMask >> ((i % dstChannels) * 4)) & 0xF;
+
+		if (pixel >= kernel.blockPixels) {
+			// Bytes past the block are rewritten by the next one, keeping them identical makes in place work
+			kernel.shuffle[i] = srcChannels == dstChannels ? static_cast<uint8_t>(i) : 0x80;
+			kernel.fill[i] = 0;
+		}
+		else if (sel < srcChannels) {
+			kernel.shuffle[i] = static_cast<uint8_t>(pixel * srcChannels + sel);
+			kernel.fill[i] = 0;
+		}
+		else {
+			kernel.shuffle[i] = 0x80;
+			kernel.fill[i] = sel == SWIZZLE_ONE ? 0xFF : 0;
+		}
+	}
+}
+
+static void SwizzleRow(const SwizzleKernel& kernel, const uint8_t* src, uint8_t* dst, uint32_t width)
+{
+	const uint32_t srcChannels = kernel.srcChannels;
+	const uint32_t dstChannels = kernel.dstChannels;
+
+	uint32_t x = 0;
+
+#if defined(XR_SSE) || (defined(XR_NEON) && defined(__aarch64__))
+
+	const uint32_t block = kernel.blockPixels;
+
+	// Each block loads and stores 16 bytes, stop while both still fit in the row
+	const uint32_t maxPixels = std::max((16 + srcChannels - 1) / srcChannels, (16 + dstChannels - 1) / dstChannels);
+
+	if (width >= maxPixels) {
+
+		const uint32_t end = width - maxPixels;
+
+#if defined(XR_SSE)
+
+		const __m128i shuffle = _mm_load_si128((const __m128i*)kernel.shuffle);
+		const __m128i fill = _mm_load_si128((const __m128i*)kernel.fill);
+
+		for (; x <= end; x += block) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(src + x * srcChannels));
+			_mm_storeu_si128((__m128i*)(dst + x * dstChannels), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), fill));
+		}
+
+#else
+
+		const uint8x16_t shuffle = vld1q_u8(kernel.shuffle);
+		const uint8x16_t fill = vld1q_u8(kernel.fill);
+
+		for (; x <= end; x += block) {
+			const uint8x16_t v = vld1q_u8(src + x * srcChannels);
+			vst1q_u8(dst + x * dstChannels, vorrq_u8(vqtbl1q_u8(v, shuffle), fill));
+		}
+
+#endif
+	}
+
+#endif
+
+	for (; x < width; x++) {
+
+		const uint8_t* s = src + x * srcChannels;
+		uint8_t* d = dst + x * dstChannels;
+
+		// Read the whole pixel first, in place the dst bytes alias the src ones
+		uint8_t pixel[16];
+		for (uint32_t c = 0; c < srcChannels; c++)
+			pixel[c] = s[c];
+
+		for (uint32_t c = 0; c < dstChannels; c++) {
+			const uint32_t i = kernel.shuffle[c];
+			d[c] = (i & 0x80 ? 0 : pixel[i]) | kernel.fill[c];
+		}
+	}
+}
+
+void ImageSwizzle(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, uint32_t srcStride, uint32_t dstStride, uint32_t srcFormat, uint32_t dstFormat, uint32_t swizzleMask)
+{
+	if (!src || !dst || width == 0 || height == 0)
+		return;
+
+	if (srcFormat < SWIZZLE_R8 || srcFormat > SWIZZLE_RGBA8 || dstFormat < SWIZZLE_R8 || dstFormat > SWIZZLE_RGBA8)
+		return;
+
+	const uint32_t srcChannels = srcFormat;
+	const uint32_t dstChannels = dstFormat;
+
+	if (srcStride == 0)
+		srcStride = width * srcChannels;
+
+	if (dstStride == 0)
+		dstStride = width * dstChannels;
+
+	SwizzleKernel kernel;
+	BuildSwizzleKernel(kernel, srcChannels, dstChannels, swizzleMask);
+
+	const bool inPlace = src == dst;
+
+	if (inPlace && (srcChannels != dstChannels || srcStride != dstStride)) {
+
+		// Rows change size: go through a row copy, expanding from the last row and shrinking from the first,
+		// so a row never overwrites source rows still to be read. Rows depend on each other, no fan out.
+		std::vector<uint8_t> row(width * srcChannels);
+
+		const bool expand = dstStride > srcStride || (dstStride == srcStride && dstChannels > srcChannels);
+
+		for (uint32_t i = 0; i < height; i++) {
+			const uint32_t y = expand ? height - 1 - i : i;
+			memcpy(row.data(), src + static_cast<size_t>(y) * srcStride, row.size());
+			SwizzleRow(kernel, row.data(), dst + static_cast<size_t>(y) * dstStride, width);
+		}
+		return;
+	}
+
+	const uint32_t rowBytes = width * std::max(srcChannels, dstChannels);
+	const uint32_t minRows = std::max(1u, SWIZZLE_MIN_BAND_BYTES / rowBytes);
+
+	ParallelFor(height, minRows, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t y = begin; y < end; y++)
+			SwizzleRow(kernel, src + static_cast<size_t>(y) * srcStride, dst + static_cast<size_t>(y) * dstStride, width);
+	});
+}
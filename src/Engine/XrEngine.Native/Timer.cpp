@@ -0,0 +1,235 @@
+#include "pch.h"
+#include "Simd.h"
+#include <atomic>
+#include <mutex>
+
+#ifdef _WINDOWS
+	#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+		#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+	#endif
+#else
+	#include <time.h>
+	#include <errno.h>
+#endif
+
+// Lateness histogram, 1 us buckets, the last one collects everything above
+#define TIMER_HISTOGRAM_BUCKETS 4096
+#define TIMER_HISTOGRAM_BUCKET_NS 1000
+
+// Bounds of the part of each wait that is spun instead of slept
+#define TIMER_MIN_SPIN_NS 20000
+#define TIMER_MAX_SPIN_NS 2000000
+
+struct PeriodicTimer {
+	uint64_t periodNs;
+	// TimerReset may come from another thread than the one waiting
+	std::atomic<uint64_t> nextNs;
+	// Running estimate of how much the OS sleep overshoots, drives the spin tail
+	double oversleepAvgNs;
+	double oversleepDevNs;
+
+#ifdef _WINDOWS
+	HANDLE handle;
+#endif
+
+	std::mutex statsLock;
+	TimerStats stats;
+	std::vector<uint32_t> histogram;
+};
+
+static uint64_t MonotonicNs()
+{
+#ifdef _WINDOWS
+	static const double toNs = [] {
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq);
+		return 1e9 / static_cast<double>(freq.QuadPart);
+	}();
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return static_cast<uint64_t>(counter.QuadPart * toNs);
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static inline void SpinPause()
+{
+#if defined(XR_SSE)
+	_mm_pause();
+#elif defined(XR_NEON) && defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+static void SleepUntilNs([[maybe_unused]] PeriodicTimer& timer, uint64_t deadlineNs)
+{
+#ifdef _WINDOWS
+
+	const uint64_t now = MonotonicNs();
+	if (deadlineNs <= now)
+		return;
+
+	if (timer.handle) {
+		// Relative due time in 100 ns units
+		LARGE_INTEGER due;
+		due.QuadPart = -static_cast<LONGLONG>((deadlineNs - now) / 100);
+		if (SetWaitableTimer(timer.handle, &due, 0, nullptr, nullptr, FALSE)) {
+			WaitForSingleObject(timer.handle, INFINITE);
+			return;
+		}
+	}
+
+	SleepFor(deadlineNs - now);
+
+#else
+
+	timespec ts;
+	ts.tv_sec = static_cast<time_t>(deadlineNs / 1000000000ull);
+	ts.tv_nsec = static_cast<long>(deadlineNs % 1000000000ull);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+	}
+
+#endif
+}
+
+static void RecordLateness(PeriodicTimer& timer, int64_t latenessNs, uint64_t missed)
+{
+	std::lock_guard<std::mutex> lock(timer.statsLock);
+
+	TimerStats& stats = timer.stats;
+
+	if (stats.ticks == 0 || latenessNs < stats.minLatenessNs)
+		stats.minLatenessNs = latenessNs;
+	if (stats.ticks == 0 || latenessNs > stats.maxLatenessNs)
+		stats.maxLatenessNs = latenessNs;
+
+	stats.ticks++;
+	stats.missed += missed;
+	stats.totalLatenessNs += latenessNs;
+
+	const uint64_t bucket = std::min<uint64_t>(std::max<int64_t>(0, latenessNs) / TIMER_HISTOGRAM_BUCKET_NS, TIMER_HISTOGRAM_BUCKETS - 1);
+	timer.histogram[bucket]++;
+}
+
+PeriodicTimer* TimerCreate(uint64_t periodNs)
+{
+	if (periodNs == 0)
+		return nullptr;
+
+	auto timer = new PeriodicTimer();
+	timer->periodNs = periodNs;
+	timer->nextNs = MonotonicNs() + periodNs;
+	timer->oversleepAvgNs = TIMER_MIN_SPIN_NS;
+	timer->oversleepDevNs = 0;
+	timer->stats = {};
+	timer->histogram.resize(TIMER_HISTOGRAM_BUCKETS);
+
+#ifdef _WINDOWS
+	// High resolution waitable timers (Windows 10 1803+) wake within ~0.5 ms instead of the 1-15 ms tick
+	timer->handle = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!timer->handle)
+		timer->handle = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+#endif
+
+	return timer;
+}
+
+uint32_t TimerWaitNext(PeriodicTimer* timer)
+{
+	if (!timer)
+		return 0;
+
+	const uint64_t period = timer->periodNs;
+	const uint64_t deadline = timer->nextNs.load(std::memory_order_acquire);
+	uint64_t now = MonotonicNs();
+
+	if (now < deadline) {
+
+		const double margin = std::clamp(timer->oversleepAvgNs + 2 * timer->oversleepDevNs, (double)TIMER_MIN_SPIN_NS, (double)TIMER_MAX_SPIN_NS);
+		const uint64_t sleepUntil = deadline - std::min<uint64_t>(deadline - now, static_cast<uint64_t>(margin));
+
+		if (sleepUntil > now) {
+			SleepUntilNs(*timer, sleepUntil);
+			now = MonotonicNs();
+
+			// Calibrate the spin tail on the observed overshoot; only this thread writes it, TimerGetStats reads it under the lock
+			const double oversleep = static_cast<double>(now > sleepUntil ? now - sleepUntil : 0);
+			const double diff = oversleep - timer->oversleepAvgNs;
+			{
+				std::lock_guard<std::mutex> lock(timer->statsLock);
+				timer->oversleepAvgNs += diff * 0.1;
+				timer->oversleepDevNs += (std::abs(diff) - timer->oversleepDevNs) * 0.1;
+			}
+		}
+
+		while (now < deadline) {
+			SpinPause();
+			now = MonotonicNs();
+		}
+	}
+
+	// Deadlines stay on the start + k * period grid; when late by more than one period
+	// the missed ones are skipped and reported, so the caller can catch up without drifting.
+	// A TimerReset during the wait wins, its grid starts at the next wait
+	const uint64_t elapsed = 1 + (now - deadline) / period;
+	uint64_t expected = deadline;
+	timer->nextNs.compare_exchange_strong(expected, deadline + elapsed * period, std::memory_order_acq_rel);
+
+	RecordLateness(*timer, static_cast<int64_t>(now - deadline), elapsed - 1);
+
+	return static_cast<uint32_t>(elapsed);
+}
+
+void TimerGetStats(PeriodicTimer* timer, TimerStats* stats, bool reset)
+{
+	if (!timer || !stats)
+		return;
+
+	std::lock_guard<std::mutex> lock(timer->statsLock);
+
+	*stats = timer->stats;
+
+	// p99 from the histogram, bucket upper bound
+	const uint64_t target = timer->stats.ticks - timer->stats.ticks / 100;
+	uint64_t count = 0;
+	stats->p99LatenessNs = 0;
+
+	for (uint32_t i = 0; i < TIMER_HISTOGRAM_BUCKETS && timer->stats.ticks > 0; i++) {
+		count += timer->histogram[i];
+		if (count >= target) {
+			stats->p99LatenessNs = i == TIMER_HISTOGRAM_BUCKETS - 1 ? timer->stats.maxLatenessNs : static_cast<int64_t>(i + 1) * TIMER_HISTOGRAM_BUCKET_NS;
+			break;
+		}
+	}
+
+	stats->spinNs = static_cast<int64_t>(std::clamp(timer->oversleepAvgNs + 2 * timer->oversleepDevNs, (double)TIMER_MIN_SPIN_NS, (double)TIMER_MAX_SPIN_NS));
+
+	if (reset) {
+		timer->stats = {};
+		std::fill(timer->histogram.begin(), timer->histogram.end(), 0);
+	}
+}
+
+void TimerReset(PeriodicTimer* timer)
+{
+	if (!timer)
+		return;
+
+	timer->nextNs.store(MonotonicNs() + timer->periodNs, std::memory_order_release);
+}
+
+void TimerDestroy(PeriodicTimer* timer)
+{
+	if (!timer)
+		return;
+
+#ifdef _WINDOWS
+	if (timer->handle)
+		CloseHandle(timer->handle);
+#endif
+
+	delete timer;
+}
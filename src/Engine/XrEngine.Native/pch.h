@@ -10,6 +10,10 @@
 #include <cmath>
 #include <chrono>
 #include <thread>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <functional>
 
 #include "Config.h"
 #include "Api.h"
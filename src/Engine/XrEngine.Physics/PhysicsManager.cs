@@ -116,28 +116,48 @@ namespace XrEngine.Physics
 
         void SimulateLoopV2()
         {
-            while (IsStarted)
+            PrecisionTimer? timer = null;
+            uint steps = 1;
+
+            try
             {
-                var startTime = Stopwatch.GetTimestamp();
+                while (IsStarted)
+                {
+                    var stepSize = StepSizeSecs;
+
+                    while (_queue.TryDequeue(out var action))
+                        action();
 
-                while (_queue.TryDequeue(out var action))
-                    action();
+                    // Missed periods are simulated in the next step, up to a limit so a long stall doesn't spiral
+                    _system?.Simulate(stepSize * Math.Min(steps, MaxCatchUpSteps), stepSize);
 
-                _system?.Simulate((float)StepSizeSecs, StepSizeSecs);
+                    if (stepSize <= 0)
+                    {
+                        Thread.Yield();
+                        continue;
+                    }
 
-                var ellapsed = Stopwatch.GetElapsedTime(startTime).TotalSeconds;
+                    var periodNs = (ulong)(stepSize * 1e9);
 
-                var wait = StepSizeSecs - ellapsed;
+                    if (timer == null || timer.PeriodNs != periodNs)
+                    {
+                        timer?.Dispose();
+                        timer = new PrecisionTimer(periodNs);
+                    }
 
-                if (wait > 0)
+                    steps = timer.WaitNext();
+                }
+
+                if (timer != null)
                 {
-                    EngineNativeLib.SleepFor((ulong)(wait * 1e9));
-                    //Thread.Sleep(TimeSpan.FromSeconds(wait));
-                    //ellapsed = Stopwatch.GetElapsedTime(startTime).TotalSeconds;
-                    //Debug.Assert(Math.Abs(ellapsed - StepSizeSecs) < 0.003f);
+                    var stats = timer.GetStats();
+                    Log.Debug(this, "Simulate timer: ticks {0}, missed {1}, lateness avg {2} us, p99 {3} us, max {4} us",
+                        stats.Ticks, stats.Missed, stats.AvgLatenessNs / 1000, stats.P99LatenessNs / 1000, stats.MaxLatenessNs / 1000);
                 }
-                else
-                    Thread.Yield();
+            }
+            finally
+            {
+                timer?.Dispose();
             }
         }
 
@@ -224,6 +244,8 @@ namespace XrEngine.Physics
 
         public float StepSizeSecs { get; set; }
 
+        public uint MaxCatchUpSteps { get; set; } = 4;
+
         public PhysicsOptions Options { get; set; }
 
         public bool IsMultiThread { get; set; }
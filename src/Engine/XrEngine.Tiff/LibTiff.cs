@@ -368,83 +368,51 @@ namespace XrEngine.Tiff
 
             using var data = buffer.MemoryLock();
 
-            if (flipY)
+            if (tw > 0)
             {
-                if (tw > 0)
-                {
-                    var tileSize = (uint)TIFFTileSize(tiff);
-                    var tileBuf = MemoryBuffer.Create<byte>(tileSize);
+                var tileSize = (uint)TIFFTileSize(tiff);
+                var tLineSize = (int)(tileSize / th);
+                var tilesX = (w + tw - 1) / tw;
 
-                    using var tileBufData = buffer.MemoryLock();
+                // A whole row of tiles is read, then all of them are copied with a single native call
+                var stripBuf = MemoryBuffer.Create<byte>(tileSize * (uint)tilesX);
+                var rects = new CopyRect2DDesc[tilesX];
 
-                    var tLineSize = tileSize / th;
+                using var stripData = stripBuf.MemoryLock();
 
-                    for (uint y = 0; y < h; y += (uint)th) // Iterate over tiles vertically
-                    {
-                        for (uint x = 0; x < w; x += (uint)tw) // Iterate over tiles horizontally
-                        {
-                            TIFFReadTile(tiff, tileBufData, x, y, 0, 0);
+                for (var y = 0; y < h; y += th) // Iterate over tiles vertically
+                {
+                    var curTh = Math.Min(h - y, th);
+                    var dstY = flipY ? h - y - 1 : y;
 
-                            var curTh = Math.Min(h - y, th);
-                            var mainBufOfs = data.Data + (x * ps) + ((h - y - 1) * lineSize);
-                            var tileBufOfs = tileBufData.Data;
-                            var cutTLineSize = Math.Min(tLineSize, (w - x) * ps);
+                    for (var i = 0; i < tilesX; i++) // Iterate over tiles horizontally
+                    {
+                        var x = i * tw;
+                        var tileData = stripData.Data + (long)i * tileSize;
 
-                            for (uint y1 = 0; y1 < curTh; y1++)
-                            {
-                                EngineNativeLib.CopyMemory((nint)tileBufOfs, (nint)mainBufOfs, (uint)cutTLineSize);
-                                mainBufOfs -= lineSize;
-                                tileBufOfs += tLineSize;
-                            }
+                        TIFFReadTile(tiff, tileData, (uint)x, (uint)y, 0, 0);
 
-                        }
+                        rects[i] = new CopyRect2DDesc
+                        {
+                            Src = tileData,
+                            Dst = data.Data + (long)x * ps + (long)dstY * lineSize,
+                            SrcStride = tLineSize,
+                            DstStride = flipY ? -lineSize : lineSize,
+                            RowBytes = (uint)Math.Min(tLineSize, (w - x) * ps),
+                            Rows = (uint)curTh
+                        };
                     }
-                }
-                else
-                {
-                    for (var y = 0; y < h; y++)
-                        TIFFReadScanline(tiff, data.Data + ((h - y - 1) * lineSize), y, 0);
-                }
 
+                    fixed (CopyRect2DDesc* pRects = rects)
+                        EngineNativeLib.CopyRects2D(pRects, (uint)tilesX);
+                }
             }
             else
             {
-                if (tw > 0)
-                {
-                    var tileSize = (uint)TIFFTileSize(tiff);
-                    var tileBuf = MemoryBuffer.Create<byte>(tileSize);
-
-                    using var tileBufData = buffer.MemoryLock();
-
-                    var tLineSize = tileSize / th;
-
-                    for (uint y = 0; y < h; y += (uint)th) // Iterate over tiles vertically
-                    {
-                        for (uint x = 0; x < w; x += (uint)tw) // Iterate over tiles horizontally
-                        {
-                            TIFFReadTile(tiff, tileBufData, x, y, 0, 0);
-
-                            var curTh = Math.Min(h - y, th);
-                            var mainBufOfs = data.Data + (x * ps) + (y * lineSize);
-                            var tileBufOfs = tileBufData.Data;
-                            var cutTLineSize = Math.Min(tLineSize, (w - x) * ps);
-
-                            for (uint y1 = 0; y1 < curTh; y1++)
-                            {
-                                EngineNativeLib.CopyMemory((nint)tileBufOfs, (nint)mainBufOfs, (uint)cutTLineSize);
-                                mainBufOfs += lineSize;
-                                tileBufOfs += tLineSize;
-                            }
-
-                        }
-                    }
-                }
-
                 for (var y = 0; y < h; y++)
-                    TIFFReadScanline(tiff, data.Data + (y * lineSize), y, 0);
+                    TIFFReadScanline(tiff, data.Data + (long)(flipY ? h - y - 1 : y) * lineSize, y, 0);
             }
 
-
             return result;
         }
 
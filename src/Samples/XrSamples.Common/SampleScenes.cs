@@ -2112,6 +2112,20 @@ namespace XrSamples
 
             app.ActiveScene!.AddChild(cube);
 
+            // Same cube without indices: normals and UVs go through the sequential triangle list of the tangent generation
+            var flatGeo = new Cube3D();
+            flatGeo.Rebuild();
+
+            var flat = new TriangleMesh(flatGeo, (Material)MaterialFactory.CreatePbr(new Color(0, 0, 1f, 1)))
+            {
+                Name = "non-indexed"
+            };
+
+            flat.Transform.SetScale(0.1f);
+            flat.Transform.Position = new Vector3(0.3f, 0, 0);
+
+            app.ActiveScene!.AddChild(flat);
+
             /*
             var quad = new TriangleMesh(new Quad3D(new Vector2(2, 2)), new TextureClipMaterial
             {